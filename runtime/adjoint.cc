@@ -0,0 +1,106 @@
+/**
+ * Copyright (c) 2022 Alcides Andrade <andrade.alcides.junior@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "adjoint.hpp"
+
+#include "error.hpp"
+#include "gate.hpp"
+#include "math/vector.hpp"
+
+namespace runtime {
+
+Gradient gradient(const Circuit& circuit, const Observable& observable) {
+    return gradient(circuit, observable, circuit.parameters);
+}
+
+Gradient gradient(const Circuit& circuit, const Observable& observable,
+                  const std::vector<double>& parameters)
+{
+    if (parameters.size() != circuit.parameters.size()) {
+        throw Error("expected " + std::to_string(circuit.parameters.size()) +
+                    " parameters, but " + std::to_string(parameters.size()) +
+                    " were passed");
+    }
+    if (circuit.nr_qubits == 0) {
+        throw Error("cannot differentiate a circuit without quantum registers");
+    }
+
+    math::vector_t psi(size_t(1) << circuit.nr_qubits);
+    psi[0] = 1;
+    for (auto& operation : circuit.operations) {
+        if (operation.condition.has_value() ||
+            operation.type == Operation::Measure || operation.type == Operation::Reset) {
+            throw Error("adjoint differentiation requires a unitary circuit (" +
+                        std::to_string(operation.line) + ")");
+        }
+        if (operation.type == Operation::CX) {
+            Gate::cx().apply(psi, operation.qubits);
+        } else if (operation.type == Operation::U) {
+            auto& [theta, phi, lambda] = operation.angles;
+            Gate::u(theta.evaluate(parameters),
+                    phi.evaluate(parameters),
+                    lambda.evaluate(parameters)).apply(psi, operation.qubits);
+        }
+    }
+
+    // co-state O|psi>
+    math::vector_t co_state(psi.size());
+    for (auto& mask : observable.resolve(circuit.quantum_registers)) {
+        co_state.add_pauli(psi, mask.x_mask, mask.z_mask, math::cx_t(mask.weight));
+    }
+
+    Gradient res { psi.dot(co_state).real(), std::vector<double>(parameters.size()) };
+    for (auto operation = circuit.operations.rbegin();
+         operation != circuit.operations.rend();
+         operation++)
+    {
+        if (operation->type == Operation::CX) {
+            Gate::cx().apply(psi, operation->qubits);
+            Gate::cx().apply(co_state, operation->qubits);
+            continue;
+        } else if (operation->type != Operation::U) {
+            continue;
+        }
+        float angles[3];
+        for (size_t a = 0; a < 3; a++) {
+            angles[a] = operation->angles[a].evaluate(parameters);
+        }
+        auto inverse = Gate::u(angles[0], angles[1], angles[2]).adjoint();
+        // psi becomes the state right before the gate
+        inverse.apply(psi, operation->qubits);
+        for (size_t a = 0; a < 3; a++) {
+            auto dependencies = operation->angles[a].dependencies();
+            if (dependencies.empty()) {
+                continue;
+            }
+            auto derivative = Gate::u_derivative(angles[0], angles[1], angles[2], a);
+            double d = 2*derivative.matrix_element(co_state, psi, operation->qubits).real();
+            for (auto p : dependencies) {
+                res.derivatives[p] += d*operation->angles[a].derivative(parameters, p);
+            }
+        }
+        inverse.apply(co_state, operation->qubits);
+    }
+    return res;
+}
+
+}
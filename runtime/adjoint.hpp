@@ -0,0 +1,63 @@
+/**
+ * Copyright (c) 2022 Alcides Andrade <andrade.alcides.junior@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef __RUNTIME__ADJOINT_H__
+#define __RUNTIME__ADJOINT_H__
+
+#include <vector>
+
+#include "circuit.hpp"
+#include "observable.hpp"
+
+namespace runtime {
+
+/**
+ * The expectation value of an observable at the end of a circuit and its
+ * partial derivatives with respect to each of the circuit parameters.
+ * */
+struct Gradient {
+    double value;
+    std::vector<double> derivatives;
+};
+
+/**
+ * Differentiate <psi|O|psi>, where |psi> is the state prepared by `circuit`
+ * from |0...0>, with respect to all of the circuit parameters using the adjoint
+ * method: after a single forward pass the gates are undone one at a time on
+ * the state and on the co-state O|psi>, and the derivative with respect to each
+ * angle of a U gate is read from the pair at that point. The parameters of
+ * declared gates are handled by the chain rule through the angles of the U
+ * gates they expand into.
+ *
+ * The circuit must be unitary, i.e., without measures, resets or conditions.
+ * */
+Gradient gradient(const Circuit& circuit, const Observable& observable,
+                  const std::vector<double>& parameters);
+
+/**
+ * Differentiate using the parameter values written in the program
+ * */
+Gradient gradient(const Circuit& circuit, const Observable& observable);
+
+}
+
+#endif // __RUNTIME__ADJOINT_H__
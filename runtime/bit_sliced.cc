@@ -0,0 +1,379 @@
+/**
+ * Copyright (c) 2022 Alcides Andrade <andrade.alcides.junior@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "bit_sliced.hpp"
+
+#include <cassert>
+#include <cmath>
+#include <complex>
+
+#include "error.hpp"
+#include "gate.hpp"
+
+namespace runtime {
+
+// longest run of gates merged while looking for a permutation
+static const size_t max_block_size = 64;
+
+/**
+ * The columns of the product of the gates of a block acting on at most three
+ * qubits, where the slot `s` of a column index is the qubit `slots[s]`
+ * */
+struct Block {
+    std::vector<size_t> slots;
+    std::array<std::array<std::complex<double>, 8>, 8> columns {};
+
+    Block() {
+        for (size_t c = 0; c < 8; c++) {
+            columns[c][c] = 1;
+        }
+    }
+
+    /**
+     * The slot of the qubit, adding it to the block if there is room
+     * */
+    std::optional<size_t> slot(size_t qubit) {
+        for (size_t s = 0; s < slots.size(); s++) {
+            if (slots[s] == qubit) {
+                return s;
+            }
+        }
+        if (slots.size() == 3) {
+            return std::nullopt;
+        }
+        slots.push_back(qubit);
+        return slots.size() - 1;
+    }
+
+    void apply_u(const math::unitary_t& u, size_t s) {
+        size_t bit = size_t(1) << s;
+        for (auto& column : columns) {
+            for (size_t i = 0; i < 8; i++) {
+                if (i & bit) {
+                    continue;
+                }
+                auto a = column[i], b = column[i | bit];
+                column[i] = std::complex<double>(u(0, 0))*a + std::complex<double>(u(0, 1))*b;
+                column[i | bit] = std::complex<double>(u(1, 0))*a + std::complex<double>(u(1, 1))*b;
+            }
+        }
+    }
+
+    void apply_cx(size_t c, size_t t) {
+        for (auto& column : columns) {
+            for (size_t i = 0; i < 8; i++) {
+                if ((i >> c & 1) && !(i >> t & 1)) {
+                    std::swap(column[i], column[i | (size_t(1) << t)]);
+                }
+            }
+        }
+    }
+
+    /**
+     * The row of the only nonzero entry of each column, if the product is a
+     * permutation matrix up to phases
+     * */
+    std::optional<std::array<uint8_t, 8>> permutation() const {
+        std::array<uint8_t, 8> table;
+        for (size_t c = 0; c < 8; c++) {
+            size_t nonzeros = 0;
+            for (size_t r = 0; r < 8; r++) {
+                if (std::abs(columns[c][r]) > 1e-3) {
+                    table[c] = r;
+                    nonzeros++;
+                }
+            }
+            if (nonzeros != 1) {
+                return std::nullopt;
+            }
+        }
+        return table;
+    }
+};
+
+static std::map<std::string, std::pair<size_t, size_t>> classical_layout(const Circuit& circuit) {
+    std::map<std::string, std::pair<size_t, size_t>> res;
+    size_t offset = 0;
+    for (auto& [name, size] : circuit.classical_registers) {
+        res[name] = { offset, size };
+        offset += size;
+    }
+    return res;
+}
+
+bool BitSliced::supports(const Circuit& circuit) {
+    return compile(circuit, classical_layout(circuit)).has_value();
+}
+
+/**
+ * Turn the permutation `table` of the qubits `slots` into the cheapest
+ * instruction computing it, or none if it is the identity
+ * */
+template <typename Instruction>
+static std::optional<Instruction> classify(const std::vector<size_t>& slots,
+                                           const std::array<uint8_t, 8>& table)
+{
+    size_t n = slots.size();
+    size_t changed = 0;
+    for (size_t p = 0; p < (size_t(1) << n); p++) {
+        changed |= table[p] ^ p;
+    }
+    if (changed == 0) {
+        return std::nullopt;
+    }
+    Instruction res {};
+    res.kind = Instruction::Table;
+    res.nr_qubits = n;
+    std::copy(slots.begin(), slots.end(), res.qubits.begin());
+    res.table = table;
+    if (__builtin_popcountll(changed) != 1) {
+        return res;
+    }
+    // look for the controls of a single flipped target
+    size_t t = __builtin_ctzll(changed);
+    size_t others = ((size_t(1) << n) - 1) & ~changed;
+    for (size_t controls = others;; controls = (controls - 1) & others) {
+        bool matches = true;
+        for (size_t p = 0; p < (size_t(1) << n) && matches; p++) {
+            bool flipped = (table[p] ^ p) >> t & 1;
+            matches = flipped == ((p & controls) == controls);
+        }
+        if (matches) {
+            static const typename Instruction::Kind kinds[] = {
+                Instruction::Not, Instruction::Cnot, Instruction::Toffoli,
+            };
+            res.kind = kinds[__builtin_popcountll(controls)];
+            res.nr_qubits = 0;
+            for (size_t s = 0; s < n; s++) {
+                if (controls >> s & 1) {
+                    res.qubits[res.nr_qubits++] = slots[s];
+                }
+            }
+            res.qubits[res.nr_qubits++] = slots[t];
+            return res;
+        }
+        if (controls == 0) {
+            break;
+        }
+    }
+    return res;
+}
+
+std::optional<std::vector<BitSliced::Instruction>> BitSliced::compile(
+    const Circuit& circuit, const std::map<std::string, std::pair<size_t, size_t>>& cregs)
+{
+    std::vector<Instruction> res;
+    auto& operations = circuit.operations;
+    for (size_t i = 0; i < operations.size();) {
+        auto& operation = operations[i];
+        std::optional<std::array<size_t, 3>> condition;
+        if (operation.condition.has_value()) {
+            auto& [creg, value] = operation.condition.value();
+            auto [first, size] = cregs.at(creg);
+            condition = { first, size, size_t(value) };
+        }
+        if (operation.type == Operation::Barrier) {
+            i++;
+            continue;
+        }
+        if (operation.type == Operation::Measure || operation.type == Operation::Reset) {
+            Instruction instruction {};
+            instruction.kind = operation.type == Operation::Measure ?
+                Instruction::Measure : Instruction::Reset;
+            instruction.qubits[0] = operation.qubits[0];
+            instruction.nr_qubits = 1;
+            if (operation.type == Operation::Measure) {
+                instruction.bit = cregs.at(operation.creg).first + operation.bit;
+            }
+            instruction.condition = condition;
+            res.push_back(instruction);
+            i++;
+            continue;
+        }
+        // merge gates with the same condition until their product is a permutation
+        Block block;
+        std::optional<std::array<uint8_t, 8>> table;
+        size_t j = i;
+        for (; j < operations.size() && j < i + max_block_size && !table; j++) {
+            auto& gate = operations[j];
+            if ((gate.type != Operation::U && gate.type != Operation::CX) ||
+                gate.condition != operation.condition) {
+                break;
+            }
+            if (gate.type == Operation::CX) {
+                auto c = block.slot(gate.qubits[0]);
+                auto t = block.slot(gate.qubits[1]);
+                if (!c || !t) {
+                    break;
+                }
+                block.apply_cx(*c, *t);
+            } else {
+                auto s = block.slot(gate.qubits[0]);
+                if (!s) {
+                    break;
+                }
+                auto& [theta, phi, lambda] = gate.angles;
+                block.apply_u(Gate::u(theta.evaluate(circuit.parameters),
+                                      phi.evaluate(circuit.parameters),
+                                      lambda.evaluate(circuit.parameters)), *s);
+            }
+            table = block.permutation();
+        }
+        if (!table) {
+            return std::nullopt;
+        }
+        if (auto instruction = classify<Instruction>(block.slots, *table)) {
+            instruction->condition = condition;
+            res.push_back(*instruction);
+        }
+        i = j;
+    }
+    return res;
+}
+
+BitSliced::BitSliced(const Circuit& circuit):
+    _nr_qubits(circuit.nr_qubits), _classical_registers(classical_layout(circuit))
+{
+    auto instructions = compile(circuit, _classical_registers);
+    if (!instructions) {
+        throw Error("the bit-sliced simulator only runs circuits that permute the basis states");
+    }
+    _instructions = std::move(*instructions);
+    for (auto& [_, size] : circuit.classical_registers) {
+        _nr_classical_bits += size;
+    }
+}
+
+void BitSliced::run(std::vector<word_t>& qubits, std::vector<word_t>& bits, size_t nr_words) const {
+    assert(qubits.size() == _nr_qubits*nr_words);
+    assert(bits.size() == _nr_classical_bits*nr_words);
+    std::vector<word_t> mask(nr_words, ~word_t(0));
+    for (auto& instruction : _instructions) {
+        if (instruction.condition.has_value()) {
+            auto [first, size, value] = instruction.condition.value();
+            // a value wider than the register never matches
+            bool in_range = size >= word_bits || (value >> size) == 0;
+            std::fill(mask.begin(), mask.end(), in_range ? ~word_t(0) : 0);
+            for (size_t k = 0; k < size && in_range; k++) {
+                const word_t* b = bits.data() + (first + k)*nr_words;
+                word_t expected = (value >> k & 1) ? ~word_t(0) : 0;
+                for (size_t w = 0; w < nr_words; w++) {
+                    mask[w] &= ~(b[w] ^ expected);
+                }
+            }
+        }
+        const word_t* m = mask.data();
+        word_t* row[3];
+        for (size_t s = 0; s < instruction.nr_qubits; s++) {
+            row[s] = qubits.data() + instruction.qubits[s]*nr_words;
+        }
+        switch (instruction.kind) {
+        case Instruction::Not:
+            for (size_t w = 0; w < nr_words; w++) {
+                row[0][w] ^= m[w];
+            }
+            break;
+        case Instruction::Cnot:
+            for (size_t w = 0; w < nr_words; w++) {
+                row[1][w] ^= row[0][w] & m[w];
+            }
+            break;
+        case Instruction::Toffoli:
+            for (size_t w = 0; w < nr_words; w++) {
+                row[2][w] ^= row[0][w] & row[1][w] & m[w];
+            }
+            break;
+        case Instruction::Table: {
+            size_t n = instruction.nr_qubits;
+            for (size_t w = 0; w < nr_words; w++) {
+                word_t out[3] = { 0, 0, 0 };
+                for (size_t p = 0; p < (size_t(1) << n); p++) {
+                    // the inputs whose qubits are the pattern `p`
+                    word_t minterm = ~word_t(0);
+                    for (size_t s = 0; s < n; s++) {
+                        minterm &= (p >> s & 1) ? row[s][w] : ~row[s][w];
+                    }
+                    for (size_t s = 0; s < n; s++) {
+                        out[s] |= (instruction.table[p] >> s & 1) ? minterm : 0;
+                    }
+                }
+                for (size_t s = 0; s < n; s++) {
+                    row[s][w] = (row[s][w] & ~m[w]) | (out[s] & m[w]);
+                }
+            }
+            break;
+        }
+        case Instruction::Measure: {
+            word_t* b = bits.data() + instruction.bit*nr_words;
+            for (size_t w = 0; w < nr_words; w++) {
+                b[w] = (b[w] & ~m[w]) | (row[0][w] & m[w]);
+            }
+            break;
+        }
+        case Instruction::Reset:
+            for (size_t w = 0; w < nr_words; w++) {
+                row[0][w] &= ~m[w];
+            }
+            break;
+        }
+        if (instruction.condition.has_value()) {
+            std::fill(mask.begin(), mask.end(), ~word_t(0));
+        }
+    }
+}
+
+std::vector<std::vector<bool>> BitSliced::evaluate(const std::vector<std::vector<bool>>& inputs) const {
+    size_t nr_words = (inputs.size() + word_bits - 1)/word_bits;
+    std::vector<word_t> qubits(_nr_qubits*nr_words);
+    std::vector<word_t> bits(_nr_classical_bits*nr_words);
+    for (size_t i = 0; i < inputs.size(); i++) {
+        assert(inputs[i].size() == _nr_qubits);
+        for (size_t q = 0; q < _nr_qubits; q++) {
+            qubits[q*nr_words + i/word_bits] |= word_t(inputs[i][q]) << (i % word_bits);
+        }
+    }
+    run(qubits, bits, nr_words);
+    std::vector<std::vector<bool>> res(inputs.size(), std::vector<bool>(_nr_qubits));
+    for (size_t i = 0; i < inputs.size(); i++) {
+        for (size_t q = 0; q < _nr_qubits; q++) {
+            res[i][q] = qubits[q*nr_words + i/word_bits] >> (i % word_bits) & 1;
+        }
+    }
+    return res;
+}
+
+std::map<std::string, std::vector<bool>> BitSliced::unpack(const std::vector<word_t>& bits,
+                                                           size_t nr_words, size_t lane) const
+{
+    std::map<std::string, std::vector<bool>> res;
+    for (auto& [name, layout] : _classical_registers) {
+        auto [first, size] = layout;
+        std::vector<bool> value(size);
+        for (size_t i = 0; i < size; i++) {
+            value[i] = bits[(first + i)*nr_words + lane/word_bits] >> (lane % word_bits) & 1;
+        }
+        res[name] = value;
+    }
+    return res;
+}
+
+}
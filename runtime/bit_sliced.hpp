@@ -0,0 +1,130 @@
+/**
+ * Copyright (c) 2022 Alcides Andrade <andrade.alcides.junior@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef __RUNTIME__BIT_SLICED_H__
+#define __RUNTIME__BIT_SLICED_H__
+
+#include <array>
+#include <cstdint>
+#include <map>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "circuit.hpp"
+
+namespace runtime {
+
+/**
+ * A simulator for reversible circuits, i.e., circuits that map every basis
+ * state to a basis state up to a phase, run on basis-state inputs.
+ *
+ * The circuit is compiled into boolean operations on the bits of the basis
+ * state: NOT, CNOT, Toffoli and the truth table of any other permutation of
+ * up to three qubits. A U gate that is not a permutation by itself, such as
+ * the H of the decomposition of `ccx`, is merged with the following gates on
+ * the same qubits until their product is a permutation matrix up to phases.
+ * The phases are discarded, since they never change the outcome of a
+ * measurement of a basis state.
+ *
+ * The inputs are bit-sliced: the qubit `q` of the input `i` is the bit `i % 64`
+ * of the word `i / 64` of the row of `q`, so that every operation evaluates
+ * 64 inputs per word, and the loops over the words of a row are vectorized
+ * by the compiler for wider registers.
+ * */
+class BitSliced {
+public:
+    using word_t = uint64_t;
+    static constexpr size_t word_bits = 64;
+
+    /**
+     * Whether every operation of the circuit is part of a permutation
+     * */
+    static bool supports(const Circuit& circuit);
+
+    /**
+     * Compile the circuit, binding it to its own parameter values.
+     * Throws `Error` if the circuit is not supported.
+     * */
+    BitSliced(const Circuit& circuit);
+
+    inline size_t nr_qubits() const {
+        return _nr_qubits;
+    }
+
+    inline size_t nr_classical_bits() const {
+        return _nr_classical_bits;
+    }
+
+    /**
+     * Run the circuit on the bit-sliced inputs `qubits`, which hold `nr_words`
+     * words for each qubit, one qubit after the other. The classical bits are
+     * written to `bits` with the same layout, where the bit `i` of the register
+     * `c` is the row `offset(c) + i`; they start at zero.
+     * */
+    void run(std::vector<word_t>& qubits, std::vector<word_t>& bits, size_t nr_words) const;
+
+    /**
+     * Run the circuit on each of the basis states `inputs`, whose entry `q`
+     * is the value of the qubit `q`, and return the final basis states
+     * */
+    std::vector<std::vector<bool>> evaluate(const std::vector<std::vector<bool>>& inputs) const;
+
+    /**
+     * The classical registers of the input `lane` in the result of `run`
+     * */
+    std::map<std::string, std::vector<bool>> unpack(const std::vector<word_t>& bits,
+                                                    size_t nr_words, size_t lane) const;
+
+private:
+    struct Instruction {
+        enum Kind { Not, Cnot, Toffoli, Table, Measure, Reset };
+
+        Kind kind;
+        // for Not, Cnot and Toffoli the controls followed by the target
+        std::array<size_t, 3> qubits;
+        size_t nr_qubits;
+        // for Table, the output of each input; bit s is the qubit `qubits[s]`
+        std::array<uint8_t, 8> table;
+        // bit written by a measure
+        size_t bit;
+        // the instruction runs on the inputs whose classical register
+        // at (first bit, size) equals the value
+        std::optional<std::array<size_t, 3>> condition;
+    };
+
+    size_t _nr_qubits;
+    size_t _nr_classical_bits { 0 };
+    std::vector<Instruction> _instructions;
+    // (first bit, size) of every classical register in the rows of `run`
+    std::map<std::string, std::pair<size_t, size_t>> _classical_registers;
+
+    /**
+     * The instructions of the circuit, or none if it is not a permutation
+     * */
+    static std::optional<std::vector<Instruction>> compile(
+        const Circuit& circuit, const std::map<std::string, std::pair<size_t, size_t>>& cregs);
+};
+
+}
+
+#endif // __RUNTIME__BIT_SLICED_H__
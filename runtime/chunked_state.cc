@@ -0,0 +1,58 @@
+/**
+ * Copyright (c) 2022 Alcides Andrade <andrade.alcides.junior@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "chunked_state.hpp"
+
+#include "gate.hpp"
+
+namespace runtime {
+
+ChunkedState::ChunkedState(size_t nr_qubits, size_t chunk_qubits,
+                           std::unique_ptr<math::ChunkStore> store):
+    _vector(nr_qubits, chunk_qubits, std::move(store))
+{}
+
+void ChunkedState::apply(const Operation& operation, const std::vector<double>& parameters) {
+    if (operation.type == Operation::CX) {
+        _vector.apply(Gate::cx(), operation.qubits);
+    } else {
+        auto& [theta, phi, lambda] = operation.angles;
+        _vector.apply(Gate::u(theta.evaluate(parameters),
+                              phi.evaluate(parameters),
+                              lambda.evaluate(parameters)),
+                      operation.qubits);
+    }
+}
+
+bool ChunkedState::measure(size_t qubit) {
+    return _vector.measure(qubit);
+}
+
+void ChunkedState::reset(size_t qubit) {
+    _vector.reset(qubit);
+}
+
+math::cx_t ChunkedState::amplitude(size_t index) {
+    return _vector.get(index);
+}
+
+}
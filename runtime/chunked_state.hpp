@@ -0,0 +1,77 @@
+/**
+ * Copyright (c) 2022 Alcides Andrade <andrade.alcides.junior@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef __RUNTIME__CHUNKED_STATE_H__
+#define __RUNTIME__CHUNKED_STATE_H__
+
+#include <memory>
+#include <vector>
+
+#include "circuit.hpp"
+#include "math/chunked_vector.hpp"
+
+namespace runtime {
+
+/**
+ * The state of the `OutOfCore` backend: a state vector kept in the chunks of
+ * a `math::ChunkedVector`, either in a file, so that it is not limited by the
+ * memory of the machine, or in memory chunks that are only allocated once a
+ * gate writes to them, so that a state with few nonzero amplitudes takes
+ * little memory. Gates, measurements and resets are forwarded to the vector, which
+ * queues them into passes over its chunks.
+ * */
+class ChunkedState {
+public:
+    /**
+     * The state |0...0> on `nr_qubits` qubits, in chunks of at most
+     * 2^chunk_qubits amplitudes kept in `store`
+     * */
+    ChunkedState(size_t nr_qubits, size_t chunk_qubits, std::unique_ptr<math::ChunkStore> store);
+
+    /**
+     * Apply a U or CX operation of a circuit
+     * */
+    void apply(const Operation& operation, const std::vector<double>& parameters);
+
+    bool measure(size_t qubit);
+    void reset(size_t qubit);
+
+    /**
+     * The amplitude of the basis state `index`, whose bit k is the qubit k
+     * */
+    math::cx_t amplitude(size_t index);
+
+    inline const math::ChunkedVector::Stats& stats() const {
+        return _vector.stats();
+    }
+
+    inline const math::ChunkStore& store() const {
+        return _vector.store();
+    }
+
+private:
+    math::ChunkedVector _vector;
+};
+
+}
+
+#endif // __RUNTIME__CHUNKED_STATE_H__
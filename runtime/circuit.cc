@@ -0,0 +1,745 @@
+/**
+ * Copyright (c) 2022 Alcides Andrade <andrade.alcides.junior@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "circuit.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <memory>
+#include <unordered_map>
+#include <unordered_set>
+
+#include "error.hpp"
+
+namespace runtime {
+
+/**
+ * Bindings of the parameters and arguments of a gate declaration while
+ * its body is being expanded.
+ * */
+struct Scope {
+    std::unordered_map<std::string, Angle> parameters;
+    std::unordered_map<std::string, size_t> arguments;
+};
+
+using Condition = std::optional<std::pair<std::string, unsigned long>>;
+
+/**
+ * Lower the statements of a program into the operations of a circuit.
+ * */
+class Compiler {
+public:
+    Compiler(Circuit& circuit): _circuit(circuit) {};
+
+    void compile(const lang::Program& program);
+
+private:
+    Circuit& _circuit;
+    std::unordered_map<std::string, std::shared_ptr<lang::GateDeclaration>> _gates;
+    std::unordered_set<std::string> _opaque_gates;
+    // gates currently being expanded, used to reject recursive definitions
+    std::unordered_set<std::string> _expanding;
+
+    void declare_register(const lang::VariableDeclaration&);
+    void lower_statement(const std::shared_ptr<lang::Statement>&, const Condition&);
+    void lower_unitary(const lang::UnitaryOperation&, const Condition&);
+    void lower_measure(const lang::MeasureOperation&, const Condition&);
+    void lower_reset(const lang::ResetOperation&, const Condition&);
+    void lower_barrier(const lang::BarrierOperation&, const Condition&);
+
+    /**
+     * Emit the primitive operations of `unitary` applied to `qubits` with the
+     * parameters `parameters`.
+     * */
+    void expand(const lang::UnitaryOperation& unitary, const std::vector<Angle>& parameters,
+                const std::vector<size_t>& qubits, const Condition&, size_t line);
+
+    /**
+     * Resolve the arguments of a top level operation into lists of qubits, one
+     * for each application of the operation when registers are broadcast.
+     * */
+    std::vector<std::vector<size_t>> broadcast(const std::vector<lang::Variable>&, size_t line);
+
+    std::tuple<size_t, size_t> quantum_register(const lang::Variable&, size_t line);
+};
+
+/**
+ * Append to `angle` the postfix program of `expression`, where the names in `scope`
+ * are replaced by the angles they are bound to.
+ * */
+static void lower_expression(const std::shared_ptr<lang::Expression>& expression,
+                             const Scope* scope, Angle& angle, size_t line);
+
+Angle Angle::constant(double value) {
+    Angle angle;
+    angle.program.push_back({ Constant, value, 0 });
+    return angle;
+}
+
+Angle Angle::parameter(size_t index) {
+    Angle angle;
+    angle.program.push_back({ Parameter, 0, index });
+    return angle;
+}
+
+double Angle::evaluate(const std::vector<double>& parameters) const {
+    if (program.empty()) {
+        return 0;
+    }
+    std::vector<double> stack(program.size());
+    size_t top = 0;
+    for (auto& instruction : program) {
+        switch (instruction.opcode) {
+        case Constant:  stack[top++] = instruction.value; break;
+        case Parameter: stack[top++] = parameters[instruction.parameter]; break;
+        case Negate:    stack[top - 1] = -stack[top - 1]; break;
+        case Add:       top--; stack[top - 1] += stack[top]; break;
+        case Subtract:  top--; stack[top - 1] -= stack[top]; break;
+        case Multiply:  top--; stack[top - 1] *= stack[top]; break;
+        case Divide:    top--; stack[top - 1] /= stack[top]; break;
+        case Power:     top--; stack[top - 1] = std::pow(stack[top - 1], stack[top]); break;
+        case Sin:       stack[top - 1] = std::sin(stack[top - 1]); break;
+        case Cos:       stack[top - 1] = std::cos(stack[top - 1]); break;
+        case Tan:       stack[top - 1] = std::tan(stack[top - 1]); break;
+        case Exp:       stack[top - 1] = std::exp(stack[top - 1]); break;
+        case Ln:        stack[top - 1] = std::log(stack[top - 1]); break;
+        case Sqrt:      stack[top - 1] = std::sqrt(stack[top - 1]); break;
+        }
+    }
+    return stack[0];
+}
+
+double Angle::derivative(const std::vector<double>& parameters, size_t index) const {
+    if (program.empty()) {
+        return 0;
+    }
+    // forward mode differentiation: every stack entry keeps a value and its derivative
+    std::vector<std::pair<double, double>> stack;
+    stack.reserve(program.size());
+    for (auto& instruction : program) {
+        if (instruction.opcode == Constant) {
+            stack.push_back({ instruction.value, 0 });
+            continue;
+        }
+        if (instruction.opcode == Parameter) {
+            stack.push_back({ parameters[instruction.parameter],
+                              instruction.parameter == index ? 1 : 0 });
+            continue;
+        }
+        if (instruction.opcode >= Add && instruction.opcode <= Power) {
+            auto [b, db] = stack.back();
+            stack.pop_back();
+            auto& [a, da] = stack.back();
+            switch (instruction.opcode) {
+            case Add:      da += db; a += b; break;
+            case Subtract: da -= db; a -= b; break;
+            case Multiply: da = da*b + a*db; a *= b; break;
+            case Divide:   da = (da*b - a*db)/(b*b); a /= b; break;
+            default: {
+                double p = std::pow(a, b);
+                da = b*std::pow(a, b - 1)*da + (db != 0 ? p*std::log(a)*db : 0);
+                a = p;
+            }
+            }
+            continue;
+        }
+        auto& [a, da] = stack.back();
+        switch (instruction.opcode) {
+        case Negate: a = -a; da = -da; break;
+        case Sin:    da *= std::cos(a); a = std::sin(a); break;
+        case Cos:    da *= -std::sin(a); a = std::cos(a); break;
+        case Tan:    da /= std::cos(a)*std::cos(a); a = std::tan(a); break;
+        case Exp:    a = std::exp(a); da *= a; break;
+        case Ln:     da /= a; a = std::log(a); break;
+        default:     a = std::sqrt(a); da /= 2*a; break;
+        }
+    }
+    return stack[0].second;
+}
+
+std::vector<size_t> Angle::dependencies() const {
+    std::vector<size_t> res;
+    for (auto& instruction : program) {
+        if (instruction.opcode == Parameter) {
+            res.push_back(instruction.parameter);
+        }
+    }
+    std::sort(res.begin(), res.end());
+    res.erase(std::unique(res.begin(), res.end()), res.end());
+    return res;
+}
+
+Circuit Circuit::compile(const lang::Program& program) {
+    Circuit circuit;
+    Compiler(circuit).compile(program);
+    return circuit;
+}
+
+std::vector<std::pair<std::string, size_t>> Circuit::quantum_registers_in_order() const {
+    std::vector<std::tuple<size_t, std::string, size_t>> registers;
+    for (auto& [name, reg] : quantum_registers) {
+        registers.push_back({ std::get<0>(reg), name, std::get<1>(reg) });
+    }
+    std::sort(registers.begin(), registers.end());
+    std::vector<std::pair<std::string, size_t>> res;
+    for (auto& [_, name, size] : registers) {
+        res.push_back({ name, size });
+    }
+    return res;
+}
+
+std::vector<size_t> Circuit::components() const {
+    // union-find where every set is represented by its smallest qubit
+    std::vector<size_t> parent(nr_qubits);
+    for (size_t q = 0; q < nr_qubits; q++) {
+        parent[q] = q;
+    }
+    auto find = [&](size_t q) {
+        while (parent[q] != q) {
+            parent[q] = parent[parent[q]];
+            q = parent[q];
+        }
+        return q;
+    };
+    for (auto& operation : operations) {
+        if (operation.type != Operation::CX) {
+            continue;
+        }
+        size_t a = find(operation.qubits[0]);
+        size_t b = find(operation.qubits[1]);
+        parent[std::max(a, b)] = std::min(a, b);
+    }
+    std::vector<size_t> res(nr_qubits);
+    for (size_t q = 0; q < nr_qubits; q++) {
+        res[q] = find(q);
+    }
+    return res;
+}
+
+/**
+ * Little helpers for the binary encoding of a circuit, where every value is
+ * stored with its in-memory representation and containers are prefixed by
+ * their size.
+ * */
+template <typename T>
+static void write(std::string& out, const T& value) {
+    out.append(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+static void write(std::string& out, const std::string& value) {
+    write(out, value.size());
+    out += value;
+}
+
+static void write(std::string& out, const std::vector<size_t>& values) {
+    write(out, values.size());
+    for (auto value : values) {
+        write(out, value);
+    }
+}
+
+struct Reader {
+    const std::string& bytes;
+    size_t position { 0 };
+
+    template <typename T>
+    T read() {
+        if (bytes.size() - position < sizeof(T)) {
+            throw Error("truncated circuit");
+        }
+        T value;
+        std::memcpy(&value, bytes.data() + position, sizeof(T));
+        position += sizeof(T);
+        return value;
+    }
+
+    std::string read_string() {
+        size_t size = read<size_t>();
+        if (bytes.size() - position < size) {
+            throw Error("truncated circuit");
+        }
+        position += size;
+        return bytes.substr(position - size, size);
+    }
+
+    std::vector<size_t> read_indices() {
+        size_t size = read<size_t>();
+        if ((bytes.size() - position)/sizeof(size_t) < size) {
+            throw Error("truncated circuit");
+        }
+        std::vector<size_t> values(size);
+        for (auto& value : values) {
+            value = read<size_t>();
+        }
+        return values;
+    }
+};
+
+// written at the start of a serialized circuit
+static const uint32_t circuit_magic = 0x43515331;
+
+std::string Circuit::serialize() const {
+    std::string out;
+    write(out, circuit_magic);
+    write(out, nr_qubits);
+    write(out, quantum_registers.size());
+    for (auto& [name, reg] : quantum_registers) {
+        write(out, name);
+        write(out, std::get<0>(reg));
+        write(out, std::get<1>(reg));
+    }
+    write(out, classical_registers.size());
+    for (auto& [name, size] : classical_registers) {
+        write(out, name);
+        write(out, size);
+    }
+    write(out, parameters.size());
+    for (auto value : parameters) {
+        write(out, value);
+    }
+    write(out, operations.size());
+    for (auto& operation : operations) {
+        write(out, uint8_t(operation.type));
+        write(out, operation.qubits);
+        for (auto& angle : operation.angles) {
+            write(out, angle.program.size());
+            for (auto& instruction : angle.program) {
+                write(out, uint8_t(instruction.opcode));
+                write(out, instruction.value);
+                write(out, instruction.parameter);
+            }
+        }
+        write(out, operation.creg);
+        write(out, operation.bit);
+        write(out, uint8_t(operation.condition.has_value()));
+        if (operation.condition.has_value()) {
+            write(out, operation.condition->first);
+            write(out, operation.condition->second);
+        }
+        write(out, operation.line);
+    }
+    write(out, applications.size());
+    for (auto& application : applications) {
+        write(out, application.name);
+        write(out, application.qubits);
+        write(out, application.last);
+    }
+    return out;
+}
+
+Circuit Circuit::deserialize(const std::string& bytes) {
+    Reader in { bytes };
+    if (in.read<uint32_t>() != circuit_magic) {
+        throw Error("not a serialized circuit");
+    }
+    Circuit circuit;
+    circuit.nr_qubits = in.read<size_t>();
+    for (size_t i = in.read<size_t>(); i > 0; i--) {
+        auto name = in.read_string();
+        size_t offset = in.read<size_t>();
+        circuit.quantum_registers[name] = { offset, in.read<size_t>() };
+    }
+    for (size_t i = in.read<size_t>(); i > 0; i--) {
+        auto name = in.read_string();
+        circuit.classical_registers[name] = in.read<size_t>();
+    }
+    for (size_t i = in.read<size_t>(); i > 0; i--) {
+        circuit.parameters.push_back(in.read<double>());
+    }
+    for (size_t i = in.read<size_t>(); i > 0; i--) {
+        Operation operation;
+        uint8_t type = in.read<uint8_t>();
+        if (type > Operation::Barrier) {
+            throw Error("invalid operation in serialized circuit");
+        }
+        operation.type = Operation::Type(type);
+        operation.qubits = in.read_indices();
+        for (auto& angle : operation.angles) {
+            for (size_t j = in.read<size_t>(); j > 0; j--) {
+                Angle::Instruction instruction;
+                uint8_t opcode = in.read<uint8_t>();
+                if (opcode > Angle::Sqrt) {
+                    throw Error("invalid angle in serialized circuit");
+                }
+                instruction.opcode = Angle::Opcode(opcode);
+                instruction.value = in.read<double>();
+                instruction.parameter = in.read<size_t>();
+                angle.program.push_back(instruction);
+            }
+        }
+        operation.creg = in.read_string();
+        operation.bit = in.read<size_t>();
+        if (in.read<uint8_t>()) {
+            auto creg = in.read_string();
+            operation.condition = { creg, in.read<unsigned long>() };
+        }
+        operation.line = in.read<size_t>();
+        circuit.operations.push_back(std::move(operation));
+    }
+    for (size_t i = in.read<size_t>(); i > 0; i--) {
+        GateApplication application;
+        application.name = in.read_string();
+        application.qubits = in.read_indices();
+        application.last = in.read<size_t>();
+        circuit.applications.push_back(std::move(application));
+    }
+    if (in.position != bytes.size()) {
+        throw Error("trailing bytes after serialized circuit");
+    }
+    return circuit;
+}
+
+void Compiler::compile(const lang::Program& program) {
+    for (auto& stmt : program.statements) {
+        if (auto declaration = std::dynamic_pointer_cast<lang::VariableDeclaration>(stmt)) {
+            declare_register(*declaration);
+        } else if (auto declaration = std::dynamic_pointer_cast<lang::GateDeclaration>(stmt)) {
+            _gates[declaration->identifier] = declaration;
+        } else if (auto declaration = std::dynamic_pointer_cast<lang::OpaqueDeclaration>(stmt)) {
+            _opaque_gates.insert(declaration->identifier);
+        } else if (auto ifstmt = std::dynamic_pointer_cast<lang::IfStatement>(stmt)) {
+            auto& creg = ifstmt->variable.identifier;
+            if (_circuit.classical_registers.find(creg) == _circuit.classical_registers.end()) {
+                throw Error("undefined classical register `" + creg + "` (" +
+                            std::to_string(stmt->context.start_line) + ")");
+            }
+            Angle value;
+            lower_expression(ifstmt->target_to_compare, nullptr, value,
+                             stmt->context.start_line);
+            Condition condition = std::make_pair(creg, std::lround(value.evaluate({})));
+            lower_statement(ifstmt->conditional_operation, condition);
+        } else if (std::dynamic_pointer_cast<lang::Comment>(stmt)) {
+            // nothing to do
+        } else {
+            lower_statement(stmt, std::nullopt);
+        }
+    }
+}
+
+void Compiler::declare_register(const lang::VariableDeclaration& declaration) {
+    if (declaration.type == lang::VariableDeclaration::Qbit) {
+        _circuit.quantum_registers[declaration.identifier] = {
+            _circuit.nr_qubits, declaration.dimension
+        };
+        _circuit.nr_qubits += declaration.dimension;
+    } else {
+        _circuit.classical_registers[declaration.identifier] = declaration.dimension;
+    }
+}
+
+void Compiler::lower_statement(const std::shared_ptr<lang::Statement>& stmt,
+                               const Condition& condition)
+{
+    if (auto unitary = std::dynamic_pointer_cast<lang::UnitaryOperation>(stmt)) {
+        lower_unitary(*unitary, condition);
+    } else if (auto measure = std::dynamic_pointer_cast<lang::MeasureOperation>(stmt)) {
+        lower_measure(*measure, condition);
+    } else if (auto reset = std::dynamic_pointer_cast<lang::ResetOperation>(stmt)) {
+        lower_reset(*reset, condition);
+    } else if (auto barrier = std::dynamic_pointer_cast<lang::BarrierOperation>(stmt)) {
+        lower_barrier(*barrier, condition);
+    } else {
+        throw Error("undefined statement (" + std::to_string(stmt->context.start_line) + ")");
+    }
+}
+
+void Compiler::lower_unitary(const lang::UnitaryOperation& unitary, const Condition& condition) {
+    size_t line = unitary.context.start_line;
+    // every top level parameter becomes a parameter of the circuit
+    std::vector<Angle> parameters;
+    if (unitary.expression_list.has_value()) {
+        for (auto& expression : unitary.expression_list.value().expression_list) {
+            Angle angle;
+            lower_expression(expression, nullptr, angle, line);
+            parameters.push_back(Angle::parameter(_circuit.parameters.size()));
+            _circuit.parameters.push_back(angle.evaluate({}));
+        }
+    }
+    std::string name = unitary.op == lang::UnitaryOperation::U ? "U" :
+                       unitary.op == lang::UnitaryOperation::CX ? "CX" : unitary.operator_name;
+    for (auto& qubits : broadcast(unitary.argument_list.mixed_list, line)) {
+        size_t first = _circuit.operations.size();
+        expand(unitary, parameters, qubits, condition, line);
+        if (_circuit.operations.size() > first) {
+            _circuit.applications.push_back({ name, qubits, _circuit.operations.size() - 1 });
+        }
+    }
+}
+
+void Compiler::expand(const lang::UnitaryOperation& unitary, const std::vector<Angle>& parameters,
+                      const std::vector<size_t>& qubits, const Condition& condition, size_t line)
+{
+    if (unitary.op == lang::UnitaryOperation::U) {
+        if (parameters.size() != 3 || qubits.size() != 1) {
+            throw Error("U expects 3 parameters and 1 argument (" + std::to_string(line) + ")");
+        }
+        Operation operation { Operation::U, qubits, {}, "", 0, condition, line };
+        operation.angles = { parameters[0], parameters[1], parameters[2] };
+        _circuit.operations.push_back(std::move(operation));
+        return;
+    }
+    if (unitary.op == lang::UnitaryOperation::CX) {
+        if (qubits.size() != 2) {
+            throw Error("CX expects 2 arguments (" + std::to_string(line) + ")");
+        }
+        if (qubits[0] == qubits[1]) {
+            throw Error("the control and target of CX must be different qubits (" +
+                        std::to_string(line) + ")");
+        }
+        _circuit.operations.push_back({ Operation::CX, qubits, {}, "", 0, condition, line });
+        return;
+    }
+
+    auto& name = unitary.operator_name;
+    if (_opaque_gates.find(name) != _opaque_gates.end()) {
+        throw Error("opaque gate `" + name + "` cannot be simulated (" +
+                    std::to_string(line) + ")");
+    }
+    auto declaration = _gates.find(name);
+    if (declaration == _gates.end()) {
+        throw Error("undefined gate `" + name + "` (" + std::to_string(line) + ")");
+    }
+    if (_expanding.find(name) != _expanding.end()) {
+        throw Error("gate `" + name + "` is defined in terms of itself (" +
+                    std::to_string(line) + ")");
+    }
+    auto& gate = *declaration->second;
+    size_t nr_parameters =
+        gate.parameters.has_value() ? gate.parameters.value().id_list.size() : 0;
+    if (nr_parameters != parameters.size() || gate.arguments.id_list.size() != qubits.size()) {
+        throw Error("wrong number of parameters or arguments for gate `" + name + "` (" +
+                    std::to_string(line) + ")");
+    }
+    for (size_t i = 0; i < qubits.size(); i++) {
+        for (size_t j = i + 1; j < qubits.size(); j++) {
+            if (qubits[i] == qubits[j]) {
+                throw Error("the arguments of gate `" + name + "` must be different qubits (" +
+                            std::to_string(line) + ")");
+            }
+        }
+    }
+
+    Scope scope;
+    for (size_t i = 0; i < nr_parameters; i++) {
+        scope.parameters[gate.parameters.value().id_list[i]] = parameters[i];
+    }
+    for (size_t i = 0; i < qubits.size(); i++) {
+        scope.arguments[gate.arguments.id_list[i]] = qubits[i];
+    }
+
+    _expanding.insert(name);
+    for (auto& stmt : gate.body) {
+        size_t body_line = stmt->context.start_line;
+        if (auto barrier = std::dynamic_pointer_cast<lang::BarrierOperation>(stmt)) {
+            std::vector<size_t> barrier_qubits;
+            for (auto& variable : barrier->variables.mixed_list) {
+                auto argument = scope.arguments.find(variable.identifier);
+                if (argument == scope.arguments.end()) {
+                    throw Error("undefined gate argument `" + variable.identifier + "` (" +
+                                std::to_string(body_line) + ")");
+                }
+                barrier_qubits.push_back(argument->second);
+            }
+            _circuit.operations.push_back({ Operation::Barrier, barrier_qubits, {}, "", 0,
+                                            condition, body_line });
+            continue;
+        }
+        auto sub_unitary = std::dynamic_pointer_cast<lang::UnitaryOperation>(stmt);
+        if (!sub_unitary) {
+            throw Error("undefined statement in the body of gate `" + name + "` (" +
+                        std::to_string(body_line) + ")");
+        }
+        std::vector<Angle> sub_parameters;
+        if (sub_unitary->expression_list.has_value()) {
+            for (auto& expression : sub_unitary->expression_list.value().expression_list) {
+                Angle angle;
+                lower_expression(expression, &scope, angle, body_line);
+                sub_parameters.push_back(std::move(angle));
+            }
+        }
+        std::vector<size_t> sub_qubits;
+        for (auto& variable : sub_unitary->argument_list.mixed_list) {
+            auto argument = scope.arguments.find(variable.identifier);
+            if (argument == scope.arguments.end() || variable.index.has_value()) {
+                throw Error("invalid gate argument `" + variable.to_string() + "` (" +
+                            std::to_string(body_line) + ")");
+            }
+            sub_qubits.push_back(argument->second);
+        }
+        expand(*sub_unitary, sub_parameters, sub_qubits, condition, body_line);
+    }
+    _expanding.erase(name);
+}
+
+void Compiler::lower_measure(const lang::MeasureOperation& measure, const Condition& condition) {
+    size_t line = measure.context.start_line;
+    auto [offset, size] = quantum_register(measure.source, line);
+    auto creg = _circuit.classical_registers.find(measure.target.identifier);
+    if (creg == _circuit.classical_registers.end()) {
+        throw Error("undefined classical register `" + measure.target.identifier + "` (" +
+                    std::to_string(line) + ")");
+    }
+    size_t bit = 0;
+    if (measure.target.index.has_value()) {
+        bit = measure.target.index.value();
+        if (bit >= creg->second || size != 1) {
+            throw Error("invalid measure target `" + measure.target.identifier + "[" +
+                        std::to_string(bit) + "]` (" + std::to_string(line) + ")");
+        }
+    } else if (size != creg->second) {
+        throw Error("the source and target registers of a measure must have the same "
+                    "dimension (" + std::to_string(line) + ")");
+    }
+    for (size_t i = 0; i < size; i++) {
+        _circuit.operations.push_back({ Operation::Measure, { offset + i }, {}, creg->first,
+                                        bit + i, condition, line });
+    }
+}
+
+void Compiler::lower_reset(const lang::ResetOperation& reset, const Condition& condition) {
+    size_t line = reset.context.start_line;
+    auto [offset, size] = quantum_register(reset.target, line);
+    for (size_t i = 0; i < size; i++) {
+        _circuit.operations.push_back({ Operation::Reset, { offset + i }, {}, "", 0,
+                                        condition, line });
+    }
+}
+
+void Compiler::lower_barrier(const lang::BarrierOperation& barrier, const Condition& condition) {
+    size_t line = barrier.context.start_line;
+    std::vector<size_t> qubits;
+    for (auto& variable : barrier.variables.mixed_list) {
+        auto [offset, size] = quantum_register(variable, line);
+        for (size_t i = 0; i < size; i++) {
+            qubits.push_back(offset + i);
+        }
+    }
+    _circuit.operations.push_back({ Operation::Barrier, qubits, {}, "", 0, condition, line });
+}
+
+std::vector<std::vector<size_t>> Compiler::broadcast(const std::vector<lang::Variable>& arguments,
+                                                     size_t line)
+{
+    std::vector<std::tuple<size_t, size_t>> registers;
+    std::optional<size_t> nr_applications;
+    for (auto& argument : arguments) {
+        auto reg = quantum_register(argument, line);
+        if (!argument.index.has_value()) {
+            auto size = std::get<1>(reg);
+            if (nr_applications.has_value() && size != nr_applications.value()) {
+                throw Error("registers passed to an operation must have the same size (" +
+                            std::to_string(line) + ")");
+            }
+            nr_applications = size;
+        }
+        registers.push_back(reg);
+    }
+    std::vector<std::vector<size_t>> applications(nr_applications.value_or(1));
+    for (size_t i = 0; i < applications.size(); i++) {
+        for (size_t j = 0; j < arguments.size(); j++) {
+            auto offset = std::get<0>(registers[j]);
+            applications[i].push_back(arguments[j].index.has_value() ? offset : offset + i);
+        }
+    }
+    return applications;
+}
+
+/**
+ * Return the (offset, size) of the qubits referred to by `variable`, which is
+ * either a whole register or a single indexed qubit.
+ * */
+std::tuple<size_t, size_t> Compiler::quantum_register(const lang::Variable& variable, size_t line) {
+    auto qreg = _circuit.quantum_registers.find(variable.identifier);
+    if (qreg == _circuit.quantum_registers.end()) {
+        throw Error("undefined quantum register `" + variable.identifier + "` (" +
+                    std::to_string(line) + ")");
+    }
+    auto [offset, size] = qreg->second;
+    if (!variable.index.has_value()) {
+        return { offset, size };
+    }
+    if (variable.index.value() >= size) {
+        throw Error("index out of bounds in `" + variable.identifier + "[" +
+                    std::to_string(variable.index.value()) + "]` (" + std::to_string(line) + ")");
+    }
+    return { offset + variable.index.value(), 1 };
+}
+
+static void lower_expression(const std::shared_ptr<lang::Expression>& expression,
+                             const Scope* scope, Angle& angle, size_t line)
+{
+    using namespace lang;
+
+    auto binary = [&](const std::shared_ptr<Expression>& left,
+                      const std::shared_ptr<Expression>& right, Angle::Opcode opcode) {
+        lower_expression(left, scope, angle, line);
+        lower_expression(right, scope, angle, line);
+        angle.program.push_back({ opcode, 0, 0 });
+    };
+
+    if (auto number = std::dynamic_pointer_cast<RealNumber>(expression)) {
+        angle.program.push_back({ Angle::Constant, number->value(), 0 });
+    } else if (auto number = std::dynamic_pointer_cast<NonNegativeInteger>(expression)) {
+        angle.program.push_back({ Angle::Constant, double(number->value()), 0 });
+    } else if (std::dynamic_pointer_cast<EspecialConstant>(expression)) {
+        angle.program.push_back({ Angle::Constant, M_PI, 0 });
+    } else if (auto variable = std::dynamic_pointer_cast<Variable>(expression)) {
+        if (!scope || scope->parameters.count(variable->identifier) == 0) {
+            throw Error("undefined parameter `" + variable->identifier + "` (" +
+                        std::to_string(line) + ")");
+        }
+        auto& program = scope->parameters.at(variable->identifier).program;
+        if (program.empty()) {
+            angle.program.push_back({ Angle::Constant, 0, 0 });
+        } else {
+            angle.program.insert(angle.program.end(), program.begin(), program.end());
+        }
+    } else if (auto minus = std::dynamic_pointer_cast<MinusExpression>(expression)) {
+        lower_expression(minus->negated_expression, scope, angle, line);
+        angle.program.push_back({ Angle::Negate, 0, 0 });
+    } else if (auto add = std::dynamic_pointer_cast<AdditionExpression>(expression)) {
+        binary(add->left, add->right, Angle::Add);
+    } else if (auto sub = std::dynamic_pointer_cast<SubtractionExpression>(expression)) {
+        binary(sub->left, sub->right, Angle::Subtract);
+    } else if (auto mul = std::dynamic_pointer_cast<MultiplicationExpression>(expression)) {
+        binary(mul->left, mul->right, Angle::Multiply);
+    } else if (auto div = std::dynamic_pointer_cast<DivisionExpression>(expression)) {
+        binary(div->left, div->right, Angle::Divide);
+    } else if (auto pow = std::dynamic_pointer_cast<ExponentiationExpression>(expression)) {
+        binary(pow->left, pow->right, Angle::Power);
+    } else if (auto unary = std::dynamic_pointer_cast<UnaryOperation>(expression)) {
+        lower_expression(unary->target, scope, angle, line);
+        switch (unary->operation) {
+        case UnaryOperation::Sin:  angle.program.push_back({ Angle::Sin, 0, 0 }); break;
+        case UnaryOperation::Cos:  angle.program.push_back({ Angle::Cos, 0, 0 }); break;
+        case UnaryOperation::Tan:  angle.program.push_back({ Angle::Tan, 0, 0 }); break;
+        case UnaryOperation::Exp:  angle.program.push_back({ Angle::Exp, 0, 0 }); break;
+        case UnaryOperation::Ln:   angle.program.push_back({ Angle::Ln, 0, 0 }); break;
+        case UnaryOperation::Sqrt: angle.program.push_back({ Angle::Sqrt, 0, 0 }); break;
+        }
+    } else {
+        throw Error("invalid expression (" + std::to_string(line) + ")");
+    }
+}
+
+}
@@ -0,0 +1,176 @@
+/**
+ * Copyright (c) 2022 Alcides Andrade <andrade.alcides.junior@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef __RUNTIME__CIRCUIT_H__
+#define __RUNTIME__CIRCUIT_H__
+
+#include <array>
+#include <map>
+#include <optional>
+#include <string>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#include "lang/program.hpp"
+
+namespace runtime {
+
+/**
+ * An angle of a U gate, kept as a postfix program over the parameters of the
+ * circuit so that it can be re-evaluated when the parameters change.
+ * For example the angle `2*t + pi`, where `t` is the parameter 0, is kept as
+ *     { Constant(2), Parameter(0), Multiply, Constant(pi), Add }
+ * */
+class Angle {
+public:
+    enum Opcode {
+        Constant, Parameter,
+        Negate, Add, Subtract, Multiply, Divide, Power,
+        Sin, Cos, Tan, Exp, Ln, Sqrt,
+    };
+
+    struct Instruction {
+        Opcode opcode;
+        // value of a `Constant`
+        double value;
+        // index of a `Parameter`
+        size_t parameter;
+    };
+
+    std::vector<Instruction> program;
+
+    /**
+     * The angle 0
+     * */
+    Angle() {};
+
+    static Angle constant(double value);
+    static Angle parameter(size_t index);
+
+    /**
+     * Evaluate the angle for the given values of the circuit parameters
+     * */
+    double evaluate(const std::vector<double>& parameters) const;
+
+    /**
+     * Evaluate the partial derivative of the angle with respect to the
+     * parameter `index`.
+     * */
+    double derivative(const std::vector<double>& parameters, size_t index) const;
+
+    /**
+     * The (sorted and unique) parameters that the angle depends on
+     * */
+    std::vector<size_t> dependencies() const;
+
+    inline bool is_constant() const {
+        for (auto& instruction : program) {
+            if (instruction.opcode == Parameter) {
+                return false;
+            }
+        }
+        return true;
+    }
+};
+
+/**
+ * One of the primitive operations of OpenQASM acting on qubits of the flattened
+ * state, where the qubit `n` is the bit `n` of the index of the state vector.
+ * */
+struct Operation {
+    enum Type { U, CX, Measure, Reset, Barrier };
+
+    Type type;
+    // qubits acted upon; for CX the control followed by the target
+    std::vector<size_t> qubits;
+    // theta, phi and lambda of a U gate
+    std::array<Angle, 3> angles;
+    // classical bit written by a measure
+    std::string creg;
+    size_t bit { 0 };
+    // the operation only runs if the classical register equals the value
+    std::optional<std::pair<std::string, unsigned long>> condition;
+    // line of the statement that produced the operation
+    size_t line { 0 };
+};
+
+/**
+ * A gate applied at the top level of a program, i.e., not from the body of
+ * another gate. Its primitive operations end at the operation `last`.
+ * */
+struct GateApplication {
+    // name of the declaration of the gate, or "U" and "CX" for the primitive gates
+    std::string name;
+    std::vector<size_t> qubits;
+    size_t last;
+};
+
+/**
+ * A program flattened into a list of primitive operations: gate declarations are
+ * expanded with their parameters bound, register arguments are broadcast and
+ * if statements are turned into conditions on the operations.
+ *
+ * Every expression passed as a parameter to a gate at the top level of the
+ * program becomes a parameter of the circuit, so that the angles of the
+ * U gates produced by it can be re-evaluated or differentiated with respect
+ * to it.
+ * */
+class Circuit {
+public:
+    size_t nr_qubits { 0 };
+    // (offset, size) of every quantum register, with the same layout as `State`
+    std::map<std::string, std::tuple<size_t, size_t>> quantum_registers;
+    std::map<std::string, size_t> classical_registers;
+    // value of each parameter in the program
+    std::vector<double> parameters;
+    std::vector<Operation> operations;
+    // the gates of the program before they were flattened into `operations`
+    std::vector<GateApplication> applications;
+
+    static Circuit compile(const lang::Program& program);
+
+    /**
+     * Encode the circuit into a byte string, e.g., to send it to another
+     * process, and decode it back. `deserialize` throws `Error` if the bytes
+     * are not a circuit.
+     * */
+    std::string serialize() const;
+    static Circuit deserialize(const std::string& bytes);
+
+    /**
+     * The quantum registers sorted by their offset, i.e., in the order
+     * in which they were declared.
+     * */
+    std::vector<std::pair<std::string, size_t>> quantum_registers_in_order() const;
+
+    /**
+     * For every qubit, the smallest qubit that it is connected to through the
+     * operations on several qubits; qubits with the same value are the ones
+     * that become entangled with each other in the worst case.
+     * */
+    std::vector<size_t> components() const;
+};
+
+}
+
+#endif // __RUNTIME__CIRCUIT_H__
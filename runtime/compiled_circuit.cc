@@ -0,0 +1,257 @@
+/**
+ * Copyright (c) 2022 Alcides Andrade <andrade.alcides.junior@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "compiled_circuit.hpp"
+
+#include <atomic>
+#include <exception>
+#include <mutex>
+#include <thread>
+
+#include "error.hpp"
+#include "gate.hpp"
+
+namespace runtime {
+
+CompiledCircuit::CompiledCircuit(Circuit circuit): _circuit(std::move(circuit)) {
+    auto& operations = _circuit.operations;
+    _matrix_index.resize(operations.size());
+    _is_bound.resize(operations.size());
+    for (size_t i = 0; i < operations.size(); i++) {
+        if (operations[i].type != Operation::U) {
+            continue;
+        }
+        auto& [theta, phi, lambda] = operations[i].angles;
+        if (theta.is_constant() && phi.is_constant() && lambda.is_constant()) {
+            _matrix_index[i] = _constant_matrices.size();
+            _constant_matrices.push_back(Gate::u(theta.evaluate({}),
+                                                 phi.evaluate({}),
+                                                 lambda.evaluate({})));
+        } else {
+            _matrix_index[i] = _bound_operations.size();
+            _is_bound[i] = true;
+            _bound_operations.push_back(i);
+        }
+    }
+    _batchable = _circuit.nr_qubits > 0 && _circuit.nr_qubits <= max_batched_qubits;
+    for (auto& operation : operations) {
+        if (operation.condition.has_value() ||
+            operation.type == Operation::Measure || operation.type == Operation::Reset) {
+            _batchable = false;
+        }
+    }
+}
+
+CompiledCircuit CompiledCircuit::compile(const lang::Program& program) {
+    return CompiledCircuit(Circuit::compile(program));
+}
+
+std::vector<CompiledCircuit::Result> CompiledCircuit::run_batch(
+    const std::vector<std::vector<double>>& parameters, size_t nr_threads) const
+{
+    check_parameters(parameters);
+    std::vector<Result> results(parameters.size());
+    parallel_for<Workspace>(parameters.size(), nr_threads, [&](Workspace& workspace, size_t i) {
+        run(workspace, parameters[i]);
+        results[i] = workspace.state.classical_registers();
+    });
+    return results;
+}
+
+std::vector<double> CompiledCircuit::run_batch(const std::vector<std::vector<double>>& parameters,
+                                               const Observable& observable,
+                                               size_t nr_threads) const
+{
+    check_parameters(parameters);
+    std::vector<double> results(parameters.size());
+    if (!_batchable) {
+        parallel_for<Workspace>(parameters.size(), nr_threads,
+                                [&](Workspace& workspace, size_t i) {
+            run(workspace, parameters[i]);
+            results[i] = workspace.state.expectation(observable);
+        });
+        return results;
+    }
+
+    auto groups = observable.group(_circuit.quantum_registers);
+    size_t nr_batches = (parameters.size() + nr_lanes - 1)/nr_lanes;
+    parallel_for<LaneWorkspace>(nr_batches, nr_threads, [&](LaneWorkspace& workspace, size_t i) {
+        size_t first = i*nr_lanes;
+        run(workspace, parameters, first);
+        std::vector<std::complex<double>> values(nr_lanes);
+        for (auto& group : groups) {
+            std::vector<std::complex<double>> res(group.z_masks.size()*nr_lanes);
+            workspace.state.expectation(group.x_mask, group.z_masks, res);
+            for (size_t k = 0; k < group.z_masks.size(); k++) {
+                for (size_t b = 0; b < nr_lanes; b++) {
+                    values[b] += group.weights[k]*res[k*nr_lanes + b];
+                }
+            }
+        }
+        for (size_t b = 0; b < nr_lanes && first + b < parameters.size(); b++) {
+            results[first + b] = values[b].real();
+        }
+    });
+    return results;
+}
+
+void CompiledCircuit::check_parameters(const std::vector<std::vector<double>>& parameters) const {
+    for (auto& set : parameters) {
+        if (set.size() != nr_parameters()) {
+            throw Error("expected " + std::to_string(nr_parameters()) +
+                        " parameters, but " + std::to_string(set.size()) +
+                        " were passed");
+        }
+    }
+}
+
+template <typename W, typename F>
+void CompiledCircuit::parallel_for(size_t count, size_t nr_threads, F body) const {
+    if (nr_threads == 0) {
+        nr_threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    nr_threads = std::min(nr_threads, count);
+
+    std::atomic<size_t> next { 0 };
+    std::exception_ptr error = nullptr;
+    std::mutex error_mutex;
+    auto worker = [&]() {
+        try {
+            W workspace(*this);
+            for (size_t i = next++; i < count; i = next++) {
+                body(workspace, i);
+            }
+        } catch (...) {
+            std::lock_guard<std::mutex> lock(error_mutex);
+            error = std::current_exception();
+        }
+    };
+    std::vector<std::thread> threads;
+    for (size_t t = 1; t < nr_threads; t++) {
+        threads.emplace_back(worker);
+    }
+    if (nr_threads > 0) {
+        worker();
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    if (error) {
+        std::rethrow_exception(error);
+    }
+}
+
+CompiledCircuit::Workspace::Workspace(const CompiledCircuit& compiled) {
+    auto& circuit = compiled._circuit;
+    state.add_quantum_registers(circuit.quantum_registers_in_order(), circuit.components());
+    for (auto& [name, size] : circuit.classical_registers) {
+        state.add_classical_register(name, size);
+    }
+    for (size_t i = 0; i < compiled._bound_operations.size(); i++) {
+        bound_matrices.emplace_back(2);
+    }
+}
+
+CompiledCircuit::LaneWorkspace::LaneWorkspace(const CompiledCircuit& compiled):
+    state(size_t(1) << compiled._circuit.nr_qubits, nr_lanes),
+    bound_matrices(compiled._bound_operations.size(), math::LaneMatrix(nr_lanes)),
+    matrix(2)
+{}
+
+void CompiledCircuit::run(Workspace& workspace, const std::vector<double>& parameters) const {
+    // rebind the matrices that depend on the parameters
+    for (size_t k = 0; k < _bound_operations.size(); k++) {
+        auto& [theta, phi, lambda] = _circuit.operations[_bound_operations[k]].angles;
+        Gate::set_u(workspace.bound_matrices[k],
+                    theta.evaluate(parameters),
+                    phi.evaluate(parameters),
+                    lambda.evaluate(parameters));
+    }
+
+    auto& state = workspace.state;
+    state.clear();
+    auto& operations = _circuit.operations;
+    for (size_t i = 0; i < operations.size(); i++) {
+        auto& operation = operations[i];
+        if (operation.condition.has_value()) {
+            auto& [creg, value] = operation.condition.value();
+            if (state.classical_register_value(creg) != value) {
+                continue;
+            }
+        }
+        switch (operation.type) {
+        case Operation::U: {
+            auto& matrix = _is_bound[i] ? workspace.bound_matrices[_matrix_index[i]]
+                                        : _constant_matrices[_matrix_index[i]];
+            state.apply(matrix, operation.qubits);
+            break;
+        }
+        case Operation::CX:
+            state.apply(Gate::cx(), operation.qubits);
+            break;
+        case Operation::Measure:
+            state.set_classical_bit(operation.creg, operation.bit,
+                                    state.measure_qubit(operation.qubits[0]));
+            break;
+        case Operation::Reset:
+            state.reset_qubit(operation.qubits[0]);
+            break;
+        case Operation::Barrier:
+            break;
+        }
+    }
+}
+
+void CompiledCircuit::run(LaneWorkspace& workspace,
+                          const std::vector<std::vector<double>>& parameters,
+                          size_t first) const
+{
+    for (size_t k = 0; k < _bound_operations.size(); k++) {
+        auto& [theta, phi, lambda] = _circuit.operations[_bound_operations[k]].angles;
+        for (size_t b = 0; b < nr_lanes; b++) {
+            auto& set = parameters[std::min(first + b, parameters.size() - 1)];
+            Gate::set_u(workspace.matrix,
+                        theta.evaluate(set),
+                        phi.evaluate(set),
+                        lambda.evaluate(set));
+            workspace.bound_matrices[k].set(b, workspace.matrix);
+        }
+    }
+
+    auto& state = workspace.state;
+    state.set_basis_state(0);
+    auto& operations = _circuit.operations;
+    for (size_t i = 0; i < operations.size(); i++) {
+        auto& operation = operations[i];
+        if (operation.type == Operation::U) {
+            if (_is_bound[i]) {
+                state.apply(workspace.bound_matrices[_matrix_index[i]], operation.qubits[0]);
+            } else {
+                state.apply(_constant_matrices[_matrix_index[i]], operation.qubits);
+            }
+        } else if (operation.type == Operation::CX) {
+            state.apply(Gate::cx(), operation.qubits);
+        }
+    }
+}
+
+}
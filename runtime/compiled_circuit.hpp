@@ -0,0 +1,149 @@
+/**
+ * Copyright (c) 2022 Alcides Andrade <andrade.alcides.junior@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef __RUNTIME__COMPILED_CIRCUIT_H__
+#define __RUNTIME__COMPILED_CIRCUIT_H__
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include "circuit.hpp"
+#include "lang/program.hpp"
+#include "math/batch_vector.hpp"
+#include "math/unitary.hpp"
+#include "observable.hpp"
+#include "state.hpp"
+
+namespace runtime {
+
+/**
+ * A circuit prepared to be run many times with different values of its parameters.
+ * The matrices of the U gates that do not depend on the parameters are computed
+ * once, and between runs only the matrices of the remaining gates are rebound.
+ * Parameter sets are evaluated in parallel, and every worker thread reuses its
+ * state vector and gate matrices for all of the runs assigned to it.
+ *
+ * Small unitary circuits are run in throughput mode when only expectation values
+ * are requested: `nr_lanes` parameter sets are simulated at once in the lanes of
+ * a `math::BatchVector`, each lane with its own bound matrices.
+ * */
+class CompiledCircuit {
+public:
+    // the classical registers at the end of a run
+    using Result = std::map<std::string, std::vector<bool>>;
+
+    // widest circuit that is run in throughput mode
+    static constexpr size_t max_batched_qubits = 16;
+    // parameter sets simulated together in throughput mode
+    static constexpr size_t nr_lanes = 8;
+
+    CompiledCircuit(Circuit circuit);
+
+    static CompiledCircuit compile(const lang::Program& program);
+
+    inline const Circuit& circuit() const {
+        return _circuit;
+    }
+
+    /**
+     * The number of parameters, i.e., the size of each parameter set
+     * */
+    inline size_t nr_parameters() const {
+        return _circuit.parameters.size();
+    }
+
+    /**
+     * Run the circuit once for each parameter set and return the classical
+     * registers at the end of every run.
+     * When `nr_threads` is 0 one thread per hardware thread is used.
+     * */
+    std::vector<Result> run_batch(const std::vector<std::vector<double>>& parameters,
+                                  size_t nr_threads = 0) const;
+
+    /**
+     * Run the circuit once for each parameter set and return the expectation
+     * value of `observable` on the final state of every run.
+     * */
+    std::vector<double> run_batch(const std::vector<std::vector<double>>& parameters,
+                                  const Observable& observable,
+                                  size_t nr_threads = 0) const;
+
+private:
+    Circuit _circuit;
+    // matrices of the U gates whose angles are constant
+    std::vector<math::unitary_t> _constant_matrices;
+    // operations whose matrix depends on the parameters
+    std::vector<size_t> _bound_operations;
+    /**
+     * For every operation, the position of its matrix in `_constant_matrices`
+     * or, if it depends on the parameters, in the bound matrices of a run.
+     * */
+    std::vector<size_t> _matrix_index;
+    std::vector<bool> _is_bound;
+    // whether the circuit can be run in throughput mode
+    bool _batchable { false };
+
+    /**
+     * Per-thread memory reused between runs
+     * */
+    struct Workspace {
+        State state;
+        std::vector<math::unitary_t> bound_matrices;
+
+        Workspace(const CompiledCircuit& compiled);
+    };
+
+    /**
+     * Per-thread memory of the throughput mode
+     * */
+    struct LaneWorkspace {
+        math::BatchVector state;
+        std::vector<math::LaneMatrix> bound_matrices;
+        math::unitary_t matrix;
+
+        LaneWorkspace(const CompiledCircuit& compiled);
+    };
+
+    void run(Workspace& workspace, const std::vector<double>& parameters) const;
+
+    /**
+     * Run the parameter sets `first`, `first + 1`, ... in the lanes of the workspace.
+     * Lanes past the end of `parameters` repeat the last set.
+     * */
+    void run(LaneWorkspace& workspace, const std::vector<std::vector<double>>& parameters,
+             size_t first) const;
+
+    void check_parameters(const std::vector<std::vector<double>>& parameters) const;
+
+    /**
+     * Call `body(workspace, i)` for every `i` in [0, count), distributing the
+     * indices dynamically among `nr_threads` threads, each one with its own
+     * workspace of type `W`.
+     * */
+    template <typename W, typename F>
+    void parallel_for(size_t count, size_t nr_threads, F body) const;
+};
+
+}
+
+#endif // __RUNTIME__COMPILED_CIRCUIT_H__
@@ -0,0 +1,407 @@
+/**
+ * Copyright (c) 2022 Alcides Andrade <andrade.alcides.junior@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "decision_diagram.hpp"
+
+#include <cmath>
+
+#include "error.hpp"
+#include "gate.hpp"
+
+namespace runtime {
+
+// weights closer than this are considered equal
+static const double tolerance = 1e-7;
+// collections only start once this many nodes are allocated
+static const size_t min_collection = 1 << 14;
+
+static inline size_t combine(size_t seed, size_t value) {
+    return seed ^ (value + 0x9e3779b97f4a7c15ull + (seed << 6) + (seed >> 2));
+}
+
+bool DecisionDiagram::Key::operator==(const Key& other) const {
+    return level == other.level && nodes[0] == other.nodes[0] && nodes[1] == other.nodes[1] &&
+           std::equal(weights, weights + 4, other.weights);
+}
+
+size_t DecisionDiagram::KeyHash::operator()(const Key& key) const {
+    size_t res = combine(key.level, key.nodes[0]);
+    res = combine(res, key.nodes[1]);
+    for (auto weight : key.weights) {
+        res = combine(res, weight);
+    }
+    return res;
+}
+
+bool DecisionDiagram::AddKey::operator==(const AddKey& other) const {
+    return a == other.a && b == other.b &&
+           ratio[0] == other.ratio[0] && ratio[1] == other.ratio[1];
+}
+
+size_t DecisionDiagram::AddKeyHash::operator()(const AddKey& key) const {
+    return combine(combine(combine(key.a, key.b), key.ratio[0]), key.ratio[1]);
+}
+
+int64_t DecisionDiagram::quantize(double value) {
+    return std::llround(value/tolerance);
+}
+
+DecisionDiagram::Key DecisionDiagram::key(const Node& node) {
+    return {
+        node.level,
+        { node.edges[0].node, node.edges[1].node },
+        {
+            quantize(node.edges[0].weight.real()), quantize(node.edges[0].weight.imag()),
+            quantize(node.edges[1].weight.real()), quantize(node.edges[1].weight.imag()),
+        },
+    };
+}
+
+DecisionDiagram::DecisionDiagram(size_t nr_qubits):
+    _nr_qubits(nr_qubits), _generator(std::random_device()())
+{
+    _nodes.push_back({ -1, { { terminal, 0. }, { terminal, 0. } } });
+    // |0...0> is a chain taking the 0 edge at every level
+    _root = { terminal, 1. };
+    for (size_t level = 0; level < nr_qubits; level++) {
+        _root = make_node(level, _root, { terminal, 0. });
+    }
+    _last_collection = nr_allocated();
+}
+
+size_t DecisionDiagram::nr_allocated() const {
+    return _nodes.size() - 1 - _free.size();
+}
+
+DecisionDiagram::Edge DecisionDiagram::make_node(int level, Edge e0, Edge e1) {
+    double m0 = std::abs(e0.weight), m1 = std::abs(e1.weight);
+    if (m0 == 0 && m1 == 0) {
+        return { terminal, 0. };
+    }
+    // normalize by the largest weight, preferring the 0 edge on ties
+    dcx_t norm = m1 > m0*(1 + tolerance) ? e1.weight : e0.weight;
+    for (auto* e : { &e0, &e1 }) {
+        e->weight /= norm;
+        if (std::abs(e->weight) < tolerance) {
+            *e = { terminal, 0. };
+        } else if (std::abs(e->weight - 1.) < tolerance) {
+            e->weight = 1;
+        }
+    }
+    Node node { level, { e0, e1 } };
+    auto k = key(node);
+    auto it = _unique.find(k);
+    if (it != _unique.end()) {
+        return { it->second, norm };
+    }
+    uint32_t index;
+    if (!_free.empty()) {
+        index = _free.back();
+        _free.pop_back();
+        _nodes[index] = node;
+    } else {
+        index = _nodes.size();
+        _nodes.push_back(node);
+    }
+    _unique.emplace(k, index);
+    _peak = std::max(_peak, nr_allocated());
+    return { index, norm };
+}
+
+DecisionDiagram::Edge DecisionDiagram::add(Edge a, Edge b) {
+    if (a.weight == 0.) {
+        return b;
+    }
+    if (b.weight == 0.) {
+        return a;
+    }
+    if (a.node == b.node) {
+        dcx_t weight = a.weight + b.weight;
+        if (std::abs(weight) < tolerance*std::max(std::abs(a.weight), std::abs(b.weight))) {
+            return { terminal, 0. };
+        }
+        return { a.node, weight };
+    }
+    if (a.node > b.node) {
+        std::swap(a, b);
+    }
+    dcx_t ratio = b.weight/a.weight;
+    AddKey k { a.node, b.node, { quantize(ratio.real()), quantize(ratio.imag()) } };
+    _cache_lookups++;
+    auto it = _add_cache.find(k);
+    if (it != _add_cache.end()) {
+        _cache_hits++;
+        return { it->second.node, it->second.weight*a.weight };
+    }
+    Node na = _nodes[a.node];
+    Node nb = _nodes[b.node];
+    Edge e[2];
+    for (size_t i = 0; i < 2; i++) {
+        e[i] = add(na.edges[i], { nb.edges[i].node, nb.edges[i].weight*ratio });
+    }
+    Edge res = make_node(na.level, e[0], e[1]);
+    _add_cache.emplace(k, res);
+    return { res.node, res.weight*a.weight };
+}
+
+DecisionDiagram::Edge DecisionDiagram::apply(Edge edge, size_t qubit, const Matrix2& gate) {
+    if (edge.weight == 0.) {
+        return edge;
+    }
+    _cache_lookups++;
+    auto it = _gate_cache.find(edge.node);
+    if (it != _gate_cache.end()) {
+        _cache_hits++;
+        return { it->second.node, it->second.weight*edge.weight };
+    }
+    Node node = _nodes[edge.node];
+    Edge e0, e1;
+    if (node.level == int(qubit)) {
+        auto [c0, c1] = node.edges;
+        auto scale = [](Edge e, dcx_t w) {
+            return w == 0. ? Edge { terminal, 0. } : Edge { e.node, e.weight*w };
+        };
+        e0 = add(scale(c0, gate[0]), scale(c1, gate[1]));
+        e1 = add(scale(c0, gate[2]), scale(c1, gate[3]));
+    } else {
+        e0 = apply(node.edges[0], qubit, gate);
+        e1 = apply(node.edges[1], qubit, gate);
+    }
+    Edge res = make_node(node.level, e0, e1);
+    _gate_cache.emplace(edge.node, res);
+    return { res.node, res.weight*edge.weight };
+}
+
+DecisionDiagram::Edge DecisionDiagram::project(Edge edge, size_t qubit, bool value) {
+    if (edge.weight == 0.) {
+        return edge;
+    }
+    uint64_t k = uint64_t(edge.node)*2 + value;
+    _cache_lookups++;
+    auto it = _project_cache.find(k);
+    if (it != _project_cache.end()) {
+        _cache_hits++;
+        return { it->second.node, it->second.weight*edge.weight };
+    }
+    Node node = _nodes[edge.node];
+    Edge res;
+    if (node.level == int(qubit)) {
+        Edge zero { terminal, 0. };
+        res = value ? make_node(node.level, zero, node.edges[1])
+                    : make_node(node.level, node.edges[0], zero);
+    } else {
+        res = make_node(node.level,
+                        project(node.edges[0], qubit, value),
+                        project(node.edges[1], qubit, value));
+    }
+    _project_cache.emplace(k, res);
+    return { res.node, res.weight*edge.weight };
+}
+
+DecisionDiagram::Edge DecisionDiagram::cx(Edge edge, size_t control, size_t target) {
+    static const Matrix2 x { 0., 1., 1., 0. };
+    if (edge.weight == 0.) {
+        return edge;
+    }
+    _cache_lookups++;
+    auto it = _cx_cache.find(edge.node);
+    if (it != _cx_cache.end()) {
+        _cache_hits++;
+        return { it->second.node, it->second.weight*edge.weight };
+    }
+    Node node = _nodes[edge.node];
+    Edge e0, e1;
+    if (node.level > int(std::max(control, target))) {
+        e0 = cx(node.edges[0], control, target);
+        e1 = cx(node.edges[1], control, target);
+    } else if (node.level == int(control)) {
+        e0 = node.edges[0];
+        e1 = apply(node.edges[1], target, x);
+    } else {
+        // the target is above the control: swap the halves where the control is 1
+        auto [a, b] = node.edges;
+        e0 = add(project(a, control, false), project(b, control, true));
+        e1 = add(project(b, control, false), project(a, control, true));
+    }
+    Edge res = make_node(node.level, e0, e1);
+    _cx_cache.emplace(edge.node, res);
+    return { res.node, res.weight*edge.weight };
+}
+
+void DecisionDiagram::clear_caches() {
+    _gate_cache.clear();
+    _cx_cache.clear();
+    _project_cache.clear();
+}
+
+void DecisionDiagram::apply(const math::unitary_t& gate, size_t qubit) {
+    clear_caches();
+    _root = apply(_root, qubit, { gate(0, 0), gate(0, 1), gate(1, 0), gate(1, 1) });
+    maybe_collect();
+}
+
+void DecisionDiagram::cx(size_t control, size_t target) {
+    clear_caches();
+    _root = cx(_root, control, target);
+    maybe_collect();
+}
+
+void DecisionDiagram::apply(const Operation& operation, const std::vector<double>& parameters) {
+    if (operation.type == Operation::CX) {
+        cx(operation.qubits[0], operation.qubits[1]);
+    } else {
+        auto& [theta, phi, lambda] = operation.angles;
+        apply(Gate::u(theta.evaluate(parameters),
+                      phi.evaluate(parameters),
+                      lambda.evaluate(parameters)),
+              operation.qubits[0]);
+    }
+}
+
+double DecisionDiagram::norm(uint32_t node, std::unordered_map<uint32_t, double>& cache) const {
+    if (node == terminal) {
+        return 1;
+    }
+    auto it = cache.find(node);
+    if (it != cache.end()) {
+        return it->second;
+    }
+    double res = 0;
+    for (auto& e : _nodes[node].edges) {
+        if (e.weight != 0.) {
+            res += std::norm(e.weight)*norm(e.node, cache);
+        }
+    }
+    cache.emplace(node, res);
+    return res;
+}
+
+double DecisionDiagram::probability(Edge edge, size_t qubit, bool value,
+                                    std::unordered_map<uint32_t, double>& norms,
+                                    std::unordered_map<uint32_t, double>& cache) const
+{
+    if (edge.weight == 0.) {
+        return 0;
+    }
+    auto it = cache.find(edge.node);
+    if (it != cache.end()) {
+        return std::norm(edge.weight)*it->second;
+    }
+    auto& node = _nodes[edge.node];
+    double res = 0;
+    if (node.level == int(qubit)) {
+        auto& e = node.edges[value];
+        res = e.weight == 0. ? 0 : std::norm(e.weight)*norm(e.node, norms);
+    } else {
+        for (auto& e : node.edges) {
+            res += probability(e, qubit, value, norms, cache);
+        }
+    }
+    cache.emplace(edge.node, res);
+    return std::norm(edge.weight)*res;
+}
+
+bool DecisionDiagram::measure(size_t qubit) {
+    std::unordered_map<uint32_t, double> norms, zeros, ones;
+    double p0 = probability(_root, qubit, false, norms, zeros);
+    double p1 = probability(_root, qubit, true, norms, ones);
+    std::uniform_real_distribution<double> uniform(0, p0 + p1);
+    bool outcome = uniform(_generator) < p1;
+    clear_caches();
+    _root = project(_root, qubit, outcome);
+    _root.weight /= std::sqrt(outcome ? p1 : p0);
+    maybe_collect();
+    return outcome;
+}
+
+void DecisionDiagram::reset(size_t qubit) {
+    if (measure(qubit)) {
+        apply(Gate::u(M_PI, 0, M_PI), qubit);
+    }
+}
+
+std::complex<double> DecisionDiagram::amplitude(const std::vector<bool>& bits) const {
+    dcx_t res = _root.weight;
+    uint32_t node = _root.node;
+    while (node != terminal && res != 0.) {
+        auto& e = _nodes[node].edges[bits[_nodes[node].level]];
+        res *= e.weight;
+        node = e.node;
+    }
+    return res;
+}
+
+void DecisionDiagram::maybe_collect() {
+    size_t allocated = nr_allocated();
+    if (allocated >= min_collection && allocated >= 2*_last_collection) {
+        collect();
+    }
+}
+
+void DecisionDiagram::collect() {
+    std::vector<bool> reachable(_nodes.size());
+    std::vector<uint32_t> stack { _root.node };
+    while (!stack.empty()) {
+        uint32_t node = stack.back();
+        stack.pop_back();
+        if (reachable[node]) {
+            continue;
+        }
+        reachable[node] = true;
+        for (auto& e : _nodes[node].edges) {
+            stack.push_back(e.node);
+        }
+    }
+    for (uint32_t i = 1; i < _nodes.size(); i++) {
+        // freed nodes have level -2
+        if (!reachable[i] && _nodes[i].level >= 0) {
+            _unique.erase(key(_nodes[i]));
+            _nodes[i].level = -2;
+            _free.push_back(i);
+        }
+    }
+    clear_caches();
+    _add_cache.clear();
+    _last_collection = nr_allocated();
+    _nr_collections++;
+}
+
+DecisionDiagram::Stats DecisionDiagram::stats() const {
+    std::vector<bool> reachable(_nodes.size());
+    std::vector<uint32_t> stack { _root.node };
+    size_t nr_nodes = 0;
+    while (!stack.empty()) {
+        uint32_t node = stack.back();
+        stack.pop_back();
+        if (node == terminal || reachable[node]) {
+            continue;
+        }
+        reachable[node] = true;
+        nr_nodes++;
+        for (auto& e : _nodes[node].edges) {
+            stack.push_back(e.node);
+        }
+    }
+    return { nr_nodes, nr_allocated(), _peak, _nr_collections, _cache_lookups, _cache_hits };
+}
+
+}
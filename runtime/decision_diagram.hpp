@@ -0,0 +1,195 @@
+/**
+ * Copyright (c) 2022 Alcides Andrade <andrade.alcides.junior@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef __RUNTIME__DECISION_DIAGRAM_H__
+#define __RUNTIME__DECISION_DIAGRAM_H__
+
+#include <array>
+#include <complex>
+#include <cstdint>
+#include <random>
+#include <unordered_map>
+#include <vector>
+
+#include "circuit.hpp"
+#include "math/unitary.hpp"
+
+namespace runtime {
+
+/**
+ * A state kept as an edge-weighted decision diagram (QMDD). The node of the
+ * level k splits the amplitudes on the value of the qubit k, from the highest
+ * qubit at the root down to the qubit 0 above the terminal, and the amplitude
+ * of a basis state is the product of the weights along its path. Equal
+ * sub-states are shared, so structured states of many qubits take a few
+ * nodes where the state vector would need 2^n entries.
+ *
+ * Nodes are hash-consed in a unique table, with the weights of their edges
+ * normalized so that the largest one is 1. Gate applications and additions are
+ * memoized in compute caches, and unreachable nodes are collected when the
+ * number of nodes doubles.
+ * */
+class DecisionDiagram {
+public:
+    struct Stats {
+        // nodes reachable from the root
+        size_t nr_nodes;
+        // nodes allocated, reachable or not
+        size_t nr_allocated;
+        size_t peak_allocated;
+        size_t nr_collections;
+        size_t cache_lookups;
+        size_t cache_hits;
+    };
+
+    DecisionDiagram(size_t nr_qubits);
+
+    inline size_t nr_qubits() const {
+        return _nr_qubits;
+    }
+
+    /**
+     * Apply a 2x2 matrix to the qubit `qubit`
+     * */
+    void apply(const math::unitary_t& gate, size_t qubit);
+
+    void cx(size_t control, size_t target);
+
+    /**
+     * Apply a U or CX operation of a circuit
+     * */
+    void apply(const Operation& operation, const std::vector<double>& parameters);
+
+    /**
+     * Measure the qubit `qubit` in the computational basis, collapsing the
+     * state, and return the outcome.
+     * */
+    bool measure(size_t qubit);
+
+    /**
+     * Set the qubit `qubit` to |0>
+     * */
+    void reset(size_t qubit);
+
+    /**
+     * The amplitude of the basis state whose bit k is the value of the qubit k
+     * */
+    std::complex<double> amplitude(const std::vector<bool>& bits) const;
+
+    Stats stats() const;
+
+    /**
+     * Free the nodes that are not reachable from the root
+     * */
+    void collect();
+
+private:
+    using dcx_t = std::complex<double>;
+    using Matrix2 = std::array<dcx_t, 4>;
+
+    static constexpr uint32_t terminal = 0;
+
+    struct Edge {
+        uint32_t node;
+        dcx_t weight;
+    };
+
+    struct Node {
+        // the qubit of the node, -1 for the terminal
+        int level;
+        Edge edges[2];
+    };
+
+    /**
+     * A node with its weights rounded, so that nodes equal up to numerical
+     * noise are found in the unique table
+     * */
+    struct Key {
+        int level;
+        uint32_t nodes[2];
+        int64_t weights[4];
+
+        bool operator==(const Key& other) const;
+    };
+
+    struct KeyHash {
+        size_t operator()(const Key& key) const;
+    };
+
+    /**
+     * The sum of the node `a` with weight 1 and the node `b` with weight `ratio`
+     * */
+    struct AddKey {
+        uint32_t a;
+        uint32_t b;
+        int64_t ratio[2];
+
+        bool operator==(const AddKey& other) const;
+    };
+
+    struct AddKeyHash {
+        size_t operator()(const AddKey& key) const;
+    };
+
+    size_t _nr_qubits;
+    std::vector<Node> _nodes;
+    std::vector<uint32_t> _free;
+    std::unordered_map<Key, uint32_t, KeyHash> _unique;
+    /**
+     * Results of the current operation on every node, for an incoming weight
+     * of 1. They are cleared before every gate, measurement or reset.
+     * */
+    std::unordered_map<uint32_t, Edge> _gate_cache;
+    std::unordered_map<uint32_t, Edge> _cx_cache;
+    std::unordered_map<uint64_t, Edge> _project_cache;
+    // sums of nodes, kept until the next collection
+    std::unordered_map<AddKey, Edge, AddKeyHash> _add_cache;
+    Edge _root;
+    // allocated nodes after the last collection
+    size_t _last_collection { 0 };
+    size_t _peak { 0 };
+    size_t _nr_collections { 0 };
+    size_t _cache_lookups { 0 };
+    size_t _cache_hits { 0 };
+    std::mt19937_64 _generator;
+
+    static Key key(const Node& node);
+    static int64_t quantize(double value);
+
+    size_t nr_allocated() const;
+    void clear_caches();
+
+    Edge make_node(int level, Edge e0, Edge e1);
+    Edge add(Edge a, Edge b);
+    Edge apply(Edge edge, size_t qubit, const Matrix2& gate);
+    Edge cx(Edge edge, size_t control, size_t target);
+    Edge project(Edge edge, size_t qubit, bool value);
+    double norm(uint32_t node, std::unordered_map<uint32_t, double>& cache) const;
+    double probability(Edge edge, size_t qubit, bool value,
+                       std::unordered_map<uint32_t, double>& norms,
+                       std::unordered_map<uint32_t, double>& cache) const;
+    void maybe_collect();
+};
+
+}
+
+#endif // __RUNTIME__DECISION_DIAGRAM_H__
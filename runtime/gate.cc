@@ -22,6 +22,7 @@
 
 #include "gate.hpp"
 
+#include <cassert>
 #include <complex>
 #include <cstring>
 
@@ -40,16 +41,57 @@ const math::unitary_t Gate::_CX = {
     0, 0, 1.f, 0,
 };
 
-Gate::Gate(float theta, float phi, float lambda) {
+Gate::Gate(float theta, float phi, float lambda): _unitary(u(theta, phi, lambda)) {
+}
+
+math::unitary_t Gate::u(float theta, float phi, float lambda) {
+    math::unitary_t res(2);
+    set_u(res, theta, phi, lambda);
+    return res;
+}
+
+void Gate::set_u(math::unitary_t& res, float theta, float phi, float lambda) {
+    assert(res.dim() == 2);
     math::cx_t i = (0.f + 1if);
     auto ct2 = std::cos(theta/2);
     auto st2 = std::sin(theta/2);
     auto eippl = std::exp(((lambda + phi)/2)*i);
     auto eipml = std::exp(((lambda - phi)/2)*i);
-    this->_unitary = {
-        std::conj(ct2 * eippl), -1 * st2 * eipml,
-        std::conj(st2 * eipml), ct2 * eipml,
-    };
+    res(0, 0) = std::conj(ct2 * eippl);
+    res(0, 1) = -1 * st2 * eipml;
+    res(1, 0) = std::conj(st2 * eipml);
+    res(1, 1) = ct2 * eippl;
+}
+
+math::unitary_t Gate::u_derivative(float theta, float phi, float lambda, size_t angle) {
+    math::cx_t i = (0.f + 1if);
+    auto ct2 = std::cos(theta/2);
+    auto st2 = std::sin(theta/2);
+    auto eippl = std::exp(((lambda + phi)/2)*i);
+    auto eipml = std::exp(((lambda - phi)/2)*i);
+    switch (angle) {
+    case 0:
+        return {
+            -std::conj(st2 * eippl)/2.f, -1 * ct2 * eipml/2.f,
+            std::conj(ct2 * eipml)/2.f, -st2 * eippl/2.f,
+        };
+    case 1:
+        // each entry is an exponential of (+/-)i*phi/2
+        return {
+            -i*std::conj(ct2 * eippl)/2.f, i * st2 * eipml/2.f,
+            i*std::conj(st2 * eipml)/2.f, i * ct2 * eippl/2.f,
+        };
+    default:
+        // each entry is an exponential of (+/-)i*lambda/2
+        return {
+            -i*std::conj(ct2 * eippl)/2.f, -i * st2 * eipml/2.f,
+            -i*std::conj(st2 * eipml)/2.f, i * ct2 * eippl/2.f,
+        };
+    }
+}
+
+const math::unitary_t& Gate::cx() {
+    return _CX;
 }
 
 };
@@ -72,6 +72,27 @@ public:
      * */
     Gate(float theta, float phi, float lambda);
 
+    /**
+     * The unitary matrix of the gate U(theta, phi, lambda)
+     * */
+    static math::unitary_t u(float theta, float phi, float lambda);
+
+    /**
+     * Overwrite the 2x2 matrix `res` with the matrix of U(theta, phi, lambda)
+     * */
+    static void set_u(math::unitary_t& res, float theta, float phi, float lambda);
+
+    /**
+     * The derivative of the matrix of U(theta, phi, lambda) with respect
+     * to its `angle`-th parameter (0 for theta, 1 for phi and 2 for lambda).
+     * */
+    static math::unitary_t u_derivative(float theta, float phi, float lambda, size_t angle);
+
+    /**
+     * The controlled not matrix, with the control as the most significant qubit
+     * */
+    static const math::unitary_t& cx();
+
     /**
      * A gate defined by composing a series of applications of other gates.
      * */
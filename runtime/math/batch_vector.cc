@@ -0,0 +1,210 @@
+/**
+ * Copyright (c) 2022 Alcides Andrade <andrade.alcides.junior@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "batch_vector.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+
+namespace runtime {
+namespace math {
+
+void LaneMatrix::set(size_t lane, const Unitary& mat) {
+    assert(mat.dim() == 2 && lane < lanes);
+    for (size_t k = 0; k < 4; k++) {
+        real[k*lanes + lane] = mat(k/2, k%2).real();
+        imag[k*lanes + lane] = mat(k/2, k%2).imag();
+    }
+}
+
+BatchVector::BatchVector(size_t size, size_t lanes): _size(size), _lanes(lanes) {
+    // allocate at a 64-byte address so that full SIMD registers can be loaded
+    size_t bytes = 2*_size*_lanes*sizeof(float);
+    bytes = (bytes + 63)/64*64;
+    _entries = static_cast<float*>(aligned_alloc(64, bytes));
+    if (!_entries) {
+        std::cout << "failed malloc: " << std::strerror(errno) << "\n";
+        std::exit(EXIT_FAILURE);
+    }
+    std::memset(_entries, 0, bytes);
+}
+
+void BatchVector::set_basis_state(size_t index) {
+    std::memset(_entries, 0, 2*_size*_lanes*sizeof(float));
+    std::fill(real(index), real(index) + _lanes, 1.f);
+}
+
+void BatchVector::set(const Vector& vec) {
+    assert(vec.size() == _size);
+    for (size_t i = 0; i < _size; i++) {
+        std::fill(real(i), real(i) + _lanes, vec[i].real());
+        std::fill(imag(i), imag(i) + _lanes, vec[i].imag());
+    }
+}
+
+void BatchVector::apply(const Unitary& mat, const std::vector<size_t>& qubits) {
+    if (qubits.size() == 1) {
+        float m_re[4], m_im[4];
+        for (size_t k = 0; k < 4; k++) {
+            m_re[k] = mat(k/2, k%2).real();
+            m_im[k] = mat(k/2, k%2).imag();
+        }
+        size_t stride = size_t(1) << qubits[0];
+        for (size_t i = 0; i < _size; i += 2*stride) {
+            for (size_t j = i; j < i + stride; j++) {
+                float* __restrict__ r0 = real(j);
+                float* __restrict__ i0 = imag(j);
+                float* __restrict__ r1 = real(j + stride);
+                float* __restrict__ i1 = imag(j + stride);
+                for (size_t b = 0; b < _lanes; b++) {
+                    float ar = r0[b], ai = i0[b], br = r1[b], bi = i1[b];
+                    r0[b] = m_re[0]*ar - m_im[0]*ai + m_re[1]*br - m_im[1]*bi;
+                    i0[b] = m_re[0]*ai + m_im[0]*ar + m_re[1]*bi + m_im[1]*br;
+                    r1[b] = m_re[2]*ar - m_im[2]*ai + m_re[3]*br - m_im[3]*bi;
+                    i1[b] = m_re[2]*ai + m_im[2]*ar + m_re[3]*bi + m_im[3]*br;
+                }
+            }
+        }
+        return;
+    }
+    // general case: gather the amplitudes acted upon lane by lane
+    size_t k = qubits.size();
+    size_t dim = size_t(1) << k;
+    assert(mat.dim() == dim);
+    std::vector<size_t> offsets(dim);
+    for (size_t l = 0; l < dim; l++) {
+        for (size_t j = 0; j < k; j++) {
+            if ((l >> (k - 1 - j)) & 1) {
+                offsets[l] |= size_t(1) << qubits[j];
+            }
+        }
+    }
+    size_t mask = offsets[dim - 1];
+    std::vector<float> in_re(dim*_lanes), in_im(dim*_lanes);
+    for (size_t base = 0; base < _size; base++) {
+        if (base & mask) {
+            continue;
+        }
+        for (size_t l = 0; l < dim; l++) {
+            std::memcpy(&in_re[l*_lanes], real(base + offsets[l]), _lanes*sizeof(float));
+            std::memcpy(&in_im[l*_lanes], imag(base + offsets[l]), _lanes*sizeof(float));
+        }
+        for (size_t r = 0; r < dim; r++) {
+            float* __restrict__ out_re = real(base + offsets[r]);
+            float* __restrict__ out_im = imag(base + offsets[r]);
+            std::fill(out_re, out_re + _lanes, 0.f);
+            std::fill(out_im, out_im + _lanes, 0.f);
+            for (size_t l = 0; l < dim; l++) {
+                float mr = mat(r, l).real(), mi = mat(r, l).imag();
+                if (mr == 0 && mi == 0) {
+                    continue;
+                }
+                const float* a_re = &in_re[l*_lanes];
+                const float* a_im = &in_im[l*_lanes];
+                for (size_t b = 0; b < _lanes; b++) {
+                    out_re[b] += mr*a_re[b] - mi*a_im[b];
+                    out_im[b] += mr*a_im[b] + mi*a_re[b];
+                }
+            }
+        }
+    }
+}
+
+void BatchVector::apply(const LaneMatrix& mat, size_t qubit, size_t controls) {
+    assert(mat.lanes == _lanes);
+    const float* m_re = mat.real.data();
+    const float* m_im = mat.imag.data();
+    size_t stride = size_t(1) << qubit;
+    for (size_t i = 0; i < _size; i += 2*stride) {
+        for (size_t j = i; j < i + stride; j++) {
+            if ((j & controls) != controls) {
+                continue;
+            }
+            float* __restrict__ r0 = real(j);
+            float* __restrict__ i0 = imag(j);
+            float* __restrict__ r1 = real(j + stride);
+            float* __restrict__ i1 = imag(j + stride);
+            for (size_t b = 0; b < _lanes; b++) {
+                float ar = r0[b], ai = i0[b], br = r1[b], bi = i1[b];
+                float m0r = m_re[b],            m0i = m_im[b];
+                float m1r = m_re[_lanes + b],   m1i = m_im[_lanes + b];
+                float m2r = m_re[2*_lanes + b], m2i = m_im[2*_lanes + b];
+                float m3r = m_re[3*_lanes + b], m3i = m_im[3*_lanes + b];
+                r0[b] = m0r*ar - m0i*ai + m1r*br - m1i*bi;
+                i0[b] = m0r*ai + m0i*ar + m1r*bi + m1i*br;
+                r1[b] = m2r*ar - m2i*ai + m3r*br - m3i*bi;
+                i1[b] = m2r*ai + m2i*ar + m3r*bi + m3i*br;
+            }
+        }
+    }
+}
+
+void BatchVector::probabilities(size_t qubit, std::vector<double>& res) const {
+    res.assign(_lanes, 0);
+    for (size_t i = 0; i < _size; i++) {
+        if (((i >> qubit) & 1) == 0) {
+            continue;
+        }
+        const float* r = real(i);
+        const float* m = imag(i);
+        for (size_t b = 0; b < _lanes; b++) {
+            res[b] += r[b]*r[b] + m[b]*m[b];
+        }
+    }
+}
+
+void BatchVector::expectation(size_t x_mask, const std::vector<size_t>& z_masks,
+                              std::vector<std::complex<double>>& res) const
+{
+    assert(res.size() == z_masks.size()*_lanes);
+    std::vector<float> p_re(_lanes), p_im(_lanes);
+    for (size_t i = 0; i < _size; i++) {
+        // conj(v[i ^ x_mask]) * v[i] for every lane
+        const float* ar = real(i ^ x_mask);
+        const float* ai = imag(i ^ x_mask);
+        const float* br = real(i);
+        const float* bi = imag(i);
+        for (size_t b = 0; b < _lanes; b++) {
+            p_re[b] = ar[b]*br[b] + ai[b]*bi[b];
+            p_im[b] = ar[b]*bi[b] - ai[b]*br[b];
+        }
+        for (size_t k = 0; k < z_masks.size(); k++) {
+            double sign = 1 - 2*(__builtin_popcountll(i & z_masks[k]) & 1);
+            for (size_t b = 0; b < _lanes; b++) {
+                res[k*_lanes + b] += sign*std::complex<double>(p_re[b], p_im[b]);
+            }
+        }
+    }
+}
+
+void BatchVector::extract(size_t lane, Vector& res) const {
+    assert(res.size() == _size && lane < _lanes);
+    for (size_t i = 0; i < _size; i++) {
+        res[i] = get(i, lane);
+    }
+}
+
+}
+}
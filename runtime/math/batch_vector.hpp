@@ -0,0 +1,160 @@
+/**
+ * Copyright (c) 2022 Alcides Andrade <andrade.alcides.junior@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef __RUNTIME__BATCH_VECTOR_H__
+#define __RUNTIME__BATCH_VECTOR_H__
+
+#include "types.hpp"
+#include "unitary.hpp"
+#include "vector.hpp"
+
+#include <complex>
+#include <vector>
+
+namespace runtime {
+namespace math {
+
+/**
+ * One 2x2 matrix per lane of a `BatchVector`. The entries are stored with the
+ * lane as the fastest index, i.e., entry `k = 2*row + col` of lane `b` is at
+ * position `k*lanes + b` of `real` and `imag`.
+ * */
+struct LaneMatrix {
+    size_t lanes;
+    std::vector<float> real;
+    std::vector<float> imag;
+
+    LaneMatrix(size_t lanes): lanes(lanes), real(4*lanes), imag(4*lanes) {};
+
+    /**
+     * Set the matrix of lane `lane` to the 2x2 matrix `mat`
+     * */
+    void set(size_t lane, const Unitary& mat);
+};
+
+/**
+ * A batch of `lanes` independent state vectors of the same size, interleaved
+ * amplitude by amplitude: for every amplitude index the real parts of all the
+ * lanes are stored contiguously, followed by their imaginary parts. Applying a gate
+ * then runs the same arithmetic over contiguous lanes, which the compiler turns
+ * into full-width SIMD even for gates on the lowest qubits.
+ * */
+class BatchVector {
+private:
+    size_t _size { 0 };
+    size_t _lanes { 0 };
+    float* _entries { nullptr };
+
+    inline float* real(size_t index) {
+        return _entries + 2*index*_lanes;
+    }
+
+    inline float* imag(size_t index) {
+        return _entries + (2*index + 1)*_lanes;
+    }
+
+    inline const float* real(size_t index) const {
+        return _entries + 2*index*_lanes;
+    }
+
+    inline const float* imag(size_t index) const {
+        return _entries + (2*index + 1)*_lanes;
+    }
+
+public:
+    BatchVector() = delete;
+    BatchVector(const BatchVector&) = delete;
+    BatchVector operator=(const BatchVector&) = delete;
+
+    BatchVector(BatchVector&& v): _size(v._size), _lanes(v._lanes), _entries(v._entries) {
+        v._entries = nullptr;
+    }
+
+    BatchVector(size_t size, size_t lanes);
+
+    ~BatchVector() {
+        if (_entries != nullptr) {
+            free(_entries);
+        }
+    }
+
+    inline size_t size() const {
+        return _size;
+    }
+
+    inline size_t lanes() const {
+        return _lanes;
+    }
+
+    inline cx_t get(size_t index, size_t lane) const {
+        return { real(index)[lane], imag(index)[lane] };
+    }
+
+    inline void set(size_t index, size_t lane, cx_t value) {
+        real(index)[lane] = value.real();
+        imag(index)[lane] = value.imag();
+    }
+
+    /**
+     * Set every lane to the basis state |index>
+     * */
+    void set_basis_state(size_t index);
+
+    /**
+     * Set every lane to the state `vec`, of the same size
+     * */
+    void set(const Vector& vec);
+
+    /**
+     * Apply the same matrix to the qubits `qubits` of every lane, with the
+     * qubit order of `Unitary::apply`.
+     * */
+    void apply(const Unitary& mat, const std::vector<size_t>& qubits);
+
+    /**
+     * Apply a different 2x2 matrix to the qubit `qubit` of each lane, only on
+     * the amplitudes where the qubits of the mask `controls` are all 1
+     * */
+    void apply(const LaneMatrix& mat, size_t qubit, size_t controls = 0);
+
+    /**
+     * The probability of measuring 1 on the qubit `qubit` of each lane
+     * */
+    void probabilities(size_t qubit, std::vector<double>& res) const;
+
+    /**
+     * The lane version of `Vector::expectation`: the value of the Pauli string with
+     * the z mask `z_masks[k]` in lane `b` is added to `res[k*lanes() + b]`.
+     * */
+    void expectation(size_t x_mask, const std::vector<size_t>& z_masks,
+                     std::vector<std::complex<double>>& res) const;
+
+    /**
+     * Copy the state of one lane into a vector of the same size
+     * */
+    void extract(size_t lane, Vector& res) const;
+};
+
+}
+}
+
+#endif // __RUNTIME__BATCH_VECTOR_H__
@@ -0,0 +1,554 @@
+/**
+ * Copyright (c) 2022 Alcides Andrade <andrade.alcides.junior@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "chunked_vector.hpp"
+#include "../error.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <fcntl.h>
+#include <random>
+#include <sys/mman.h>
+#include <unistd.h>
+
+namespace runtime {
+namespace math {
+
+static Unitary copy(const Unitary& mat) {
+    Unitary res(mat.dim());
+    for (size_t r = 0; r < mat.dim(); r++) {
+        for (size_t c = 0; c < mat.dim(); c++) {
+            res(r, c) = mat(r, c);
+        }
+    }
+    return res;
+}
+
+static double elapsed(std::chrono::steady_clock::time_point start) {
+    std::chrono::duration<double> d = std::chrono::steady_clock::now() - start;
+    return d.count();
+}
+
+MemoryChunkStore::MemoryChunkStore(size_t nr_chunks, size_t chunk_size):
+    _chunk_size(chunk_size), _chunks(nr_chunks), _zero(nr_chunks, false)
+{}
+
+cx_t* MemoryChunkStore::acquire(size_t chunk) {
+    auto& data = _chunks[chunk];
+    if (!data) {
+        data.reset(new cx_t[_chunk_size]());
+        _zero[chunk] = true;
+        _peak_allocated = std::max(_peak_allocated, ++_nr_allocated);
+    }
+    return data.get();
+}
+
+void MemoryChunkStore::release(size_t chunk, bool modified) {
+    if (!modified && _zero[chunk]) {
+        discard(chunk);
+    }
+    _zero[chunk] = false;
+}
+
+bool MemoryChunkStore::is_zero(size_t chunk) const {
+    return !_chunks[chunk];
+}
+
+void MemoryChunkStore::discard(size_t chunk) {
+    if (_chunks[chunk]) {
+        _chunks[chunk].reset();
+        _nr_allocated--;
+    }
+}
+
+FileChunkStore::FileChunkStore(const std::string& path, size_t nr_chunks, size_t chunk_size):
+    _path(path), _chunk_size(chunk_size), _bytes(nr_chunks*chunk_size*sizeof(cx_t)),
+    _zero(nr_chunks, true)
+{
+    _fd = open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0600);
+    if (_fd < 0) {
+        throw Error("cannot create " + path + ": " + std::strerror(errno));
+    }
+    // the file starts out sparse, reading a hole gives zeros
+    if (ftruncate(_fd, _bytes) != 0) {
+        std::string msg = std::strerror(errno);
+        close(_fd);
+        unlink(path.c_str());
+        throw Error("cannot resize " + path + ": " + msg);
+    }
+    void* data = mmap(nullptr, _bytes, PROT_READ | PROT_WRITE, MAP_SHARED, _fd, 0);
+    if (data == MAP_FAILED) {
+        std::string msg = std::strerror(errno);
+        close(_fd);
+        unlink(path.c_str());
+        throw Error("cannot map " + path + ": " + msg);
+    }
+    _data = static_cast<cx_t*>(data);
+    madvise(_data, _bytes, MADV_SEQUENTIAL);
+}
+
+FileChunkStore::~FileChunkStore() {
+    munmap(_data, _bytes);
+    close(_fd);
+    unlink(_path.c_str());
+}
+
+cx_t* FileChunkStore::acquire(size_t chunk) {
+    return _data + chunk*_chunk_size;
+}
+
+void FileChunkStore::release(size_t chunk, bool modified) {
+    void* start = _data + chunk*_chunk_size;
+    size_t bytes = _chunk_size*sizeof(cx_t);
+    if (modified) {
+        msync(start, bytes, MS_ASYNC);
+        _zero[chunk] = false;
+    }
+    // the pages stay in the page cache, this only lets the kernel reclaim them
+    madvise(start, bytes, MADV_DONTNEED);
+}
+
+void FileChunkStore::prefetch(size_t chunk) {
+    if (!_zero[chunk]) {
+        madvise(_data + chunk*_chunk_size, _chunk_size*sizeof(cx_t), MADV_WILLNEED);
+    }
+}
+
+bool FileChunkStore::is_zero(size_t chunk) const {
+    return _zero[chunk];
+}
+
+void FileChunkStore::discard(size_t chunk) {
+    size_t bytes = _chunk_size*sizeof(cx_t);
+    // punching a hole frees the blocks on disk and reads back as zeros
+    if (fallocate(_fd, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE, chunk*bytes, bytes) != 0) {
+        ChunkStore::discard(chunk);
+    }
+    _zero[chunk] = true;
+}
+
+static void put_varint(std::vector<uint8_t>& out, uint64_t value) {
+    while (value >= 0x80) {
+        out.push_back(uint8_t(value) | 0x80);
+        value >>= 7;
+    }
+    out.push_back(uint8_t(value));
+}
+
+static uint64_t get_varint(const uint8_t*& in) {
+    uint64_t value = 0;
+    for (size_t shift = 0; ; shift += 7) {
+        uint8_t byte = *in++;
+        value |= uint64_t(byte & 0x7f) << shift;
+        if (!(byte & 0x80)) {
+            return value;
+        }
+    }
+}
+
+static uint64_t zigzag(int64_t value) {
+    return (uint64_t(value) << 1) ^ uint64_t(value >> 63);
+}
+
+static int64_t unzigzag(uint64_t value) {
+    return int64_t(value >> 1) ^ -int64_t(value & 1);
+}
+
+CompressedChunkStore::CompressedChunkStore(size_t nr_chunks, size_t chunk_size,
+                                           size_t working_set, double error_bound):
+    _chunk_size(chunk_size), _error_bound(error_bound), _compressed(nr_chunks),
+    _working_set(working_set), _slot(nr_chunks, none)
+{
+    if (working_set < 2) {
+        throw Error("the working set must hold at least 2 chunks");
+    }
+    if (error_bound != 0 && !(error_bound >= 1e-12)) {
+        throw Error("the error bound must be 0 for lossless compression or at least 1e-12");
+    }
+    for (auto& entry : _working_set) {
+        entry.chunk = none;
+    }
+    _stats.uncompressed_bytes = nr_chunks*chunk_size*sizeof(cx_t);
+}
+
+/**
+ * Encode the chunk as runs of a varint count followed by the value: the raw
+ * bits of both components when lossless, and both components divided by
+ * 2*error_bound, rounded and zigzag encoded otherwise.
+ * */
+void CompressedChunkStore::compress(const cx_t* data, std::vector<uint8_t>& out) const {
+    out.clear();
+    double step = 2*_error_bound;
+    auto encode = [&](cx_t value) {
+        if (_error_bound == 0) {
+            uint32_t bits[2];
+            std::memcpy(bits, &value, sizeof(bits));
+            return std::make_pair(uint64_t(bits[0]), uint64_t(bits[1]));
+        }
+        return std::make_pair(zigzag(std::llround(value.real()/step)),
+                              zigzag(std::llround(value.imag()/step)));
+    };
+    size_t i = 0;
+    while (i < _chunk_size) {
+        auto value = encode(data[i]);
+        size_t j = i + 1;
+        while (j < _chunk_size && encode(data[j]) == value) {
+            j++;
+        }
+        if (i == 0 && j == _chunk_size && value.first == 0 && value.second == 0) {
+            // all zeros
+            return;
+        }
+        put_varint(out, j - i);
+        put_varint(out, value.first);
+        put_varint(out, value.second);
+        i = j;
+    }
+    out.shrink_to_fit();
+}
+
+void CompressedChunkStore::decompress(const std::vector<uint8_t>& in, cx_t* data) const {
+    if (in.empty()) {
+        std::fill(data, data + _chunk_size, cx_t(0));
+        return;
+    }
+    double step = 2*_error_bound;
+    const uint8_t* p = in.data();
+    size_t i = 0;
+    while (i < _chunk_size) {
+        size_t count = get_varint(p);
+        uint64_t first = get_varint(p);
+        uint64_t second = get_varint(p);
+        cx_t value;
+        if (_error_bound == 0) {
+            uint32_t bits[2] = { uint32_t(first), uint32_t(second) };
+            std::memcpy(&value, bits, sizeof(bits));
+        } else {
+            value = cx_t(unzigzag(first)*step, unzigzag(second)*step);
+        }
+        std::fill(data + i, data + i + count, value);
+        i += count;
+    }
+}
+
+cx_t* CompressedChunkStore::acquire(size_t chunk) {
+    _clock++;
+    if (_slot[chunk] != none) {
+        auto& entry = _working_set[_slot[chunk]];
+        entry.pins++;
+        entry.last_use = _clock;
+        return entry.data.data();
+    }
+    // take a free slot, or else evict the least recently used unpinned chunk
+    size_t victim = none;
+    for (size_t s = 0; s < _working_set.size(); s++) {
+        auto& entry = _working_set[s];
+        if (entry.chunk == none) {
+            victim = s;
+            break;
+        }
+        if (entry.pins == 0 && (victim == none || entry.last_use < _working_set[victim].last_use)) {
+            victim = s;
+        }
+    }
+    if (victim == none) {
+        throw Error("all chunks in the working set are in use");
+    }
+    auto& entry = _working_set[victim];
+    if (entry.chunk != none) {
+        if (entry.dirty) {
+            auto& out = _compressed[entry.chunk];
+            _stats.compressed_bytes -= out.size();
+            compress(entry.data.data(), out);
+            _stats.compressed_bytes += out.size();
+            _stats.nr_compressions++;
+        }
+        _slot[entry.chunk] = none;
+    }
+    entry.data.resize(_chunk_size);
+    decompress(_compressed[chunk], entry.data.data());
+    _stats.nr_decompressions++;
+    entry.chunk = chunk;
+    entry.pins = 1;
+    entry.last_use = _clock;
+    entry.dirty = false;
+    _slot[chunk] = victim;
+    return entry.data.data();
+}
+
+void CompressedChunkStore::release(size_t chunk, bool modified) {
+    auto& entry = _working_set[_slot[chunk]];
+    entry.pins--;
+    entry.dirty |= modified;
+}
+
+bool CompressedChunkStore::is_zero(size_t chunk) const {
+    if (_slot[chunk] != none && _working_set[_slot[chunk]].dirty) {
+        return false;
+    }
+    return _compressed[chunk].empty();
+}
+
+void CompressedChunkStore::discard(size_t chunk) {
+    if (_slot[chunk] != none) {
+        auto& entry = _working_set[_slot[chunk]];
+        entry.chunk = none;
+        entry.dirty = false;
+        _slot[chunk] = none;
+    }
+    _stats.compressed_bytes -= _compressed[chunk].size();
+    _compressed[chunk] = {};
+}
+
+ChunkedVector::ChunkedVector(size_t nr_qubits, size_t chunk_qubits, std::unique_ptr<ChunkStore> store):
+    _nr_qubits(nr_qubits), _chunk_qubits(chunk_qubits), _store(std::move(store)),
+    _layout(nr_qubits), _logical(nr_qubits), _last_use(nr_qubits)
+{
+    if (chunk_qubits == 0 || chunk_qubits > nr_qubits) {
+        throw Error("a chunk must have between 1 and " + std::to_string(nr_qubits) + " qubits");
+    }
+    for (size_t q = 0; q < nr_qubits; q++) {
+        _layout[q] = q;
+        _logical[q] = q;
+    }
+    set(0, 1);
+}
+
+template<class F> void ChunkedVector::pass(bool modify, const F& f) {
+    auto start = std::chrono::steady_clock::now();
+    size_t n = nr_chunks();
+    _store->prefetch(0);
+    size_t nr_touched = 0;
+    for (size_t chunk = 0; chunk < n; chunk++) {
+        if (_store->is_zero(chunk)) {
+            _stats.nr_skipped++;
+            continue;
+        }
+        if (chunk + 1 < n) {
+            _store->prefetch(chunk + 1);
+        }
+        cx_t* data = _store->acquire(chunk);
+        f(chunk, data);
+        _store->release(chunk, modify);
+        nr_touched++;
+    }
+    _stats.nr_passes++;
+    _stats.bytes += nr_touched*chunk_size()*sizeof(cx_t)*(modify ? 2 : 1);
+    _stats.seconds += elapsed(start);
+}
+
+void ChunkedVector::apply_queue(cx_t* chunk) const {
+    for (auto& [mat, qubits] : _queue) {
+        mat.apply(chunk, chunk_size(), qubits);
+    }
+}
+
+void ChunkedVector::flush() {
+    if (_queue.empty()) {
+        return;
+    }
+    pass(true, [&](size_t, cx_t* data) {
+        apply_queue(data);
+    });
+    _queue.clear();
+}
+
+/**
+ * Exchange the physical qubits `low`, which is chunk-local, and `high`, which
+ * selects the chunk, applying the queued gates in the same pass.
+ * */
+void ChunkedVector::swap(size_t low, size_t high) {
+    auto start = std::chrono::steady_clock::now();
+    size_t n = nr_chunks();
+    size_t size = chunk_size();
+    size_t chunk_bit = size_t(1) << (high - _chunk_qubits);
+    size_t low_bit = size_t(1) << low;
+    size_t nr_touched = 0;
+    for (size_t first = 0; first < n; first++) {
+        if (first & chunk_bit) {
+            continue;
+        }
+        size_t second = first | chunk_bit;
+        if (_store->is_zero(first) && _store->is_zero(second)) {
+            _stats.nr_skipped += 2;
+            continue;
+        }
+        size_t next = (first + 1) & ~chunk_bit;
+        if (next < n && !(next & chunk_bit)) {
+            _store->prefetch(next);
+            _store->prefetch(next | chunk_bit);
+        }
+        cx_t* a = _store->acquire(first);
+        cx_t* b = _store->acquire(second);
+        apply_queue(a);
+        apply_queue(b);
+        // entries with the low bit set in the first chunk change place with
+        // the ones with the low bit clear in the second chunk
+        for (size_t i = low_bit; i < size; i = (i + 1) | low_bit) {
+            std::swap(a[i], b[i ^ low_bit]);
+        }
+        _store->release(first, true);
+        _store->release(second, true);
+        nr_touched += 2;
+    }
+    _queue.clear();
+    std::swap(_logical[low], _logical[high]);
+    _layout[_logical[low]] = low;
+    _layout[_logical[high]] = high;
+    std::swap(_last_use[low], _last_use[high]);
+    _stats.nr_passes++;
+    _stats.nr_swaps++;
+    _stats.bytes += 2*nr_touched*size*sizeof(cx_t);
+    _stats.seconds += elapsed(start);
+}
+
+void ChunkedVector::apply(const Unitary& mat, const std::vector<size_t>& qubits) {
+    if (qubits.size() > _chunk_qubits) {
+        throw Error("gate on " + std::to_string(qubits.size()) + " qubits does not fit in a chunk of "
+                    + std::to_string(_chunk_qubits) + " qubits");
+    }
+    _clock++;
+    std::vector<size_t> physical;
+    for (auto q : qubits) {
+        physical.push_back(_layout[q]);
+    }
+    for (auto& p : physical) {
+        if (p < _chunk_qubits) {
+            continue;
+        }
+        size_t victim = _chunk_qubits;
+        for (size_t l = 0; l < _chunk_qubits; l++) {
+            bool used = std::find(physical.begin(), physical.end(), l) != physical.end();
+            if (!used && (victim == _chunk_qubits || _last_use[l] < _last_use[victim])) {
+                victim = l;
+            }
+        }
+        swap(victim, p);
+        p = victim;
+    }
+    for (auto p : physical) {
+        _last_use[p] = _clock;
+    }
+    _queue.emplace_back(copy(mat), physical);
+}
+
+size_t ChunkedVector::physical_index(size_t index) const {
+    size_t res = 0;
+    for (size_t q = 0; q < _nr_qubits; q++) {
+        res |= ((index >> q) & 1) << _layout[q];
+    }
+    return res;
+}
+
+bool ChunkedVector::measure(size_t qubit) {
+    flush();
+    size_t p = _layout[qubit];
+    size_t size = chunk_size();
+    double prob[2] = { 0, 0 };
+    pass(false, [&](size_t chunk, cx_t* data) {
+        for (size_t i = 0; i < size; i++) {
+            size_t bit = p < _chunk_qubits ? (i >> p) & 1 : (chunk >> (p - _chunk_qubits)) & 1;
+            prob[bit] += std::norm(data[i]);
+        }
+    });
+    std::random_device rd;
+    std::mt19937 gen(rd());
+    std::uniform_real_distribution<double> distr(0, prob[0] + prob[1]);
+    size_t m = distr(gen) < prob[0] ? 0 : 1;
+    float scale = 1/std::sqrt(prob[m]);
+    if (p >= _chunk_qubits) {
+        // whole chunks are dropped without reading them
+        size_t chunk_bit = size_t(1) << (p - _chunk_qubits);
+        for (size_t chunk = 0; chunk < nr_chunks(); chunk++) {
+            if (bool(chunk & chunk_bit) != bool(m) && !_store->is_zero(chunk)) {
+                _store->discard(chunk);
+            }
+        }
+    }
+    std::vector<size_t> zeroed;
+    pass(true, [&](size_t chunk, cx_t* data) {
+        bool zero = true;
+        for (size_t i = 0; i < size; i++) {
+            if (p < _chunk_qubits && ((i >> p) & 1) != m) {
+                data[i] = 0;
+            } else {
+                data[i] *= scale;
+                zero = zero && data[i] == cx_t(0);
+            }
+        }
+        if (zero) {
+            zeroed.push_back(chunk);
+        }
+    });
+    for (auto chunk : zeroed) {
+        _store->discard(chunk);
+    }
+    return m == 1;
+}
+
+void ChunkedVector::reset(size_t qubit) {
+    if (measure(qubit)) {
+        apply(Unitary({ 0, 1, 1, 0 }), { qubit });
+    }
+}
+
+cx_t ChunkedVector::get(size_t index) {
+    flush();
+    size_t p = physical_index(index);
+    size_t chunk = p >> _chunk_qubits;
+    if (_store->is_zero(chunk)) {
+        return 0;
+    }
+    cx_t res = _store->acquire(chunk)[p & (chunk_size() - 1)];
+    _store->release(chunk, false);
+    return res;
+}
+
+void ChunkedVector::set(size_t index, cx_t value) {
+    flush();
+    size_t p = physical_index(index);
+    size_t chunk = p >> _chunk_qubits;
+    _store->acquire(chunk)[p & (chunk_size() - 1)] = value;
+    _store->release(chunk, true);
+}
+
+void ChunkedVector::normalize() {
+    flush();
+    size_t size = chunk_size();
+    double norm = 0;
+    pass(false, [&](size_t, cx_t* data) {
+        for (size_t i = 0; i < size; i++) {
+            norm += std::norm(data[i]);
+        }
+    });
+    float scale = 1/std::sqrt(norm);
+    pass(true, [&](size_t, cx_t* data) {
+        for (size_t i = 0; i < size; i++) {
+            data[i] *= scale;
+        }
+    });
+}
+
+}
+}
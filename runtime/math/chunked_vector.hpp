@@ -0,0 +1,331 @@
+/**
+ * Copyright (c) 2022 Alcides Andrade <andrade.alcides.junior@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef __RUNTIME__CHUNKED_VECTOR_H__
+#define __RUNTIME__CHUNKED_VECTOR_H__
+
+#include "types.hpp"
+#include "unitary.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace runtime {
+namespace math {
+
+/**
+ * Storage for the chunks of a `ChunkedVector`. A chunk is acquired before the
+ * gate kernels touch it and released afterwards; the pointer returned by
+ * `acquire` is only valid until the matching `release`.
+ * */
+class ChunkStore {
+public:
+    virtual ~ChunkStore() = default;
+
+    virtual cx_t* acquire(size_t chunk) = 0;
+
+    /**
+     * Give the chunk back to the store, `modified` tells whether the kernels
+     * wrote to it since it was acquired
+     * */
+    virtual void release(size_t chunk, bool modified) = 0;
+
+    /**
+     * Hint that `chunk` will be acquired soon
+     * */
+    virtual void prefetch(size_t) {}
+
+    /**
+     * Whether the chunk is known to hold only zeros, in which case the
+     * kernels skip it. Acquiring such a chunk gives a buffer of zeros.
+     * */
+    virtual bool is_zero(size_t) const {
+        return false;
+    }
+
+    /**
+     * Set every entry of the chunk to zero, releasing its storage if the
+     * store can. The chunk must not be acquired.
+     * */
+    virtual void discard(size_t chunk) {
+        cx_t* data = acquire(chunk);
+        std::fill(data, data + chunk_size(), cx_t(0));
+        release(chunk, true);
+    }
+
+    virtual size_t chunk_size() const = 0;
+};
+
+/**
+ * Chunks in memory, where a chunk of zeros is not allocated until a kernel
+ * writes to it, and is freed again when discarded.
+ * */
+class MemoryChunkStore: public ChunkStore {
+private:
+    size_t _chunk_size;
+    std::vector<std::unique_ptr<cx_t[]>> _chunks;
+    // chunks that are allocated but were zero when acquired
+    std::vector<bool> _zero;
+    size_t _nr_allocated { 0 };
+    size_t _peak_allocated { 0 };
+
+public:
+    MemoryChunkStore(size_t nr_chunks, size_t chunk_size);
+
+    inline size_t nr_allocated() const {
+        return _nr_allocated;
+    }
+
+    inline size_t peak_allocated() const {
+        return _peak_allocated;
+    }
+
+    cx_t* acquire(size_t chunk) override;
+    void release(size_t chunk, bool modified) override;
+    bool is_zero(size_t chunk) const override;
+    void discard(size_t chunk) override;
+
+    size_t chunk_size() const override {
+        return _chunk_size;
+    }
+};
+
+/**
+ * Chunks kept in a file, typically on a local NVMe drive, that is mapped into
+ * memory. Prefetching and write-back are left to the kernel through madvise
+ * and asynchronous msync, so that the I/O overlaps with the gate kernels.
+ * The file is removed when the store is destroyed.
+ * */
+class FileChunkStore: public ChunkStore {
+private:
+    std::string _path;
+    size_t _chunk_size;
+    size_t _bytes;
+    int _fd { -1 };
+    cx_t* _data { nullptr };
+    // chunks that have not been written since they were last zero
+    std::vector<bool> _zero;
+
+public:
+    FileChunkStore(const std::string& path, size_t nr_chunks, size_t chunk_size);
+    FileChunkStore(const FileChunkStore&) = delete;
+    FileChunkStore& operator=(const FileChunkStore&) = delete;
+    ~FileChunkStore();
+
+    cx_t* acquire(size_t chunk) override;
+    void release(size_t chunk, bool modified) override;
+    void prefetch(size_t chunk) override;
+    bool is_zero(size_t chunk) const override;
+    void discard(size_t chunk) override;
+
+    size_t chunk_size() const override {
+        return _chunk_size;
+    }
+};
+
+/**
+ * Chunks kept compressed in memory, apart from a small working set of
+ * decompressed chunks that the gate kernels operate on. A chunk is compressed
+ * again when it is evicted from the working set after being modified.
+ *
+ * The encoding stores runs of equal amplitudes, so all-zero and repeated
+ * regions take a few bytes. With `error_bound` zero the compression is
+ * lossless; otherwise the real and imaginary parts are rounded to a multiple
+ * of 2*error_bound first, so every compression moves an entry by at most
+ * `error_bound` in each component.
+ * */
+class CompressedChunkStore: public ChunkStore {
+public:
+    struct Stats {
+        size_t nr_compressions { 0 };
+        size_t nr_decompressions { 0 };
+        size_t compressed_bytes { 0 };
+        size_t uncompressed_bytes { 0 };
+
+        /**
+         * Size of the chunks without compression over their compressed size,
+         * the working set not included
+         * */
+        double ratio() const {
+            return double(uncompressed_bytes)/std::max<size_t>(compressed_bytes, 1);
+        }
+    };
+
+private:
+    struct Entry {
+        size_t chunk;
+        size_t pins { 0 };
+        size_t last_use { 0 };
+        bool dirty { false };
+        std::vector<cx_t> data;
+    };
+
+    static constexpr size_t none = ~size_t(0);
+
+    size_t _chunk_size;
+    double _error_bound;
+    // an empty encoding stands for a chunk of zeros
+    std::vector<std::vector<uint8_t>> _compressed;
+    std::vector<Entry> _working_set;
+    std::vector<size_t> _slot;
+    size_t _clock { 0 };
+    Stats _stats;
+
+    void compress(const cx_t* data, std::vector<uint8_t>& out) const;
+    void decompress(const std::vector<uint8_t>& in, cx_t* data) const;
+
+public:
+    CompressedChunkStore(size_t nr_chunks, size_t chunk_size,
+                         size_t working_set = 4, double error_bound = 0);
+
+    inline const Stats& stats() const {
+        return _stats;
+    }
+
+    cx_t* acquire(size_t chunk) override;
+    void release(size_t chunk, bool modified) override;
+    bool is_zero(size_t chunk) const override;
+    void discard(size_t chunk) override;
+
+    size_t chunk_size() const override {
+        return _chunk_size;
+    }
+};
+
+/**
+ * A state vector split into chunks of 2^chunk_qubits amplitudes that are kept
+ * in a `ChunkStore`, so that it can be larger than the available memory.
+ *
+ * Gates are applied in passes over the chunks. A gate is chunk-local when all
+ * of its qubits are stored in the low `chunk_qubits` bits of the index; such
+ * gates are queued and applied together in the next pass. A gate on a high
+ * qubit first swaps that qubit with the least recently used low qubit, which
+ * only changes the layout between logical and physical qubits.
+ *
+ * Chunks that the store reports as zero are skipped by every pass, since the
+ * gates map them to zero again, and chunks that a measurement or reset sets
+ * to zero are discarded.
+ * */
+class ChunkedVector {
+public:
+    struct Stats {
+        size_t nr_passes { 0 };
+        size_t nr_swaps { 0 };
+        // zero chunks that passes did not have to touch
+        size_t nr_skipped { 0 };
+        // bytes of chunks acquired by the passes, counted once for reading and
+        // once more for writing back modified chunks
+        size_t bytes { 0 };
+        double seconds { 0 };
+
+        /**
+         * Effective bandwidth of the passes in bytes per second
+         * */
+        double bandwidth() const {
+            return seconds > 0 ? bytes/seconds : 0;
+        }
+    };
+
+private:
+    size_t _nr_qubits;
+    size_t _chunk_qubits;
+    std::unique_ptr<ChunkStore> _store;
+    // physical position of each logical qubit and its inverse
+    std::vector<size_t> _layout;
+    std::vector<size_t> _logical;
+    // last gate that used each physical qubit, to pick the qubit to swap out
+    std::vector<size_t> _last_use;
+    size_t _clock { 0 };
+    // chunk-local gates on physical qubits that have not been applied yet
+    std::vector<std::pair<Unitary, std::vector<size_t>>> _queue;
+    Stats _stats;
+
+    template<class F> void pass(bool modify, const F& f);
+    void apply_queue(cx_t* chunk) const;
+    void swap(size_t low, size_t high);
+    size_t physical_index(size_t index) const;
+
+public:
+    /**
+     * Create the vector |0...0> on `nr_qubits` qubits. The store must hold
+     * 2^(nr_qubits - chunk_qubits) chunks of 2^chunk_qubits zeros.
+     * */
+    ChunkedVector(size_t nr_qubits, size_t chunk_qubits, std::unique_ptr<ChunkStore> store);
+
+    inline size_t nr_qubits() const {
+        return _nr_qubits;
+    }
+
+    inline size_t size() const {
+        return size_t(1) << _nr_qubits;
+    }
+
+    inline size_t chunk_size() const {
+        return size_t(1) << _chunk_qubits;
+    }
+
+    inline size_t nr_chunks() const {
+        return size_t(1) << (_nr_qubits - _chunk_qubits);
+    }
+
+    inline const Stats& stats() const {
+        return _stats;
+    }
+
+    inline const ChunkStore& store() const {
+        return *_store;
+    }
+
+    /**
+     * Apply the gate `mat` to `qubits` as in `Unitary::apply`. The gate may
+     * act on at most `chunk_qubits` qubits.
+     * */
+    void apply(const Unitary& mat, const std::vector<size_t>& qubits);
+
+    /**
+     * Apply the queued gates
+     * */
+    void flush();
+
+    /**
+     * Measure `qubit`, collapsing and renormalizing the vector
+     * */
+    bool measure(size_t qubit);
+
+    /**
+     * Measure `qubit` and flip it back to zero if needed
+     * */
+    void reset(size_t qubit);
+
+    cx_t get(size_t index);
+    void set(size_t index, cx_t value);
+    void normalize();
+};
+
+}
+}
+
+#endif // __RUNTIME__CHUNKED_VECTOR_H__
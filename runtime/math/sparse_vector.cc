@@ -0,0 +1,236 @@
+/**
+ * Copyright (c) 2022 Alcides Andrade <andrade.alcides.junior@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "sparse_vector.hpp"
+
+#include <cassert>
+#include <map>
+#include <random>
+
+namespace runtime {
+namespace math {
+
+static const size_t min_capacity = 8;
+
+static inline size_t hash(size_t index) {
+    return index*0x9e3779b97f4a7c15ull;
+}
+
+SparseVector::SparseVector(size_t size):
+    _size(size), _slots(min_capacity, { empty, 0 })
+{}
+
+size_t SparseVector::find(size_t index) const {
+    size_t mask = _slots.size() - 1;
+    size_t slot = (hash(index) >> 7) & mask;
+    while (_slots[slot].index != empty && _slots[slot].index != index) {
+        slot = (slot + 1) & mask;
+    }
+    return slot;
+}
+
+void SparseVector::grow() {
+    std::vector<Slot> old(2*_slots.size(), { empty, 0 });
+    old.swap(_slots);
+    for (auto& slot : old) {
+        if (slot.index != empty) {
+            _slots[find(slot.index)] = slot;
+        }
+    }
+}
+
+void SparseVector::resize(size_t size) {
+    _size = size;
+}
+
+cx_t SparseVector::get(size_t index) const {
+    auto& slot = _slots[find(index)];
+    return slot.index == empty ? 0 : slot.value;
+}
+
+void SparseVector::set(size_t index, cx_t value) {
+    size_t slot = find(index);
+    if (_slots[slot].index == empty) {
+        if (2*(_count + 1) > _slots.size()) {
+            grow();
+            slot = find(index);
+        }
+        _slots[slot].index = index;
+        _count++;
+    }
+    _slots[slot].value = value;
+}
+
+void SparseVector::add(size_t index, cx_t value) {
+    size_t slot = find(index);
+    if (_slots[slot].index == empty) {
+        set(index, value);
+    } else {
+        _slots[slot].value += value;
+    }
+}
+
+void SparseVector::clear() {
+    std::fill(_slots.begin(), _slots.end(), Slot { empty, 0 });
+    _count = 0;
+}
+
+void SparseVector::apply(const Unitary& mat, const std::vector<size_t>& qubits) {
+    size_t k = qubits.size();
+    assert(mat.dim() == size_t(1) << k);
+    size_t mask = 0;
+    for (auto qubit : qubits) {
+        mask |= size_t(1) << qubit;
+    }
+    // scatter every entry into the column of the matrix selected by its qubits
+    SparseVector res(_size);
+    for_each([&](size_t index, cx_t value) {
+        size_t col = 0;
+        for (size_t j = 0; j < k; j++) {
+            col |= ((index >> qubits[j]) & 1) << (k - 1 - j);
+        }
+        size_t base = index & ~mask;
+        for (size_t row = 0; row < mat.dim(); row++) {
+            cx_t m = mat(row, col);
+            if (m == 0.f) {
+                continue;
+            }
+            size_t target = base;
+            for (size_t j = 0; j < k; j++) {
+                target |= ((row >> (k - 1 - j)) & 1) << qubits[j];
+            }
+            res.add(target, m*value);
+        }
+    });
+    // drop the entries that cancelled out
+    clear();
+    res.for_each([&](size_t index, cx_t value) {
+        if (std::abs(value) >= tolerance) {
+            set(index, value);
+        }
+    });
+}
+
+void SparseVector::reset(size_t offset, size_t size) {
+    size_t mask = ((size_t(1) << size) - 1) << offset;
+    SparseVector res(_size);
+    for_each([&](size_t index, cx_t value) {
+        if ((index & mask) == 0) {
+            res.set(index, value);
+        }
+    });
+    *this = std::move(res);
+    normalize();
+}
+
+void SparseVector::measure(size_t offset, size_t size, std::vector<bool>& res) {
+    size_t block = (size_t(1) << size) - 1;
+    std::map<size_t, double> probabilities;
+    for_each([&](size_t index, cx_t value) {
+        probabilities[(index >> offset) & block] += std::norm(value);
+    });
+    std::vector<size_t> outcomes;
+    std::vector<double> weights;
+    for (auto [outcome, p] : probabilities) {
+        outcomes.push_back(outcome);
+        weights.push_back(p);
+    }
+    std::random_device rd;
+    std::mt19937 gen(rd());
+    std::discrete_distribution<size_t> distr(weights.begin(), weights.end());
+    size_t m = outcomes[distr(gen)];
+
+    SparseVector kept(_size);
+    for_each([&](size_t index, cx_t value) {
+        if (((index >> offset) & block) == m) {
+            kept.set(index, value);
+        }
+    });
+    *this = std::move(kept);
+    normalize();
+    for (size_t i = 0; i < size; i++) {
+        res[i] = (m & 1) == 1;
+        m >>= 1;
+    }
+}
+
+void SparseVector::normalize() {
+    float norm = 0;
+    for_each([&](size_t, cx_t value) {
+        norm += std::norm(value);
+    });
+    norm = std::sqrt(norm);
+    for (auto& slot : _slots) {
+        if (slot.index != empty) {
+            slot.value /= norm;
+        }
+    }
+}
+
+void SparseVector::expectation(size_t x_mask, const std::vector<size_t>& z_masks,
+                               std::vector<std::complex<double>>& res) const
+{
+    assert(res.size() == z_masks.size());
+    for_each([&](size_t index, cx_t value) {
+        cx_t flipped = x_mask == 0 ? value : get(index ^ x_mask);
+        if (flipped == 0.f) {
+            return;
+        }
+        std::complex<double> p = std::conj(flipped)*value;
+        for (size_t k = 0; k < z_masks.size(); k++) {
+            double sign = 1 - 2*(__builtin_popcountll(index & z_masks[k]) & 1);
+            res[k] += sign*p;
+        }
+    });
+}
+
+SparseVector SparseVector::project(size_t qubit, bool value) const {
+    SparseVector res(_size/2);
+    size_t low = (size_t(1) << qubit) - 1;
+    for_each([&](size_t index, cx_t entry) {
+        if (((index >> qubit) & 1) == value) {
+            res.set(((index >> 1) & ~low) | (index & low), entry);
+        }
+    });
+    return res;
+}
+
+void SparseVector::to_dense(Vector& res) const {
+    assert(res.size() == _size);
+    res.fill(0);
+    for_each([&](size_t index, cx_t value) {
+        res[index] = value;
+    });
+}
+
+SparseVector SparseVector::from_dense(const Vector& vec) {
+    SparseVector res(vec.size());
+    for (size_t i = 0; i < vec.size(); i++) {
+        if (std::abs(vec[i]) >= tolerance) {
+            res.set(i, vec[i]);
+        }
+    }
+    return res;
+}
+
+}
+}
@@ -0,0 +1,145 @@
+/**
+ * Copyright (c) 2022 Alcides Andrade <andrade.alcides.junior@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef __RUNTIME__SPARSE_VECTOR_H__
+#define __RUNTIME__SPARSE_VECTOR_H__
+
+#include "types.hpp"
+#include "unitary.hpp"
+#include "vector.hpp"
+
+#include <complex>
+#include <iostream>
+#include <vector>
+
+namespace runtime {
+namespace math {
+
+/**
+ * A vector that only stores its nonzero entries, in an open-addressing hash
+ * map from index to value with linear probing. Applying a gate costs time
+ * proportional to the number of nonzero entries instead of the size.
+ * */
+class SparseVector {
+private:
+    struct Slot {
+        size_t index;
+        cx_t value;
+    };
+
+    static constexpr size_t empty = ~size_t(0);
+
+    size_t _size { 0 };
+    size_t _count { 0 };
+    // a power of two, at least twice the number of entries
+    std::vector<Slot> _slots;
+
+    size_t find(size_t index) const;
+    void grow();
+
+public:
+    // entries whose absolute value is below this are dropped after a gate
+    static constexpr float tolerance = 1e-7f;
+
+    SparseVector(size_t size);
+
+    inline size_t size() const {
+        return _size;
+    }
+
+    inline size_t nr_nonzeros() const {
+        return _count;
+    }
+
+    /**
+     * Change the size of the vector, keeping the entries
+     * */
+    void resize(size_t size);
+
+    cx_t get(size_t index) const;
+    void set(size_t index, cx_t value);
+
+    /**
+     * Add `value` to the entry `index`
+     * */
+    void add(size_t index, cx_t value);
+
+    /**
+     * Set every entry to zero
+     * */
+    void clear();
+
+    /**
+     * Call `f(index, value)` for every stored entry
+     * */
+    template <typename F>
+    void for_each(F f) const {
+        for (auto& slot : _slots) {
+            if (slot.index != empty) {
+                f(slot.index, slot.value);
+            }
+        }
+    }
+
+    /**
+     * The sparse version of `Unitary::apply`, with the same qubit order
+     * */
+    void apply(const Unitary& mat, const std::vector<size_t>& qubits);
+
+    /**
+     * The sparse versions of the methods of `Vector` with the same name
+     * */
+    void reset(size_t offset, size_t size);
+    void measure(size_t offset, size_t size, std::vector<bool>& res);
+    void normalize();
+    void expectation(size_t x_mask, const std::vector<size_t>& z_masks,
+                     std::vector<std::complex<double>>& res) const;
+
+    /**
+     * The sparse version of `Vector::project`
+     * */
+    SparseVector project(size_t qubit, bool value) const;
+
+    /**
+     * Write the entries into a dense vector of the same size
+     * */
+    void to_dense(Vector& res) const;
+
+    /**
+     * The nonzero entries of a dense vector
+     * */
+    static SparseVector from_dense(const Vector& vec);
+
+    friend std::ostream& operator<<(std::ostream& os, const SparseVector& v) {
+        os << "{ ";
+        v.for_each([&](size_t index, cx_t value) {
+            os << index << ": " << value << ", ";
+        });
+        os << " }";
+        return os;
+    }
+};
+
+}
+}
+
+#endif // __RUNTIME__SPARSE_VECTOR_H__
@@ -0,0 +1,154 @@
+/**
+ * Copyright (c) 2022 Alcides Andrade <andrade.alcides.junior@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "svd.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <numeric>
+
+namespace runtime {
+namespace math {
+
+using dcx_t = std::complex<double>;
+
+static const size_t max_sweeps = 64;
+
+/**
+ * Orthogonalize the columns of the m x n column-major matrix `w`, with m >= n,
+ * accumulating the rotations in the n x n column-major matrix `v`.
+ * */
+static void jacobi(std::vector<dcx_t>& w, std::vector<dcx_t>& v, size_t m, size_t n) {
+    const double eps = 1e-15;
+    for (size_t sweep = 0; sweep < max_sweeps; sweep++) {
+        bool rotated = false;
+        for (size_t p = 0; p + 1 < n; p++) {
+            for (size_t q = p + 1; q < n; q++) {
+                dcx_t* wp = &w[p*m];
+                dcx_t* wq = &w[q*m];
+                double alpha = 0, beta = 0;
+                dcx_t gamma = 0;
+                for (size_t i = 0; i < m; i++) {
+                    alpha += std::norm(wp[i]);
+                    beta += std::norm(wq[i]);
+                    gamma += std::conj(wp[i])*wq[i];
+                }
+                double abs_gamma = std::abs(gamma);
+                if (abs_gamma <= eps*std::sqrt(alpha*beta) || abs_gamma < 1e-300) {
+                    continue;
+                }
+                rotated = true;
+                // rotate the phase of column q so that <w_p|w_q> is real, then
+                // apply the real Jacobi rotation that zeroes it
+                dcx_t phase = gamma/abs_gamma;
+                double zeta = (beta - alpha)/(2*abs_gamma);
+                double t = (zeta >= 0 ? 1. : -1.)/(std::abs(zeta) + std::sqrt(1 + zeta*zeta));
+                double c = 1/std::sqrt(1 + t*t);
+                double s = c*t;
+                auto rotate = [&](dcx_t* x, dcx_t* y, size_t len) {
+                    for (size_t i = 0; i < len; i++) {
+                        dcx_t a = x[i];
+                        dcx_t b = y[i]*std::conj(phase);
+                        x[i] = c*a - s*b;
+                        y[i] = (s*a + c*b)*phase;
+                    }
+                };
+                rotate(wp, wq, m);
+                rotate(&v[p*n], &v[q*n], n);
+            }
+        }
+        if (!rotated) {
+            break;
+        }
+    }
+}
+
+Svd svd(const std::vector<dcx_t>& a, size_t rows, size_t cols) {
+    assert(a.size() == rows*cols);
+    // decompose A^dagger when A is wide, so that the columns are the short side
+    bool wide = cols > rows;
+    size_t m = wide ? cols : rows;
+    size_t n = wide ? rows : cols;
+    std::vector<dcx_t> w(m*n), v(n*n);
+    for (size_t r = 0; r < rows; r++) {
+        for (size_t c = 0; c < cols; c++) {
+            if (wide) {
+                w[r*m + c] = std::conj(a[r*cols + c]);
+            } else {
+                w[c*m + r] = a[r*cols + c];
+            }
+        }
+    }
+    for (size_t i = 0; i < n; i++) {
+        v[i*n + i] = 1;
+    }
+    jacobi(w, v, m, n);
+
+    std::vector<double> norms(n);
+    for (size_t j = 0; j < n; j++) {
+        double norm = 0;
+        for (size_t i = 0; i < m; i++) {
+            norm += std::norm(w[j*m + i]);
+        }
+        norms[j] = std::sqrt(norm);
+    }
+    std::vector<size_t> order(n);
+    std::iota(order.begin(), order.end(), 0);
+    std::sort(order.begin(), order.end(), [&](size_t i, size_t j) {
+        return norms[i] > norms[j];
+    });
+
+    // the columns of W are the left singular vectors scaled by the singular values
+    Svd res;
+    size_t k = n;
+    res.s.resize(k);
+    res.u.resize(rows*k);
+    res.vh.resize(k*cols);
+    for (size_t j = 0; j < k; j++) {
+        size_t col = order[j];
+        double sigma = norms[col];
+        res.s[j] = sigma;
+        double inv = sigma > 0 ? 1/sigma : 0;
+        if (!wide) {
+            // A = (W/S) S V^dagger
+            for (size_t r = 0; r < rows; r++) {
+                res.u[r*k + j] = w[col*m + r]*inv;
+            }
+            for (size_t c = 0; c < cols; c++) {
+                res.vh[j*cols + c] = std::conj(v[col*n + c]);
+            }
+        } else {
+            // A^dagger = (W/S) S V^dagger, so A = V S (W/S)^dagger
+            for (size_t r = 0; r < rows; r++) {
+                res.u[r*k + j] = v[col*n + r];
+            }
+            for (size_t c = 0; c < cols; c++) {
+                res.vh[j*cols + c] = std::conj(w[col*m + c])*inv;
+            }
+        }
+    }
+    return res;
+}
+
+}
+}
@@ -0,0 +1,54 @@
+/**
+ * Copyright (c) 2022 Alcides Andrade <andrade.alcides.junior@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef __RUNTIME__SVD_H__
+#define __RUNTIME__SVD_H__
+
+#include <complex>
+#include <vector>
+
+namespace runtime {
+namespace math {
+
+/**
+ * The singular value decomposition A = U diag(S) V^dagger of a complex matrix
+ * with `rows` rows and `cols` columns. With k = min(rows, cols), `u` is a
+ * rows x k matrix and `vh` a k x cols matrix, both row-major, and the singular
+ * values in `s` are in decreasing order.
+ * */
+struct Svd {
+    std::vector<std::complex<double>> u;
+    std::vector<double> s;
+    std::vector<std::complex<double>> vh;
+};
+
+/**
+ * Decompose the row-major matrix `a` with one-sided Jacobi rotations, which
+ * orthogonalize the columns of A (or of A^dagger when it is wide) pair by pair
+ * and are accurate even for tiny singular values.
+ * */
+Svd svd(const std::vector<std::complex<double>>& a, size_t rows, size_t cols);
+
+}
+}
+
+#endif // __RUNTIME__SVD_H__
@@ -22,6 +22,8 @@
 
 #include "unitary.hpp"
 
+#include <algorithm>
+
 /**
  * Apply a complex matrix to a complex vector.
  * The matrix is assumed to be square and the dimension of the
@@ -52,6 +54,17 @@ void mat_tensor(const runtime::math::Unitary& mat_a,
 
 size_t permute_index(const std::vector<size_t>& permutation, size_t index);
 
+/**
+ * Compute, for every column index `l` of a matrix acting on the qubits `qubits`,
+ * the offset of the corresponding amplitude in the state vector.
+ * */
+static std::vector<size_t> qubit_offsets(const std::vector<size_t>& qubits);
+
+/**
+ * Insert a zero bit in `index` at each of the positions in `sorted_qubits`.
+ * */
+static size_t insert_zero_bits(size_t index, const std::vector<size_t>& sorted_qubits);
+
 namespace runtime {
 namespace math {
 
@@ -85,6 +98,80 @@ Unitary Unitary::operator*(const Unitary& other) const {
     return res;
 }
 
+void Unitary::apply(Vector& target, const std::vector<size_t>& qubits) const {
+    apply(target.ptr(), target.size(), qubits);
+}
+
+void Unitary::apply(cx_t* target, size_t size, const std::vector<size_t>& qubits) const {
+    assert(this->dim() == (size_t(1) << qubits.size()));
+    if (qubits.size() == 1) {
+        size_t stride = size_t(1) << qubits[0];
+        cx_t m00 = (*this)(0, 0), m01 = (*this)(0, 1);
+        cx_t m10 = (*this)(1, 0), m11 = (*this)(1, 1);
+        cx_t* v = target;
+        for (size_t i = 0; i < size; i += 2*stride) {
+            for (size_t j = i; j < i + stride; j++) {
+                cx_t a0 = v[j];
+                cx_t a1 = v[j + stride];
+                v[j] = m00*a0 + m01*a1;
+                v[j + stride] = m10*a0 + m11*a1;
+            }
+        }
+        return;
+    }
+    auto offsets = qubit_offsets(qubits);
+    std::vector<size_t> sorted_qubits(qubits);
+    std::sort(sorted_qubits.begin(), sorted_qubits.end());
+    std::vector<cx_t> in(_dim);
+    size_t blocks = size >> qubits.size();
+    for (size_t b = 0; b < blocks; b++) {
+        size_t base = insert_zero_bits(b, sorted_qubits);
+        for (size_t l = 0; l < _dim; l++) {
+            in[l] = target[base + offsets[l]];
+        }
+        for (size_t r = 0; r < _dim; r++) {
+            cx_t acc = 0;
+            for (size_t l = 0; l < _dim; l++) {
+                acc += (*this)(r, l)*in[l];
+            }
+            target[base + offsets[r]] = acc;
+        }
+    }
+}
+
+std::complex<double> Unitary::matrix_element(const Vector& bra, const Vector& ket,
+                                             const std::vector<size_t>& qubits) const
+{
+    assert(this->dim() == (size_t(1) << qubits.size()));
+    assert(bra.size() == ket.size());
+    auto offsets = qubit_offsets(qubits);
+    std::vector<size_t> sorted_qubits(qubits);
+    std::sort(sorted_qubits.begin(), sorted_qubits.end());
+    std::complex<double> res = 0;
+    size_t blocks = ket.size() >> qubits.size();
+    for (size_t b = 0; b < blocks; b++) {
+        size_t base = insert_zero_bits(b, sorted_qubits);
+        for (size_t r = 0; r < _dim; r++) {
+            cx_t acc = 0;
+            for (size_t l = 0; l < _dim; l++) {
+                acc += (*this)(r, l)*ket[base + offsets[l]];
+            }
+            res += std::conj(bra[base + offsets[r]])*acc;
+        }
+    }
+    return res;
+}
+
+Unitary Unitary::adjoint() const {
+    Unitary res(this->dim());
+    for (size_t i = 0; i < res.dim(); i++) {
+        for (size_t j = 0; j < res.dim(); j++) {
+            res(i, j) = std::conj((*this)(j, i));
+        }
+    }
+    return res;
+}
+
 Unitary Unitary::redimension(const std::vector<size_t>& permutation) {
     size_t dim = std::exp2(permutation.size());
     Unitary id = Unitary::id(dim/this->dim());
@@ -163,3 +250,24 @@ size_t permute_index(const std::vector<size_t>& permutation, size_t index) {
     }
     return new_index;
 }
+
+static std::vector<size_t> qubit_offsets(const std::vector<size_t>& qubits) {
+    size_t k = qubits.size();
+    std::vector<size_t> offsets(size_t(1) << k);
+    for (size_t l = 0; l < offsets.size(); l++) {
+        for (size_t j = 0; j < k; j++) {
+            if ((l >> (k - 1 - j)) & 1) {
+                offsets[l] |= size_t(1) << qubits[j];
+            }
+        }
+    }
+    return offsets;
+}
+
+static size_t insert_zero_bits(size_t index, const std::vector<size_t>& sorted_qubits) {
+    for (auto q : sorted_qubits) {
+        size_t low = index & ((size_t(1) << q) - 1);
+        index = ((index >> q) << (q + 1)) | low;
+    }
+    return index;
+}
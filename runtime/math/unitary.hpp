@@ -145,6 +145,32 @@ public:
 
     Vector operator*(const Vector& target) const;
 
+    /**
+     * Apply the matrix in place to the qubits `qubits` of the state vector `target`.
+     * Qubit `qubits[j]` is the position of a bit in the index of `target` and it
+     * corresponds to bit `qubits.size() - 1 - j` of the row/column index of the
+     * matrix, so for example the controlled not matrix is applied with the
+     * control qubit first and the target qubit second.
+     * */
+    void apply(Vector& target, const std::vector<size_t>& qubits) const;
+
+    /**
+     * Apply the matrix in place to the `size` entries at `target`, as in `apply`
+     * */
+    void apply(cx_t* target, size_t size, const std::vector<size_t>& qubits) const;
+
+    /**
+     * Compute <bra|M|ket>, where M is this matrix acting on the qubits `qubits`
+     * as in `apply`, without modifying or copying either vector.
+     * */
+    std::complex<double> matrix_element(const Vector& bra, const Vector& ket,
+                                        const std::vector<size_t>& qubits) const;
+
+    /**
+     * The conjugate transpose of the matrix
+     * */
+    Unitary adjoint() const;
+
     /**
      * Transform the matrix to a representation on a larger vector space.
      * In the new representation has a larger dimension but it only acts on a subspace
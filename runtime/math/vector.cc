@@ -21,8 +21,10 @@
  */
 
 #include "vector.hpp"
+#include <algorithm>
 #include <cassert>
 #include <random>
+#include <thread>
 
 /**
  * Compute the tensor product of two vectors
@@ -38,8 +40,12 @@ extern "C" void vec_tensor__avx(const void* vec_a, size_t size_vec_a,
 namespace runtime {
 namespace math {
 
+// smallest vector filled by several threads
+static const size_t min_parallel_fill = size_t(1) << 20;
+
 Vector Vector::tensor(const Vector& other) const {
-    Vector res(this->size()*other.size());
+    // every entry of the product is written
+    Vector res(this->size()*other.size(), Uninitialized());
 #ifdef USE_SIMD
     if (__builtin_cpu_supports("avx") && this->size() >= 4) {
         vec_tensor__avx(other.ptr(), other.size(), this->ptr(), this->size(), res.ptr());
@@ -68,7 +74,6 @@ void Vector::reset(size_t offset, size_t size) {
 void Vector::measure(size_t offset, size_t size, std::vector<bool>& res) {
     size_t step = std::exp2l(offset);
     size_t block = std::exp2l(size);
-    size_t r = step*block;
     std::vector<double> prob_measure(block);
     for (size_t i = 0; i < _size; i += step) {
         for (size_t j = i; j < i+step; j++) {
@@ -82,7 +87,7 @@ void Vector::measure(size_t offset, size_t size, std::vector<bool>& res) {
     size_t m = distr(gen);
     for (size_t i = 0; i < _size; i += step) {
         for (size_t j = i; j < i+step; j++) {
-            if (i % r != m) {
+            if ((i/step)%block != m) {
                 _entries[j] = 0;
             }
         }
@@ -110,6 +115,88 @@ void Vector::normalize() {
     }
 }
 
+void Vector::expectation(size_t x_mask, const std::vector<size_t>& z_masks,
+                         std::vector<std::complex<double>>& res) const
+{
+    assert(res.size() == z_masks.size());
+    if (x_mask == 0) {
+        // diagonal strings only need the probabilities of each basis state
+        for (size_t i = 0; i < _size; i++) {
+            double p = std::norm(_entries[i]);
+            for (size_t k = 0; k < z_masks.size(); k++) {
+                double sign = 1 - 2*(__builtin_popcountll(i & z_masks[k]) & 1);
+                res[k] += sign*p;
+            }
+        }
+        return;
+    }
+    for (size_t i = 0; i < _size; i++) {
+        std::complex<double> p = std::conj(_entries[i ^ x_mask])*_entries[i];
+        for (size_t k = 0; k < z_masks.size(); k++) {
+            double sign = 1 - 2*(__builtin_popcountll(i & z_masks[k]) & 1);
+            res[k] += sign*p;
+        }
+    }
+}
+
+void Vector::add_pauli(const Vector& source, size_t x_mask, size_t z_mask, cx_t weight) {
+    assert(source.size() == _size);
+    for (size_t i = 0; i < _size; i++) {
+        float sign = 1 - 2*(__builtin_popcountll(i & z_mask) & 1);
+        _entries[i ^ x_mask] += sign*weight*source[i];
+    }
+}
+
+std::complex<double> Vector::dot(const Vector& other) const {
+    assert(other.size() == _size);
+    std::complex<double> res = 0;
+    for (size_t i = 0; i < _size; i++) {
+        res += std::conj(_entries[i])*other[i];
+    }
+    return res;
+}
+
+void Vector::assign(const Vector& other) {
+    assert(other.size() == _size);
+    std::memcpy(_entries, other.ptr(), _size*sizeof(cx_t));
+}
+
+void Vector::fill(cx_t value) {
+    size_t nr_threads = std::thread::hardware_concurrency();
+    if (_size < min_parallel_fill || nr_threads < 2) {
+        std::fill(_entries, _entries + _size, value);
+        return;
+    }
+    size_t block = (_size + nr_threads - 1)/nr_threads;
+    std::vector<std::thread> threads;
+    for (size_t start = 0; start < _size; start += block) {
+        cx_t* first = _entries + start;
+        cx_t* last = _entries + std::min(_size, start + block);
+        threads.emplace_back([=]() {
+            std::fill(first, last, value);
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+}
+
+Vector Vector::project(size_t qubit, bool value) const {
+    Vector res(_size/2, Uninitialized());
+    size_t low = (size_t(1) << qubit) - 1;
+    size_t bit = size_t(value) << qubit;
+    for (size_t j = 0; j < res._size; j++) {
+        res._entries[j] = _entries[((j & ~low) << 1) | bit | (j & low)];
+    }
+    return res;
+}
+
+Vector Vector::basis(size_t size, size_t index) {
+    Vector res(size);
+    res[index] = 1;
+    return res;
+}
+
 }
 }
 
@@ -43,6 +43,25 @@ private:
     size_t _size { 0 };
     cx_t* _entries { nullptr };
 
+    struct Uninitialized {};
+
+    /**
+     * Allocate the entries without writing them, for vectors that are
+     * overwritten right away
+     * */
+    Vector(size_t size, Uninitialized): _size(size) {
+#ifdef USE_SIMD
+        // allocate at a 32-byte address for use with AVX instructions
+        _entries = static_cast<cx_t*>(aligned_alloc(32, _size*sizeof(cx_t)));
+#else
+        _entries = static_cast<cx_t*>(malloc(_size*sizeof(cx_t)));
+#endif
+        if (!_entries) {
+            std::cout << "failed malloc: " << std::strerror(errno) << "\n";
+            std::exit(EXIT_FAILURE);
+        }
+    }
+
 public:
     Vector() = delete;
     Vector(const Vector&) = delete;
@@ -63,33 +82,11 @@ public:
         v._entries = nullptr;
     }
 
-    Vector(size_t size): _size(size) {
-#ifdef USE_SIMD
-        // allocate at a 32-byte address for use with AVX instructions
-        _entries = static_cast<cx_t*>(aligned_alloc(32, _size*sizeof(cx_t)));
-#else
-        _entries = static_cast<cx_t*>(malloc(_size*sizeof(cx_t)));
-#endif
-        if (!_entries) {
-            std::cout << "failed malloc: " << std::strerror(errno) << "\n";
-            std::exit(EXIT_FAILURE);
-        }
-        for (size_t i = 0; i < size; i++) {
-            _entries[i] = 0.f;
-        }
+    Vector(size_t size): Vector(size, Uninitialized()) {
+        fill(0);
     };
 
-    Vector(std::initializer_list<cx_t> entries): _size(entries.size()) {
-#ifdef USE_SIMD
-        // allocate at a 32-byte address for use with AVX instructions
-        _entries = static_cast<cx_t*>(aligned_alloc(32, _size*sizeof(cx_t)));
-#else
-        _entries = static_cast<cx_t*>(malloc(_size*sizeof(cx_t)));
-#endif
-        if (!_entries) {
-            std::cout << "failed malloc: " << std::strerror(errno) << "\n";
-            std::exit(EXIT_FAILURE);
-        }
+    Vector(std::initializer_list<cx_t> entries): Vector(entries.size(), Uninitialized()) {
         size_t i = 0;
         for (auto& cx : entries) {
             _entries[i++] = cx;
@@ -143,6 +140,50 @@ public:
      * */
     void normalize();
 
+    /**
+     * Evaluate, in a single pass over the vector, the Pauli strings that share the
+     * bit-flip mask `x_mask` and differ only in their phase-flip masks `z_masks`.
+     * For every z mask the value
+     *     sum_i conj(v[i ^ x_mask]) * (-1)^popcount(i & z_mask) * v[i]
+     * is added to the corresponding position of `res`. The vector is not modified.
+     * */
+    void expectation(size_t x_mask, const std::vector<size_t>& z_masks,
+                     std::vector<std::complex<double>>& res) const;
+
+    /**
+     * Add `weight * P * source` to this vector, where P is the Pauli string that
+     * maps the basis state |i> to (-1)^popcount(i & z_mask) |i ^ x_mask>.
+     * */
+    void add_pauli(const Vector& source, size_t x_mask, size_t z_mask, cx_t weight);
+
+    /**
+     * Compute the inner product <this|other>
+     * */
+    std::complex<double> dot(const Vector& other) const;
+
+    /**
+     * Overwrite the entries of this vector with the ones of `other`, which
+     * must have the same size.
+     * */
+    void assign(const Vector& other);
+
+    /**
+     * Set every entry of the vector to `value`. Large vectors are written by
+     * one thread per hardware thread, so that on first touch their pages are
+     * spread over the memory of the threads that work on them.
+     * */
+    void fill(cx_t value);
+
+    /**
+     * The basis state |index> of the given size
+     * */
+    static Vector basis(size_t size, size_t index);
+
+    /**
+     * The vector on one qubit fewer made of the entries whose bit `qubit`
+     * equals `value`, e.g., to drop a qubit that was measured
+     * */
+    Vector project(size_t qubit, bool value) const;
 
     friend std::ostream& operator<<(std::ostream& os, const Vector& v) {
         os << "{ ";
@@ -0,0 +1,384 @@
+/**
+ * Copyright (c) 2022 Alcides Andrade <andrade.alcides.junior@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "matrix_product_state.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+#include "error.hpp"
+#include "gate.hpp"
+#include "math/svd.hpp"
+
+namespace runtime {
+
+MatrixProductState::MatrixProductState(size_t nr_qubits, size_t max_bond_dimension,
+                                       double cutoff):
+    _sites(nr_qubits),
+    _max_bond_dimension(std::max(size_t(1), max_bond_dimension)),
+    _cutoff(cutoff),
+    _generator(std::random_device()())
+{}
+
+/**
+ * The number of singular values to keep: those above `cutoff` relative to the
+ * largest one, and at most `max`. The kept values are rescaled to unit norm
+ * and the discarded weight is added to `error`.
+ * */
+static size_t truncate(std::vector<double>& s, double cutoff, size_t max, double& error) {
+    size_t k = 1;
+    while (k < s.size() && k < max && s[k] > cutoff*s[0]) {
+        k++;
+    }
+    double total = 0, kept = 0;
+    for (size_t j = 0; j < s.size(); j++) {
+        total += s[j]*s[j];
+        if (j < k) {
+            kept += s[j]*s[j];
+        }
+    }
+    if (kept > 0) {
+        error += (total - kept)/total;
+        double scale = 1/std::sqrt(kept);
+        for (size_t j = 0; j < k; j++) {
+            s[j] *= scale;
+        }
+    }
+    return k;
+}
+
+void MatrixProductState::apply(const math::unitary_t& gate, const std::vector<size_t>& qubits) {
+    if (qubits.size() == 1) {
+        apply(Matrix2 { gate(0, 0), gate(0, 1), gate(1, 0), gate(1, 1) }, qubits[0]);
+        return;
+    }
+    if (qubits.size() != 2) {
+        throw Error("matrix product states only apply gates on one or two qubits");
+    }
+    // order the matrix as (lower qubit, higher qubit)
+    bool reversed = qubits[0] > qubits[1];
+    auto order = [&](size_t i) {
+        return reversed ? ((i & 1) << 1) | (i >> 1) : i;
+    };
+    Matrix4 matrix;
+    for (size_t r = 0; r < 4; r++) {
+        for (size_t c = 0; c < 4; c++) {
+            matrix[order(r)*4 + order(c)] = gate(r, c);
+        }
+    }
+    size_t lo = std::min(qubits[0], qubits[1]);
+    size_t hi = std::max(qubits[0], qubits[1]);
+    // bring the higher qubit next to the lower one, and back afterwards
+    for (size_t site = hi - 1; site > lo; site--) {
+        swap(site);
+    }
+    apply(matrix, lo);
+    for (size_t site = lo + 1; site < hi; site++) {
+        swap(site);
+    }
+}
+
+void MatrixProductState::apply(const Operation& operation, const std::vector<double>& parameters) {
+    if (operation.type == Operation::CX) {
+        apply(Gate::cx(), operation.qubits);
+    } else {
+        auto& [theta, phi, lambda] = operation.angles;
+        apply(Gate::u(theta.evaluate(parameters),
+                      phi.evaluate(parameters),
+                      lambda.evaluate(parameters)),
+              operation.qubits);
+    }
+}
+
+void MatrixProductState::apply(const Matrix2& gate, size_t site) {
+    auto& a = _sites[site];
+    for (size_t l = 0; l < a.left; l++) {
+        for (size_t r = 0; r < a.right; r++) {
+            dcx_t& x0 = a.data[(l*2)*a.right + r];
+            dcx_t& x1 = a.data[(l*2 + 1)*a.right + r];
+            dcx_t y0 = gate[0]*x0 + gate[1]*x1;
+            dcx_t y1 = gate[2]*x0 + gate[3]*x1;
+            x0 = y0;
+            x1 = y1;
+        }
+    }
+}
+
+void MatrixProductState::apply(const Matrix4& gate, size_t site) {
+    move_center(site);
+    auto& a = _sites[site];
+    auto& b = _sites[site + 1];
+    size_t L = a.left, M = a.right, R = b.right;
+
+    // theta[l][s1][s2][r] = sum_m A[l][s1][m] B[m][s2][r]
+    std::vector<dcx_t> theta(L*4*R);
+    for (size_t ls = 0; ls < 2*L; ls++) {
+        for (size_t m = 0; m < M; m++) {
+            dcx_t coef = a.data[ls*M + m];
+            if (coef == 0.) {
+                continue;
+            }
+            for (size_t x = 0; x < 2*R; x++) {
+                theta[ls*2*R + x] += coef*b.data[m*2*R + x];
+            }
+        }
+    }
+    // apply the gate to (s1, s2); the result is a (2L) x (2R) matrix
+    std::vector<dcx_t> res(L*4*R);
+    for (size_t l = 0; l < L; l++) {
+        for (size_t t = 0; t < 4; t++) {
+            for (size_t s = 0; s < 4; s++) {
+                dcx_t g = gate[t*4 + s];
+                if (g == 0.) {
+                    continue;
+                }
+                const dcx_t* in = &theta[((l*2 + s/2)*2 + s%2)*R];
+                dcx_t* out = &res[((l*2 + t/2)*2 + t%2)*R];
+                for (size_t r = 0; r < R; r++) {
+                    out[r] += g*in[r];
+                }
+            }
+        }
+    }
+
+    auto svd = math::svd(res, 2*L, 2*R);
+    size_t K = svd.s.size();
+    size_t k = truncate(svd.s, _cutoff, _max_bond_dimension, _truncation_error);
+    a.right = k;
+    a.data.assign(2*L*k, 0);
+    for (size_t row = 0; row < 2*L; row++) {
+        for (size_t j = 0; j < k; j++) {
+            a.data[row*k + j] = svd.u[row*K + j];
+        }
+    }
+    b.left = k;
+    b.data.assign(k*2*R, 0);
+    for (size_t j = 0; j < k; j++) {
+        for (size_t x = 0; x < 2*R; x++) {
+            b.data[j*2*R + x] = svd.s[j]*svd.vh[j*2*R + x];
+        }
+    }
+    _center = site + 1;
+}
+
+void MatrixProductState::swap(size_t site) {
+    static const Matrix4 swap_matrix {
+        1, 0, 0, 0,
+        0, 0, 1, 0,
+        0, 1, 0, 0,
+        0, 0, 0, 1,
+    };
+    apply(swap_matrix, site);
+}
+
+void MatrixProductState::move_center(size_t site) {
+    while (_center < site) {
+        // A = U S V^dagger: keep U and push S V^dagger into the next site
+        auto& a = _sites[_center];
+        auto& b = _sites[_center + 1];
+        size_t L = a.left, M = a.right, R = b.right;
+        auto svd = math::svd(a.data, 2*L, M);
+        size_t K = svd.s.size();
+        size_t k = truncate(svd.s, _cutoff, M, _truncation_error);
+        a.right = k;
+        a.data.assign(2*L*k, 0);
+        for (size_t row = 0; row < 2*L; row++) {
+            for (size_t j = 0; j < k; j++) {
+                a.data[row*k + j] = svd.u[row*K + j];
+            }
+        }
+        std::vector<dcx_t> next(k*2*R);
+        for (size_t j = 0; j < k; j++) {
+            for (size_t m = 0; m < M; m++) {
+                dcx_t coef = svd.s[j]*svd.vh[j*M + m];
+                for (size_t x = 0; x < 2*R; x++) {
+                    next[j*2*R + x] += coef*b.data[m*2*R + x];
+                }
+            }
+        }
+        b.left = k;
+        b.data = std::move(next);
+        _center++;
+    }
+    while (_center > site) {
+        // A = U S V^dagger: keep V^dagger and push U S into the previous site
+        auto& a = _sites[_center];
+        auto& b = _sites[_center - 1];
+        size_t L = a.left, R = a.right, P = b.left;
+        auto svd = math::svd(a.data, L, 2*R);
+        size_t K = svd.s.size();
+        size_t k = truncate(svd.s, _cutoff, L, _truncation_error);
+        a.left = k;
+        a.data.assign(svd.vh.begin(), svd.vh.begin() + k*2*R);
+        std::vector<dcx_t> prev(2*P*k);
+        for (size_t row = 0; row < 2*P; row++) {
+            for (size_t m = 0; m < L; m++) {
+                dcx_t coef = b.data[row*L + m];
+                if (coef == 0.) {
+                    continue;
+                }
+                for (size_t j = 0; j < k; j++) {
+                    prev[row*k + j] += coef*svd.u[m*K + j]*svd.s[j];
+                }
+            }
+        }
+        b.right = k;
+        b.data = std::move(prev);
+        _center--;
+    }
+}
+
+bool MatrixProductState::measure(size_t qubit) {
+    move_center(qubit);
+    auto& a = _sites[qubit];
+    double p[2] = { 0, 0 };
+    for (size_t l = 0; l < a.left; l++) {
+        for (size_t s = 0; s < 2; s++) {
+            for (size_t r = 0; r < a.right; r++) {
+                p[s] += std::norm(a.data[(l*2 + s)*a.right + r]);
+            }
+        }
+    }
+    std::uniform_real_distribution<double> uniform(0, p[0] + p[1]);
+    bool outcome = uniform(_generator) < p[1];
+    double scale = 1/std::sqrt(p[outcome]);
+    for (size_t l = 0; l < a.left; l++) {
+        for (size_t s = 0; s < 2; s++) {
+            for (size_t r = 0; r < a.right; r++) {
+                auto& x = a.data[(l*2 + s)*a.right + r];
+                x = s == outcome ? x*scale : 0.;
+            }
+        }
+    }
+    return outcome;
+}
+
+void MatrixProductState::reset(size_t qubit) {
+    if (measure(qubit)) {
+        apply(Matrix2 { 0, 1, 1, 0 }, qubit);
+    }
+}
+
+std::complex<double> MatrixProductState::amplitude(const std::vector<bool>& bits) const {
+    std::vector<dcx_t> v { 1 };
+    for (size_t k = 0; k < _sites.size(); k++) {
+        auto& a = _sites[k];
+        std::vector<dcx_t> next(a.right);
+        for (size_t l = 0; l < a.left; l++) {
+            for (size_t r = 0; r < a.right; r++) {
+                next[r] += v[l]*a.data[(l*2 + bits[k])*a.right + r];
+            }
+        }
+        v = std::move(next);
+    }
+    return v[0];
+}
+
+std::complex<double> MatrixProductState::contract(const std::vector<const Matrix2*>& ops) const {
+    // e[l][l'] is the contraction of the sites to the left of the bond
+    std::vector<dcx_t> e { 1 };
+    for (size_t k = 0; k < _sites.size(); k++) {
+        auto& a = _sites[k];
+        size_t L = a.left, R = a.right;
+        const std::vector<dcx_t>* ket = &a.data;
+        std::vector<dcx_t> applied;
+        if (ops[k] != nullptr) {
+            auto& op = *ops[k];
+            applied.resize(a.data.size());
+            for (size_t l = 0; l < L; l++) {
+                for (size_t r = 0; r < R; r++) {
+                    dcx_t x0 = a.data[(l*2)*R + r], x1 = a.data[(l*2 + 1)*R + r];
+                    applied[(l*2)*R + r] = op[0]*x0 + op[1]*x1;
+                    applied[(l*2 + 1)*R + r] = op[2]*x0 + op[3]*x1;
+                }
+            }
+            ket = &applied;
+        }
+        // t[l][s][r'] = sum_l' e[l][l'] ket[l'][s][r']
+        std::vector<dcx_t> t(L*2*R);
+        for (size_t l = 0; l < L; l++) {
+            for (size_t lp = 0; lp < L; lp++) {
+                dcx_t coef = e[l*L + lp];
+                if (coef == 0.) {
+                    continue;
+                }
+                for (size_t x = 0; x < 2*R; x++) {
+                    t[l*2*R + x] += coef*(*ket)[lp*2*R + x];
+                }
+            }
+        }
+        // e'[r][r'] = sum_{l, s} conj(bra[l][s][r]) t[l][s][r']
+        std::vector<dcx_t> next(R*R);
+        for (size_t ls = 0; ls < 2*L; ls++) {
+            for (size_t r = 0; r < R; r++) {
+                dcx_t coef = std::conj(a.data[ls*R + r]);
+                if (coef == 0.) {
+                    continue;
+                }
+                for (size_t rp = 0; rp < R; rp++) {
+                    next[r*R + rp] += coef*t[ls*R + rp];
+                }
+            }
+        }
+        e = std::move(next);
+    }
+    return e[0];
+}
+
+double MatrixProductState::expectation(
+    const Observable& observable,
+    const std::map<std::string, std::tuple<size_t, size_t>>& qregs) const
+{
+    using namespace std::complex_literals;
+    static const Matrix2 x { 0., 1., 1., 0. };
+    static const Matrix2 y { 0., -1i, 1i, 0. };
+    static const Matrix2 z { 1., 0., 0., -1. };
+    std::vector<const Matrix2*> ops(_sites.size(), nullptr);
+    double norm = contract(ops).real();
+    double res = 0;
+    for (auto& term : observable.terms()) {
+        std::fill(ops.begin(), ops.end(), nullptr);
+        for (auto& pauli : term.paulis) {
+            ops[Observable::qubit(pauli, qregs)] = pauli.op == 'X' ? &x : pauli.op == 'Y' ? &y : &z;
+        }
+        res += term.coefficient*contract(ops).real()/norm;
+    }
+    return res;
+}
+
+size_t MatrixProductState::bond_dimension() const {
+    size_t res = 1;
+    for (auto& site : _sites) {
+        res = std::max(res, site.right);
+    }
+    return res;
+}
+
+size_t MatrixProductState::size() const {
+    size_t res = 0;
+    for (auto& site : _sites) {
+        res += site.data.size();
+    }
+    return res;
+}
+
+}
@@ -0,0 +1,159 @@
+/**
+ * Copyright (c) 2022 Alcides Andrade <andrade.alcides.junior@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef __RUNTIME__MATRIX_PRODUCT_STATE_H__
+#define __RUNTIME__MATRIX_PRODUCT_STATE_H__
+
+#include <array>
+#include <complex>
+#include <map>
+#include <random>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include "circuit.hpp"
+#include "math/unitary.hpp"
+#include "observable.hpp"
+
+namespace runtime {
+
+/**
+ * A state of n qubits kept as a matrix product state
+ *     psi(s_0, ..., s_{n-1}) = A_0[s_0] A_1[s_1] ... A_{n-1}[s_{n-1}]
+ * where the site k holds the qubit k and A_k[s] is a matrix whose dimensions
+ * are the bonds to the neighbouring sites. Memory scales as n*chi^2 for a
+ * maximum bond dimension chi instead of 2^n.
+ *
+ * The state is kept in mixed canonical form around an orthogonality center.
+ * Two-qubit gates contract the two sites, apply the gate and split them again
+ * with an SVD, keeping at most `max_bond_dimension` singular values. Gates on
+ * non-adjacent qubits are applied by swapping one of the qubits next to the
+ * other and back. The weight of the discarded singular values is accumulated
+ * in `truncation_error`.
+ * */
+class MatrixProductState {
+public:
+    MatrixProductState(size_t nr_qubits, size_t max_bond_dimension, double cutoff = 1e-12);
+
+    inline size_t nr_qubits() const {
+        return _sites.size();
+    }
+
+    /**
+     * Apply a 2x2 or 4x4 matrix with the qubit order of `math::Unitary::apply`
+     * */
+    void apply(const math::unitary_t& gate, const std::vector<size_t>& qubits);
+
+    /**
+     * Apply a U or CX operation of a circuit
+     * */
+    void apply(const Operation& operation, const std::vector<double>& parameters);
+
+    /**
+     * Measure the qubit `qubit` in the computational basis, collapsing the
+     * state, and return the outcome.
+     * */
+    bool measure(size_t qubit);
+
+    /**
+     * Set the qubit `qubit` to |0>
+     * */
+    void reset(size_t qubit);
+
+    /**
+     * The amplitude of the basis state whose bit k is the value of the qubit k
+     * */
+    std::complex<double> amplitude(const std::vector<bool>& bits) const;
+
+    /**
+     * The expectation value of the observable. `qregs` has the same layout
+     * as the one kept by `State`.
+     * */
+    double expectation(const Observable& observable,
+                       const std::map<std::string, std::tuple<size_t, size_t>>& qregs) const;
+
+    /**
+     * The sum over all the truncations of the discarded weight, i.e., of the
+     * squares of the discarded singular values relative to the kept ones.
+     * It bounds 1 - fidelity to first order.
+     * */
+    inline double truncation_error() const {
+        return _truncation_error;
+    }
+
+    /**
+     * The largest bond dimension currently in the state
+     * */
+    size_t bond_dimension() const;
+
+    /**
+     * The number of complex entries held by all the sites
+     * */
+    size_t size() const;
+
+private:
+    using dcx_t = std::complex<double>;
+    using Matrix2 = std::array<dcx_t, 4>;
+    using Matrix4 = std::array<dcx_t, 16>;
+
+    /**
+     * The tensor A[l][s][r] of a site, stored at (l*2 + s)*right + r
+     * */
+    struct Site {
+        size_t left { 1 };
+        size_t right { 1 };
+        std::vector<dcx_t> data { 1, 0 };
+    };
+
+    std::vector<Site> _sites;
+    size_t _max_bond_dimension;
+    double _cutoff;
+    size_t _center { 0 };
+    double _truncation_error { 0 };
+    std::mt19937_64 _generator;
+
+    void apply(const Matrix2& gate, size_t site);
+
+    /**
+     * Apply a 4x4 matrix to the sites `site` and `site + 1`, where the row
+     * index of the matrix is 2*s_site + s_{site + 1}.
+     * */
+    void apply(const Matrix4& gate, size_t site);
+
+    void swap(size_t site);
+
+    /**
+     * Move the orthogonality center to `site`
+     * */
+    void move_center(size_t site);
+
+    /**
+     * Contract the state with itself, inserting the 2x2 matrix `ops[k]` at every
+     * site k, or the identity where it is null.
+     * */
+    dcx_t contract(const std::vector<const Matrix2*>& ops) const;
+};
+
+}
+
+#endif // __RUNTIME__MATRIX_PRODUCT_STATE_H__
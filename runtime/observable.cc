@@ -0,0 +1,103 @@
+/**
+ * Copyright (c) 2022 Alcides Andrade <andrade.alcides.junior@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "observable.hpp"
+
+#include "error.hpp"
+
+namespace runtime {
+
+using namespace std::complex_literals;
+
+void Observable::add_term(float coefficient, std::vector<Pauli> paulis) {
+    for (auto& pauli : paulis) {
+        if (pauli.op != 'X' && pauli.op != 'Y' && pauli.op != 'Z') {
+            throw Error(std::string("invalid Pauli operator `") + pauli.op + "`");
+        }
+    }
+    _terms.push_back({ coefficient, std::move(paulis) });
+}
+
+size_t Observable::qubit(const Pauli& pauli,
+                         const std::map<std::string, std::tuple<size_t, size_t>>& qregs)
+{
+    auto qreg = qregs.find(pauli.qreg);
+    if (qreg == qregs.end()) {
+        throw Error("undefined quantum register `" + pauli.qreg + "`");
+    }
+    auto [offset, size] = qreg->second;
+    if (pauli.index >= size) {
+        throw Error("index " + std::to_string(pauli.index) +
+                    " is out of bounds for quantum register `" + pauli.qreg + "`");
+    }
+    return offset + pauli.index;
+}
+
+std::vector<Observable::Mask> Observable::resolve(
+    const std::map<std::string, std::tuple<size_t, size_t>>& qregs) const
+{
+    std::vector<Mask> masks;
+    for (auto& term : _terms) {
+        size_t x_mask = 0;
+        size_t z_mask = 0;
+        size_t nr_y = 0;
+        for (auto& pauli : term.paulis) {
+            size_t bit = size_t(1) << qubit(pauli, qregs);
+            if ((x_mask | z_mask) & bit) {
+                throw Error("qubit " + pauli.qreg + "[" + std::to_string(pauli.index) +
+                            "] appears more than once in a Pauli string");
+            }
+            if (pauli.op == 'X' || pauli.op == 'Y') {
+                x_mask |= bit;
+            }
+            if (pauli.op == 'Z' || pauli.op == 'Y') {
+                z_mask |= bit;
+            }
+            if (pauli.op == 'Y') {
+                nr_y++;
+            }
+        }
+        // Y|b> = i(-1)^b |1-b>, so each Y contributes a factor of i
+        static const std::complex<double> i_pow[] = { 1., 1i, -1., -1i };
+        masks.push_back({ x_mask, z_mask, double(term.coefficient)*i_pow[nr_y % 4] });
+    }
+    return masks;
+}
+
+std::vector<Observable::Group> Observable::group(
+    const std::map<std::string, std::tuple<size_t, size_t>>& qregs) const
+{
+    std::map<size_t, Group> groups;
+    for (auto& mask : resolve(qregs)) {
+        auto& group = groups[mask.x_mask];
+        group.x_mask = mask.x_mask;
+        group.z_masks.push_back(mask.z_mask);
+        group.weights.push_back(mask.weight);
+    }
+    std::vector<Group> res;
+    for (auto& [_, group] : groups) {
+        res.push_back(std::move(group));
+    }
+    return res;
+}
+
+}
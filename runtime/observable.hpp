@@ -0,0 +1,115 @@
+/**
+ * Copyright (c) 2022 Alcides Andrade <andrade.alcides.junior@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef __RUNTIME__OBSERVABLE_H__
+#define __RUNTIME__OBSERVABLE_H__
+
+#include <map>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include "math/types.hpp"
+
+namespace runtime {
+
+/**
+ * A weighted sum of Pauli strings
+ *     O = c_0 P_0 + c_1 P_1 + ...
+ * where each Pauli string P_k is a tensor product of the Pauli matrices
+ * X, Y and Z acting on qubits of named quantum registers (the identity
+ * is implied on every other qubit).
+ * */
+class Observable {
+public:
+    /**
+     * A single Pauli matrix, one of 'X', 'Y' or 'Z', acting on
+     * the qubit `qreg[index]`.
+     * */
+    struct Pauli {
+        char op;
+        std::string qreg;
+        size_t index;
+    };
+
+    struct Term {
+        float coefficient;
+        std::vector<Pauli> paulis;
+    };
+
+    /**
+     * A Pauli string resolved against the position of the qubits in the state vector.
+     * Applying the string to a basis state gives
+     *     P|i> = weight * (-1)^popcount(i & z_mask) |i ^ x_mask>
+     * where `weight` absorbs the coefficient of the term and the factor i
+     * contributed by each Y.
+     * */
+    struct Mask {
+        size_t x_mask;
+        size_t z_mask;
+        std::complex<double> weight;
+    };
+
+    /**
+     * Add the term `coefficient * paulis` to the observable.
+     * */
+    void add_term(float coefficient, std::vector<Pauli> paulis);
+
+    inline const std::vector<Term>& terms() const {
+        return _terms;
+    }
+
+    /**
+     * The position of the qubit of `pauli` in the state, using the register map
+     * `qregs`, which has the same layout as the one kept by `State`.
+     * */
+    static size_t qubit(const Pauli& pauli,
+                        const std::map<std::string, std::tuple<size_t, size_t>>& qregs);
+
+    /**
+     * Compute the bit masks of each term using the register map `qregs`,
+     * which has the same layout as the one kept by `State`.
+     * */
+    std::vector<Mask> resolve(const std::map<std::string, std::tuple<size_t, size_t>>& qregs) const;
+
+    /**
+     * Pauli strings that flip the same qubits, which can be evaluated together
+     * in a single pass over the state vector.
+     * */
+    struct Group {
+        size_t x_mask;
+        std::vector<size_t> z_masks;
+        std::vector<std::complex<double>> weights;
+    };
+
+    /**
+     * Resolve the terms as in `resolve` and group them by their bit-flip mask
+     * */
+    std::vector<Group> group(const std::map<std::string, std::tuple<size_t, size_t>>& qregs) const;
+
+private:
+    std::vector<Term> _terms;
+};
+
+}
+
+#endif // __RUNTIME__OBSERVABLE_H__
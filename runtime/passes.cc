@@ -0,0 +1,318 @@
+/**
+ * Copyright (c) 2022 Alcides Andrade <andrade.alcides.junior@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "passes.hpp"
+
+#include <algorithm>
+#include <set>
+#include <string>
+
+#include "error.hpp"
+
+namespace runtime {
+
+static const size_t none = ~size_t(0);
+
+Circuit recycle_qubits(const Circuit& circuit, RecyclingStats* stats) {
+    auto& operations = circuit.operations;
+    size_t n = circuit.nr_qubits;
+
+    // segment of every qubit used by every operation, where the unconditional
+    // resets are dropped and only end the segment of their qubit
+    struct Segment {
+        size_t first;
+        size_t last;
+        size_t physical { none };
+    };
+    std::vector<Segment> segments;
+    std::vector<std::vector<size_t>> segments_of(n);
+    std::vector<size_t> open(n, none);
+    std::vector<std::vector<size_t>> uses(operations.size());
+    for (size_t i = 0; i < operations.size(); i++) {
+        auto& operation = operations[i];
+        if (operation.type == Operation::Reset && !operation.condition.has_value()) {
+            open[operation.qubits[0]] = none;
+            continue;
+        }
+        for (auto qubit : operation.qubits) {
+            if (operation.type == Operation::Barrier) {
+                // a barrier neither starts nor extends the life of a qubit
+                uses[i].push_back(open[qubit]);
+                continue;
+            }
+            if (open[qubit] == none) {
+                open[qubit] = segments.size();
+                segments_of[qubit].push_back(segments.size());
+                segments.push_back({ i, i });
+            }
+            segments[open[qubit]].last = i;
+            uses[i].push_back(open[qubit]);
+        }
+    }
+
+    // linear scan over the operations, with the free physical qubits kept
+    // sorted so that the lowest ones are reused first
+    std::vector<std::vector<size_t>> starting(operations.size());
+    std::vector<std::vector<size_t>> ending(operations.size());
+    for (size_t s = 0; s < segments.size(); s++) {
+        starting[segments[s].first].push_back(s);
+        ending[segments[s].last].push_back(s);
+    }
+    std::set<size_t> free;
+    std::vector<bool> used;
+    size_t nr_resets = 0;
+
+    Circuit res;
+    res.classical_registers = circuit.classical_registers;
+    res.parameters = circuit.parameters;
+    // position in the new circuit of every old operation
+    std::vector<size_t> position(operations.size(), none);
+    for (size_t i = 0; i < operations.size(); i++) {
+        for (auto s : starting[i]) {
+            size_t physical;
+            if (free.empty()) {
+                physical = used.size();
+                used.push_back(false);
+            } else {
+                physical = *free.begin();
+                free.erase(free.begin());
+            }
+            segments[s].physical = physical;
+            if (used[physical]) {
+                Operation reset;
+                reset.type = Operation::Reset;
+                reset.qubits = { physical };
+                reset.line = operations[i].line;
+                res.operations.push_back(std::move(reset));
+                nr_resets++;
+            }
+            used[physical] = true;
+        }
+        auto& operation = operations[i];
+        if (!(operation.type == Operation::Reset && !operation.condition.has_value())) {
+            Operation mapped = operation;
+            mapped.qubits.clear();
+            for (auto s : uses[i]) {
+                // a barrier only separates the qubits that are used after it
+                if (s == none || segments[s].last < i) {
+                    continue;
+                }
+                size_t physical = segments[s].physical;
+                if (std::find(mapped.qubits.begin(), mapped.qubits.end(), physical)
+                    == mapped.qubits.end()) {
+                    mapped.qubits.push_back(physical);
+                }
+            }
+            if (!mapped.qubits.empty()) {
+                position[i] = res.operations.size();
+                res.operations.push_back(std::move(mapped));
+            }
+        }
+        for (auto s : ending[i]) {
+            free.insert(segments[s].physical);
+        }
+    }
+    res.nr_qubits = std::max<size_t>(used.size(), 1);
+    res.quantum_registers["recycled"] = { 0, res.nr_qubits };
+
+    // the gates of the program keep the qubits of their last operation
+    for (auto& application : circuit.applications) {
+        size_t last = application.last;
+        while (last > 0 && position[last] == none) {
+            last--;
+        }
+        if (position[last] == none) {
+            continue;
+        }
+        GateApplication mapped = { application.name, {}, position[last] };
+        for (auto qubit : application.qubits) {
+            // the latest segment of the qubit started by the last operation
+            size_t physical = none;
+            for (auto s : segments_of[qubit]) {
+                if (segments[s].first <= application.last) {
+                    physical = segments[s].physical;
+                }
+            }
+            if (physical != none) {
+                mapped.qubits.push_back(physical);
+            }
+        }
+        res.applications.push_back(std::move(mapped));
+    }
+
+    if (stats) {
+        stats->nr_qubits_before = n;
+        stats->nr_qubits_after = res.nr_qubits;
+        stats->nr_resets_inserted = nr_resets;
+    }
+    return res;
+}
+
+Circuit prune_light_cone(const Circuit& circuit, PruningStats* stats) {
+    return prune_light_cone(circuit, {}, stats);
+}
+
+Circuit prune_light_cone(const Circuit& circuit, const std::vector<std::string>& observed,
+                         PruningStats* stats) {
+    auto& operations = circuit.operations;
+    std::set<std::string> needed;
+    for (auto& name : observed) {
+        if (circuit.classical_registers.find(name) == circuit.classical_registers.end()) {
+            throw Error("unknown classical register " + name);
+        }
+        needed.insert(name);
+    }
+    if (observed.empty()) {
+        for (auto& [name, size] : circuit.classical_registers) {
+            needed.insert(name);
+        }
+    }
+
+    std::vector<bool> live(circuit.nr_qubits, false);
+    std::vector<bool> kept_qubits(circuit.nr_qubits, false);
+    std::vector<bool> kept(operations.size(), false);
+    for (size_t i = operations.size(); i-- > 0;) {
+        auto& operation = operations[i];
+        auto& qubits = operation.qubits;
+        switch (operation.type) {
+        case Operation::U:
+            kept[i] = live[qubits[0]];
+            break;
+        case Operation::CX:
+            kept[i] = live[qubits[0]] || live[qubits[1]];
+            if (kept[i]) {
+                live[qubits[0]] = live[qubits[1]] = true;
+            }
+            break;
+        case Operation::Measure:
+            kept[i] = live[qubits[0]] || needed.count(operation.creg) > 0;
+            live[qubits[0]] = live[qubits[0]] || kept[i];
+            break;
+        case Operation::Reset:
+            kept[i] = live[qubits[0]];
+            if (kept[i] && !operation.condition.has_value()) {
+                // the earlier state of the qubit cannot be observed anymore
+                live[qubits[0]] = false;
+                kept_qubits[qubits[0]] = true;
+            }
+            break;
+        case Operation::Barrier:
+            break;
+        }
+        if (kept[i] && operation.condition.has_value()) {
+            needed.insert(operation.condition->first);
+        }
+        for (auto qubit : qubits) {
+            kept_qubits[qubit] = kept_qubits[qubit] || live[qubit];
+        }
+    }
+
+    // the kept qubits are renumbered in order
+    std::vector<size_t> index(circuit.nr_qubits, none);
+    size_t nr_qubits = 0;
+    for (size_t qubit = 0; qubit < circuit.nr_qubits; qubit++) {
+        if (kept_qubits[qubit]) {
+            index[qubit] = nr_qubits++;
+        }
+    }
+
+    Circuit res;
+    res.nr_qubits = nr_qubits;
+    res.classical_registers = circuit.classical_registers;
+    res.parameters = circuit.parameters;
+    for (auto& [name, layout] : circuit.quantum_registers) {
+        auto [offset, size] = layout;
+        size_t first = none;
+        size_t count = 0;
+        for (size_t qubit = offset; qubit < offset + size; qubit++) {
+            if (kept_qubits[qubit]) {
+                first = std::min(first, index[qubit]);
+                count++;
+            }
+        }
+        if (count > 0) {
+            res.quantum_registers[name] = { first, count };
+        }
+    }
+
+    // a barrier is kept on the kept qubits it separates
+    std::vector<size_t> position(operations.size(), none);
+    for (size_t i = 0; i < operations.size(); i++) {
+        auto& operation = operations[i];
+        if (!kept[i] && operation.type != Operation::Barrier) {
+            continue;
+        }
+        Operation mapped = operation;
+        mapped.qubits.clear();
+        for (auto qubit : operation.qubits) {
+            if (index[qubit] != none) {
+                mapped.qubits.push_back(index[qubit]);
+            }
+        }
+        if (mapped.qubits.empty()) {
+            continue;
+        }
+        position[i] = res.operations.size();
+        res.operations.push_back(std::move(mapped));
+    }
+
+    // a gate of the program is kept with its last kept operation, if any
+    size_t first = 0;
+    for (auto& application : circuit.applications) {
+        size_t last = application.last + 1;
+        while (last > first && position[last - 1] == none) {
+            last--;
+        }
+        if (last > first) {
+            GateApplication mapped = { application.name, {}, position[last - 1] };
+            for (auto qubit : application.qubits) {
+                if (index[qubit] != none) {
+                    mapped.qubits.push_back(index[qubit]);
+                }
+            }
+            res.applications.push_back(std::move(mapped));
+        }
+        first = application.last + 1;
+    }
+
+    if (stats) {
+        auto nr_gates = [](const Circuit& circuit) {
+            return std::count_if(circuit.operations.begin(), circuit.operations.end(),
+                                 [](auto& operation) {
+                return operation.type == Operation::U || operation.type == Operation::CX;
+            });
+        };
+        stats->nr_qubits_before = circuit.nr_qubits;
+        stats->nr_qubits_after = res.nr_qubits;
+        stats->nr_gates_before = nr_gates(circuit);
+        stats->nr_gates_after = nr_gates(res);
+    }
+    return res;
+}
+
+std::ostream& operator<<(std::ostream& os, const PruningStats& stats) {
+    return os << "light cone: " << stats.nr_qubits_before << " qubits, " << stats.nr_gates_before
+              << " gates -> " << stats.nr_qubits_after << " qubits, " << stats.nr_gates_after
+              << " gates\n";
+}
+
+}
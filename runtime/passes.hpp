@@ -0,0 +1,91 @@
+/**
+ * Copyright (c) 2022 Alcides Andrade <andrade.alcides.junior@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef __RUNTIME__PASSES_H__
+#define __RUNTIME__PASSES_H__
+
+#include <cstddef>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "circuit.hpp"
+
+namespace runtime {
+
+struct RecyclingStats {
+    size_t nr_qubits_before { 0 };
+    size_t nr_qubits_after { 0 };
+    size_t nr_resets_inserted { 0 };
+};
+
+/**
+ * Map qubits with disjoint lifetimes onto the same qubit of the state.
+ *
+ * An unconditional reset ends the lifetime of the value held by a qubit, so
+ * the uses of a qubit are split at its resets into segments, each one lasting
+ * from its first to its last operation. The segments are assigned to physical
+ * qubits greedily in the order in which they start, which uses as many
+ * physical qubits as there are segments alive at the same time. A physical
+ * qubit that held a segment before is reset when the next one starts; this
+ * does not change the distribution of the measurements since the previous
+ * segment is not used anymore. Barriers do not extend the segments, and only
+ * keep the physical qubits whose segment goes on after them.
+ *
+ * The resulting circuit has a single quantum register `recycled`, so the
+ * classical registers are the only meaningful result of a run.
+ * */
+Circuit recycle_qubits(const Circuit& circuit, RecyclingStats* stats = nullptr);
+
+struct PruningStats {
+    size_t nr_qubits_before { 0 };
+    size_t nr_qubits_after { 0 };
+    // U and CX operations
+    size_t nr_gates_before { 0 };
+    size_t nr_gates_after { 0 };
+};
+
+/**
+ * Remove the operations outside of the backward light cone of the observed
+ * classical registers, i.e., those that cannot change their distribution.
+ *
+ * The circuit is walked backwards from the end with the set of live qubits,
+ * whose state can still reach a kept measure, and the set of needed classical
+ * registers, the observed ones and those tested by the condition of a kept
+ * operation. A gate is kept if it acts on a live qubit, and a CX makes both of
+ * its qubits live. A measure is kept if it writes a needed register or if its
+ * qubit is live, since the collapse matters to the gates that follow. An
+ * unconditional reset of a live qubit ends its light cone.
+ *
+ * The qubits never live are removed; each quantum register keeps its qubits
+ * that remain, in order, and the registers left empty are removed. Without
+ * observed registers all the classical registers are observed.
+ * */
+Circuit prune_light_cone(const Circuit& circuit, PruningStats* stats = nullptr);
+Circuit prune_light_cone(const Circuit& circuit, const std::vector<std::string>& observed,
+                         PruningStats* stats = nullptr);
+
+std::ostream& operator<<(std::ostream& os, const PruningStats& stats);
+
+}
+
+#endif // __RUNTIME__PASSES_H__
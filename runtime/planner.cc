@@ -0,0 +1,204 @@
+/**
+ * Copyright (c) 2022 Alcides Andrade <andrade.alcides.junior@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "planner.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
+
+#include "bit_sliced.hpp"
+#include "small_circuit.hpp"
+#include "tableau.hpp"
+
+namespace runtime {
+
+std::string to_string(Backend backend) {
+    switch (backend) {
+    case Backend::Automatic:          return "automatic";
+    case Backend::StateVector:        return "state vector";
+    case Backend::Stabilizer:         return "stabilizer";
+    case Backend::MatrixProductState: return "matrix product state";
+    case Backend::DecisionDiagram:    return "decision diagram";
+    case Backend::BitSliced:          return "bit-sliced";
+    case Backend::Unitary:            return "unitary";
+    case Backend::OutOfCore:          return "out-of-core state vector";
+    }
+    return "";
+}
+
+CircuitStats analyze(const Circuit& circuit) {
+    CircuitStats stats;
+    size_t n = circuit.nr_qubits;
+    stats.width = n;
+    stats.clifford = Tableau::supports(circuit);
+    stats.permutation = BitSliced::supports(circuit);
+    std::vector<size_t> depth(n);
+    std::vector<bool> measured(n);
+    // number of two-qubit gates across the cut between the qubits i and i + 1
+    std::vector<size_t> crossings(n);
+    for (auto& operation : circuit.operations) {
+        if (operation.type == Operation::Barrier) {
+            continue;
+        }
+        stats.nr_conditions += operation.condition.has_value();
+        size_t layer = 0;
+        for (auto q : operation.qubits) {
+            layer = std::max(layer, depth[q] + 1);
+        }
+        for (auto q : operation.qubits) {
+            depth[q] = layer;
+        }
+        stats.depth = std::max(stats.depth, layer);
+        switch (operation.type) {
+        case Operation::CX: {
+            size_t a = std::min(operation.qubits[0], operation.qubits[1]);
+            size_t b = std::max(operation.qubits[0], operation.qubits[1]);
+            stats.nr_two_qubit_gates++;
+            stats.max_distance = std::max(stats.max_distance, b - a);
+            stats.total_distance += b - a;
+            for (size_t cut = a; cut < b; cut++) {
+                crossings[cut]++;
+            }
+            [[fallthrough]];
+        }
+        case Operation::U:
+            stats.nr_gates++;
+            for (auto q : operation.qubits) {
+                stats.mid_circuit_measurements = stats.mid_circuit_measurements || measured[q];
+            }
+            break;
+        case Operation::Measure:
+            stats.nr_measurements++;
+            measured[operation.qubits[0]] = true;
+            break;
+        case Operation::Reset:
+            stats.nr_resets++;
+            measured[operation.qubits[0]] = true;
+            break;
+        case Operation::Barrier:
+            break;
+        }
+    }
+    for (size_t cut = 0; cut + 1 < n; cut++) {
+        // the cut can not carry more entanglement than its smaller side
+        size_t bound = std::min({ crossings[cut], cut + 1, n - cut - 1 });
+        stats.max_crossings = std::max(stats.max_crossings, bound);
+    }
+    return stats;
+}
+
+static std::vector<Estimate> estimate(const CircuitStats& stats, const Options& options) {
+    auto& cost = options.cost_model;
+    double n = stats.width;
+    double nr_operations = stats.nr_gates + stats.nr_measurements + stats.nr_resets;
+    std::vector<Estimate> res;
+
+    double amplitudes = std::exp2(n);
+    res.push_back({ Backend::StateVector, stats.width <= options.max_state_vector_qubits, true,
+                    nr_operations*amplitudes*cost.state_vector_amplitude,
+                    amplitudes*sizeof(math::cx_t) });
+
+    // a gate updates every row and a measurement multiplies rows of n/64 words
+    double rows = 2*n + 1;
+    double words = std::ceil(n/64);
+    res.push_back({ Backend::Stabilizer, stats.clifford, true,
+                    (stats.nr_gates*rows +
+                     (stats.nr_measurements + stats.nr_resets)*rows*2*words)*cost.tableau_word,
+                    rows*(2*words*sizeof(uint64_t) + 1) });
+
+    // the bond dimension that keeps the state exact, and the one that is kept;
+    // gates between distant qubits are moved next to each other by swaps
+    double needed = std::exp2(std::min<size_t>(stats.max_crossings, 60));
+    double bond = std::min<double>(needed, options.max_bond_dimension);
+    double nr_swaps = 2*(stats.total_distance - stats.nr_two_qubit_gates);
+    res.push_back({ Backend::MatrixProductState, true, needed <= options.max_bond_dimension,
+                    (nr_operations + nr_swaps)*(cost.mps_overhead + bond*bond*bond*cost.mps_bond_cube),
+                    n*2*bond*bond*sizeof(std::complex<double>) });
+
+    res.push_back({ Backend::BitSliced, stats.permutation, true,
+                    nr_operations*cost.bit_sliced_gate, 2*n*sizeof(uint64_t) });
+    return res;
+}
+
+Plan plan(const Circuit& circuit, const Options& options) {
+    Plan res;
+    res.stats = analyze(circuit);
+    res.estimates = estimate(res.stats, options);
+    if (options.backend != Backend::Automatic) {
+        res.backend = options.backend;
+        res.reason = "requested";
+        return res;
+    }
+    if (circuit.nr_qubits <= SmallCircuit::max_qubits) {
+        res.backend = Backend::StateVector;
+        res.reason = "narrow enough to keep the amplitudes";
+        return res;
+    }
+    const Estimate* best = nullptr;
+    for (auto& estimate : res.estimates) {
+        if (estimate.feasible && estimate.exact &&
+            (best == nullptr || estimate.seconds < best->seconds)) {
+            best = &estimate;
+        }
+    }
+    if (best != nullptr) {
+        res.backend = best->backend;
+        res.reason = "cheapest exact backend";
+    } else {
+        res.backend = Backend::MatrixProductState;
+        res.reason = "no exact backend fits, the bond dimension is truncated";
+    }
+    return res;
+}
+
+Plan plan(const lang::Program& program, const Options& options) {
+    return plan(Circuit::compile(program), options);
+}
+
+std::ostream& operator<<(std::ostream& os, const Plan& plan) {
+    auto& stats = plan.stats;
+    auto precision = os.precision();
+    os << "plan: " << to_string(plan.backend) << " (" << plan.reason << ")\n";
+    os << "    | " << stats.width << " qubits, depth " << stats.depth << ", "
+       << stats.nr_gates << " gates (" << stats.nr_two_qubit_gates << " two-qubit, "
+       << (stats.clifford ? "Clifford" : "non-Clifford")
+       << (stats.permutation ? ", permutation" : "") << ")\n";
+    os << "    | two-qubit distance: max " << stats.max_distance << ", total "
+       << stats.total_distance << "; largest cut crossing " << stats.max_crossings << "\n";
+    os << "    | " << stats.nr_measurements << " measurement(s), " << stats.nr_resets
+       << " reset(s), " << stats.nr_conditions << " condition(s)"
+       << (stats.mid_circuit_measurements ? ", mid-circuit" : "") << "\n";
+    for (auto& estimate : plan.estimates) {
+        os << "    | " << std::left << std::setw(22) << to_string(estimate.backend);
+        if (!estimate.feasible) {
+            os << "not applicable\n";
+            continue;
+        }
+        os << std::setprecision(3) << estimate.seconds << " s, "
+           << estimate.bytes << " bytes" << (estimate.exact ? "" : " (truncated)") << "\n";
+    }
+    os << std::right << std::setprecision(precision);
+    return os;
+}
+
+}
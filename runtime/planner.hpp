@@ -0,0 +1,108 @@
+/**
+ * Copyright (c) 2022 Alcides Andrade <andrade.alcides.junior@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef __RUNTIME__PLANNER_H__
+#define __RUNTIME__PLANNER_H__
+
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "circuit.hpp"
+#include "lang/program.hpp"
+#include "runtime.hpp"
+
+namespace runtime {
+
+/**
+ * What the planner knows about a circuit before running it
+ * */
+struct CircuitStats {
+    size_t width { 0 };
+    // longest chain of operations that depend on each other through their qubits
+    size_t depth { 0 };
+    size_t nr_gates { 0 };
+    size_t nr_two_qubit_gates { 0 };
+    size_t nr_measurements { 0 };
+    size_t nr_resets { 0 };
+    size_t nr_conditions { 0 };
+    // a gate acts on a qubit after it was measured or reset
+    bool mid_circuit_measurements { false };
+    // every U gate is a Clifford gate
+    bool clifford { false };
+    // the circuit maps basis states to basis states
+    bool permutation { false };
+    // largest and total distance between the qubits of the two-qubit gates
+    size_t max_distance { 0 };
+    size_t total_distance { 0 };
+    // largest number of two-qubit gates across a cut between the qubits i and i + 1,
+    // which bounds the entanglement across the cut by 2^max_crossings
+    size_t max_crossings { 0 };
+};
+
+struct Estimate {
+    Backend backend;
+    // the backend can run the circuit within the options
+    bool feasible;
+    // the result is exact, i.e., not truncated
+    bool exact;
+    double seconds;
+    double bytes;
+};
+
+/**
+ * The backend picked for a circuit, with the statistics and estimates it was
+ * picked from
+ * */
+struct Plan {
+    CircuitStats stats;
+    std::vector<Estimate> estimates;
+    Backend backend;
+    // why the backend was picked
+    std::string reason;
+};
+
+std::string to_string(Backend backend);
+
+CircuitStats analyze(const Circuit& circuit);
+
+/**
+ * Estimate the time and memory of a run on each backend and pick the cheapest
+ * exact one. Circuits of at most `SmallCircuit::max_qubits` qubits stay on the
+ * state vector so that their amplitudes are available, and a truncated matrix
+ * product state is only picked when no exact backend can run the circuit.
+ * The decision diagram is only run when asked for, since its size depends on
+ * the values of the amplitudes and cannot be estimated from the circuit, and
+ * so is the out-of-core state vector, which writes the whole state to disk.
+ * */
+Plan plan(const Circuit& circuit, const Options& options = {});
+
+/**
+ * Plan a program that went through `lang::sema::verify`
+ * */
+Plan plan(const lang::Program& program, const Options& options = {});
+
+std::ostream& operator<<(std::ostream& os, const Plan& plan);
+
+}
+
+#endif // __RUNTIME__PLANNER_H__
@@ -22,46 +22,146 @@
 
 #include "runtime.hpp"
 
+#include <algorithm>
 #include <iostream>
 #include <memory>
+#include <unistd.h>
 
+#include "bit_sliced.hpp"
 #include "error.hpp"
+#include "decision_diagram.hpp"
 #include "gate.hpp"
-#include "lang/symbol_table.hpp"
+#include "matrix_product_state.hpp"
+#include "passes.hpp"
+#include "planner.hpp"
+#include "small_circuit.hpp"
+#include "tableau.hpp"
+#include "unitary_simulator.hpp"
 
 namespace runtime {
 
-static void declare_register(const std::shared_ptr<lang::VariableDeclaration>&);
-static void declare_gate(const std::shared_ptr<lang::GateDeclaration>&);
-static void execute_unitary(const std::shared_ptr<lang::UnitaryOperation>&);
-static void execute_measure(const std::shared_ptr<lang::MeasureOperation>&);
-static void execute_reset(const std::shared_ptr<lang::ResetOperation>&);
-static void execute_barrier(const std::shared_ptr<lang::BarrierOperation>&);
-static void execute_if_statement(const std::shared_ptr<lang::IfStatement>&);
+static Backend select_backend(const Circuit&, const Options&);
+static void declare_registers(const Circuit&, bool quantum = true);
+static void execute_small(const Circuit&);
+static void execute_bit_sliced(const Circuit&);
+template <typename Backend>
+static void execute_on(Backend&, const Circuit&);
+static void execute_unitary(const Operation&, const std::vector<double>& parameters);
+static void execute_measure(const Operation&);
+static void execute_reset(const Operation&);
+static void execute_barrier(const Operation&);
 
 static State _state;
-static std::unordered_map<std::string, std::shared_ptr<lang::GateDeclaration>> _gates;
-
-void execute(const lang::Program& program) {
-    for (auto& stmt : program.statements) {
-        if (auto declaration = std::dynamic_pointer_cast<lang::VariableDeclaration>(stmt)) {
-            declare_register(declaration);
-        } else if (auto declaration = std::dynamic_pointer_cast<lang::GateDeclaration>(stmt)) {
-            declare_gate(declaration);
-        } else if (auto unitary = std::dynamic_pointer_cast<lang::UnitaryOperation>(stmt)) {
-            execute_unitary(unitary);
-        } else if (auto reset = std::dynamic_pointer_cast<lang::ResetOperation>(stmt)) {
-            execute_reset(reset);
-        } else if (auto measure = std::dynamic_pointer_cast<lang::MeasureOperation>(stmt)) {
-            execute_measure(measure);
-        } else if (auto barrier = std::dynamic_pointer_cast<lang::BarrierOperation>(stmt)) {
-            execute_barrier(barrier);
-        } else if (auto ifstmt = std::dynamic_pointer_cast<lang::IfStatement>(stmt)) {
-            execute_if_statement(ifstmt);
-        } else if (auto comment = std::dynamic_pointer_cast<lang::Comment>(stmt)) {
-            // nothing to do
+static std::unique_ptr<Tableau> _tableau;
+static std::unique_ptr<MatrixProductState> _mps;
+static std::unique_ptr<DecisionDiagram> _decision_diagram;
+static std::unique_ptr<math::unitary_t> _unitary;
+static std::unique_ptr<ChunkedState> _chunked;
+
+void execute(const lang::Program& program, const Options& options) {
+    execute(Circuit::compile(program), options);
+}
+
+void execute(const Circuit& circuit, const Options& options) {
+    if (options.prune_light_cone || options.recycle_qubits) {
+        Options rewritten = options;
+        rewritten.prune_light_cone = false;
+        rewritten.recycle_qubits = false;
+        Circuit res = circuit;
+        if (options.prune_light_cone) {
+            PruningStats stats;
+            res = prune_light_cone(res, &stats);
+            if (options.verbose) {
+                std::cout << stats;
+            }
+        }
+        if (options.recycle_qubits) {
+            res = recycle_qubits(res);
+        }
+        execute(res, rewritten);
+        return;
+    }
+    _tableau = nullptr;
+    _mps = nullptr;
+    _decision_diagram = nullptr;
+    _unitary = nullptr;
+    _chunked = nullptr;
+    switch (select_backend(circuit, options)) {
+    case Backend::Stabilizer:
+        if (!Tableau::supports(circuit)) {
+            throw Error("the stabilizer backend only runs circuits of Clifford gates");
+        }
+        declare_registers(circuit, false);
+        _tableau = std::make_unique<Tableau>(circuit.nr_qubits);
+        execute_on(*_tableau, circuit);
+        return;
+    case Backend::MatrixProductState:
+        declare_registers(circuit, false);
+        _mps = std::make_unique<MatrixProductState>(circuit.nr_qubits,
+                                                    options.max_bond_dimension,
+                                                    options.truncation_cutoff);
+        execute_on(*_mps, circuit);
+        return;
+    case Backend::DecisionDiagram:
+        declare_registers(circuit, false);
+        _decision_diagram = std::make_unique<DecisionDiagram>(circuit.nr_qubits);
+        execute_on(*_decision_diagram, circuit);
+        return;
+    case Backend::Unitary:
+        declare_registers(circuit, false);
+        _unitary = std::make_unique<math::unitary_t>(UnitarySimulator(circuit).run());
+        return;
+    case Backend::BitSliced:
+        declare_registers(circuit, false);
+        execute_bit_sliced(circuit);
+        return;
+    case Backend::OutOfCore: {
+        declare_registers(circuit, false);
+        size_t chunk_qubits = std::min(options.chunk_qubits, circuit.nr_qubits);
+        size_t nr_chunks = size_t(1) << (circuit.nr_qubits - chunk_qubits);
+        std::unique_ptr<math::ChunkStore> store;
+        if (options.chunk_directory.empty()) {
+            store = std::make_unique<math::MemoryChunkStore>(nr_chunks, size_t(1) << chunk_qubits);
         } else {
-            throw Error("undefined statement (" + std::to_string(stmt->context.start_line) + ")");
+            auto path = options.chunk_directory + "/state." + std::to_string(getpid());
+            store = std::make_unique<math::FileChunkStore>(path, nr_chunks,
+                                                           size_t(1) << chunk_qubits);
+        }
+        _chunked = std::make_unique<ChunkedState>(circuit.nr_qubits, chunk_qubits,
+                                                  std::move(store));
+        execute_on(*_chunked, circuit);
+        return;
+    }
+    case Backend::Automatic:
+    case Backend::StateVector:
+        break;
+    }
+    declare_registers(circuit);
+    if (SmallCircuit::supports(circuit)) {
+        execute_small(circuit);
+        return;
+    }
+    for (auto& operation : circuit.operations) {
+        if (operation.condition.has_value()) {
+            auto& [creg, value] = operation.condition.value();
+            if (_state.classical_register_value(creg) != value) {
+                continue;
+            }
+        }
+        switch (operation.type) {
+        case Operation::U:
+        case Operation::CX:
+            execute_unitary(operation, circuit.parameters);
+            break;
+        case Operation::Measure:
+            execute_measure(operation);
+            break;
+        case Operation::Reset:
+            execute_reset(operation);
+            break;
+        case Operation::Barrier:
+            execute_barrier(operation);
+            break;
         }
     }
 }
@@ -70,41 +170,121 @@ const State& get_state() {
     return _state;
 }
 
-static void declare_register(const std::shared_ptr<lang::VariableDeclaration>& declaration) {
-    if (declaration->type == lang::VariableDeclaration::Qbit) {
-        _state.add_quantum_register(declaration->identifier, declaration->dimension);
-    } else {
-        _state.add_classical_register(declaration->identifier, declaration->dimension);
+const Tableau* get_tableau() {
+    return _tableau.get();
+}
+
+const MatrixProductState* get_mps() {
+    return _mps.get();
+}
+
+const DecisionDiagram* get_decision_diagram() {
+    return _decision_diagram.get();
+}
+
+const math::unitary_t* get_unitary() {
+    return _unitary.get();
+}
+
+ChunkedState* get_chunked_state() {
+    return _chunked.get();
+}
+
+static Backend select_backend(const Circuit& circuit, const Options& options) {
+    if (options.backend != Backend::Automatic && !options.verbose) {
+        return options.backend;
+    }
+    auto res = plan(circuit, options);
+    if (options.verbose) {
+        std::cout << res;
+    }
+    return res.backend;
+}
+
+static void declare_registers(const Circuit& circuit, bool quantum) {
+    _state = State();
+    if (quantum) {
+        _state.add_quantum_registers(circuit.quantum_registers_in_order(), circuit.components());
+    }
+    for (auto& [name, size] : circuit.classical_registers) {
+        _state.add_classical_register(name, size);
     }
 }
 
-static void declare_gate(const std::shared_ptr<lang::GateDeclaration>& declaration) {
-    _gates[declaration->identifier] = declaration;
+static void execute_small(const Circuit& circuit) {
+    SmallCircuit small(circuit);
+    std::vector<math::cx_t> amplitudes(size_t(1) << small.nr_qubits());
+    auto bits = small.run(amplitudes.data());
+    _state.set_amplitudes(amplitudes.data());
+    for (auto& [name, value] : small.unpack(bits)) {
+        _state.set_classical_register(name, value);
+    }
 }
 
-static void execute_unitary(const std::shared_ptr<lang::UnitaryOperation>&) {
+static void execute_bit_sliced(const Circuit& circuit) {
+    // a single input, |0...0>, in the first bit of one word per qubit
+    BitSliced simulator(circuit);
+    std::vector<BitSliced::word_t> qubits(simulator.nr_qubits());
+    std::vector<BitSliced::word_t> bits(simulator.nr_classical_bits());
+    simulator.run(qubits, bits, 1);
+    for (auto& [name, value] : simulator.unpack(bits, 1, 0)) {
+        _state.set_classical_register(name, value);
+    }
 }
 
-static void execute_measure(const std::shared_ptr<lang::MeasureOperation>& measure) {
-    auto qreg_name = measure->source.identifier;
-    auto creg_name = measure->target.identifier;
-    _state.measure(qreg_name, creg_name);
+/**
+ * Run the circuit on a backend that keeps its own quantum state, with the
+ * classical registers in `_state`
+ * */
+template <typename Backend>
+static void execute_on(Backend& backend, const Circuit& circuit) {
+    for (auto& operation : circuit.operations) {
+        if (operation.condition.has_value()) {
+            auto& [creg, value] = operation.condition.value();
+            if (_state.classical_register_value(creg) != value) {
+                continue;
+            }
+        }
+        switch (operation.type) {
+        case Operation::U:
+        case Operation::CX:
+            backend.apply(operation, circuit.parameters);
+            break;
+        case Operation::Measure:
+            _state.set_classical_bit(operation.creg, operation.bit,
+                                     backend.measure(operation.qubits[0]));
+            break;
+        case Operation::Reset:
+            backend.reset(operation.qubits[0]);
+            break;
+        case Operation::Barrier:
+            break;
+        }
+    }
 }
 
-static void execute_reset(const std::shared_ptr<lang::ResetOperation>& reset) {
-    auto qreg_name = reset->target.identifier;
-    if (reset->target.index.has_value()) {
-        auto index = reset->target.index.value();
-        _state.reset_quantum_register_partial(qreg_name, index);
+static void execute_unitary(const Operation& operation, const std::vector<double>& parameters) {
+    if (operation.type == Operation::CX) {
+        _state.apply(Gate::cx(), operation.qubits);
     } else {
-        _state.reset_quantum_register(qreg_name);
+        auto& [theta, phi, lambda] = operation.angles;
+        _state.apply(Gate::u(theta.evaluate(parameters),
+                             phi.evaluate(parameters),
+                             lambda.evaluate(parameters)),
+                     operation.qubits);
     }
 }
 
-static void execute_barrier(const std::shared_ptr<lang::BarrierOperation>&) {
-    // TODO: implement
+static void execute_measure(const Operation& operation) {
+    bool outcome = _state.measure_qubit(operation.qubits[0]);
+    _state.set_classical_bit(operation.creg, operation.bit, outcome);
+}
+
+static void execute_reset(const Operation& operation) {
+    _state.reset_qubit(operation.qubits[0]);
 }
 
-static void execute_if_statement(const std::shared_ptr<lang::IfStatement>&) {
+static void execute_barrier(const Operation&) {
+    // barriers only constrain optimizations, there is nothing to simulate
 }
 }  // namespace runtime
@@ -24,14 +24,121 @@
 #ifndef __RUNTIME__RUNTIME_H__
 #define __RUNTIME__RUNTIME_H__
 
+#include "bit_sliced.hpp"
+#include "chunked_state.hpp"
+#include "circuit.hpp"
+#include "decision_diagram.hpp"
 #include "lang/program.hpp"
+#include "matrix_product_state.hpp"
 #include "state.hpp"
+#include "tableau.hpp"
+#include "unitary_simulator.hpp"
 
 #include <string>
 
 namespace runtime {
-void execute(const lang::Program&);
+
+enum class Backend {
+    Automatic,
+    StateVector,
+    Stabilizer,
+    MatrixProductState,
+    DecisionDiagram,
+    BitSliced,
+    // the matrix of the whole circuit instead of a single run
+    Unitary,
+    // the state vector in chunks kept in a file of `Options::chunk_directory`,
+    // or in memory chunks allocated when first written
+    OutOfCore,
+};
+
+/**
+ * The constants of the cost model, in seconds per elementary step of each
+ * backend. The defaults were measured on an optimized build.
+ * */
+struct CostModel {
+    // one amplitude of the state vector updated by a gate or a measurement
+    double state_vector_amplitude { 5e-9 };
+    // one row or word of the tableau updated
+    double tableau_word { 2e-9 };
+    // fixed cost of an operation on the matrix product state, and cost per
+    // cube of the bond dimension
+    double mps_overhead { 1e-6 };
+    double mps_bond_cube { 2.5e-8 };
+    // one gate on a packed word of inputs
+    double bit_sliced_gate { 1e-8 };
+};
+
+struct Options {
+    // where the quantum state is kept; `Automatic` picks it from the circuit
+    Backend backend { Backend::Automatic };
+    // widest circuit run on the state vector
+    size_t max_state_vector_qubits { 28 };
+    // largest bond dimension kept by the matrix product state
+    size_t max_bond_dimension { 64 };
+    // singular values below this fraction of the largest one are discarded
+    double truncation_cutoff { 1e-12 };
+    // used by the automatic selection to estimate the cost of each backend
+    CostModel cost_model;
+    // print the plan of the automatic selection to the standard output
+    bool verbose { false };
+    // directory of the file that holds the state of the out-of-core backend,
+    // preferably on a local SSD; when empty the chunks are kept in memory and
+    // only allocated when a gate writes to them
+    std::string chunk_directory { "/tmp" };
+    // every chunk of the out-of-core backend holds 2^chunk_qubits amplitudes
+    size_t chunk_qubits { 22 };
+    // run the circuit with the qubits of disjoint lifetimes merged (see
+    // `recycle_qubits`); only the classical registers keep their meaning
+    bool recycle_qubits { false };
+    // run the circuit without the operations that cannot change the classical
+    // registers (see `prune_light_cone`), before recycling the qubits
+    bool prune_light_cone { false };
+};
+
+/**
+ * Run a program on the backend selected by `options`. The automatic selection
+ * runs circuits of at most `SmallCircuit::max_qubits` qubits on the small circuit
+ * engine and wider ones on the cheapest backend according to the cost model
+ * (see `plan`).
+ * */
+void execute(const lang::Program&, const Options& options = {});
+void execute(const Circuit&, const Options& options = {});
+
+/**
+ * The state at the end of the last run. After a run on any backend other than
+ * the state vector it only holds the classical registers.
+ * */
 const State& get_state();
+
+/**
+ * The tableau of the last run, or null if it did not run on a tableau
+ * */
+const Tableau* get_tableau();
+
+/**
+ * The matrix product state of the last run, or null if it did not run on one.
+ * Its truncation error tells how far the result may be from the exact state.
+ * */
+const MatrixProductState* get_mps();
+
+/**
+ * The decision diagram of the last run, or null if it did not run on one
+ * */
+const DecisionDiagram* get_decision_diagram();
+
+/**
+ * The matrix of the circuit of the last run, or null if it did not run with
+ * the `Unitary` backend
+ * */
+const math::unitary_t* get_unitary();
+
+/**
+ * The chunked state of the last run, or null if it did not run out of core.
+ * Reading an amplitude applies the gates that are still queued, so the state
+ * is not const.
+ * */
+ChunkedState* get_chunked_state();
 }
 
 #endif // __RUNTIME__RUNTIME_H__
@@ -0,0 +1,228 @@
+/**
+ * Copyright (c) 2022 Alcides Andrade <andrade.alcides.junior@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "schrodinger_feynman.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <limits>
+#include <mutex>
+#include <thread>
+
+#include "error.hpp"
+#include "gate.hpp"
+
+namespace runtime {
+
+using math::cx_t;
+
+struct SchrodingerFeynman::Halves {
+    std::array<math::vector_t, 2> states;
+
+    Halves(size_t lower, size_t upper):
+        states { math::vector_t(size_t(1) << lower), math::vector_t(size_t(1) << upper) }
+    {
+        states[0][0] = 1;
+        states[1][0] = 1;
+    }
+
+    Halves(const Halves& other):
+        states { math::vector_t(other.states[0].size()), math::vector_t(other.states[1].size()) }
+    {
+        for (size_t h = 0; h < 2; h++) {
+            std::copy(other.states[h].ptr(), other.states[h].ptr() + other.states[h].size(),
+                      states[h].ptr());
+        }
+    }
+};
+
+// the matrices of the terms of a crossing CX and of a CX within a half,
+// at the start of `_matrices`
+static const size_t projector_0 = 0, projector_1 = 1, pauli_x = 2, cx = 3;
+
+SchrodingerFeynman::SchrodingerFeynman(const lang::Program& program, size_t cut, size_t nr_threads):
+    SchrodingerFeynman(Circuit::compile(program), cut, nr_threads)
+{}
+
+SchrodingerFeynman::SchrodingerFeynman(const Circuit& circuit, size_t cut, size_t nr_threads):
+    _nr_qubits(circuit.nr_qubits),
+    _cut(cut == 0 ? circuit.nr_qubits/2 : cut),
+    _nr_threads(nr_threads == 0 ? std::max(1u, std::thread::hardware_concurrency()) : nr_threads)
+{
+    if (_cut == 0 || _cut >= _nr_qubits) {
+        throw Error("the cut must leave qubits on both sides");
+    }
+    _matrices.push_back(math::unitary_t({ 1, 0, 0, 0 }));
+    _matrices.push_back(math::unitary_t({ 0, 0, 0, 1 }));
+    _matrices.push_back(math::unitary_t({ 0, 1, 1, 0 }));
+    _matrices.push_back(math::unitary_t({
+        1, 0, 0, 0,
+        0, 1, 0, 0,
+        0, 0, 0, 1,
+        0, 0, 1, 0,
+    }));
+    _segments.emplace_back();
+    auto half = [&](size_t qubit) { return size_t(qubit >= _cut); };
+    auto local = [&](size_t qubit) { return qubit >= _cut ? qubit - _cut : qubit; };
+    for (auto& operation : circuit.operations) {
+        if (operation.condition.has_value() ||
+            operation.type == Operation::Measure || operation.type == Operation::Reset) {
+            throw Error("the Schrödinger-Feynman simulator only supports unitary circuits (line " +
+                        std::to_string(operation.line) + ")");
+        }
+        if (operation.type == Operation::U) {
+            auto& [theta, phi, lambda] = operation.angles;
+            size_t q = operation.qubits[0];
+            _segments.back().push_back({ half(q), { local(q) }, _matrices.size() });
+            _matrices.push_back(Gate::u(theta.evaluate(circuit.parameters),
+                                        phi.evaluate(circuit.parameters),
+                                        lambda.evaluate(circuit.parameters)));
+        } else if (operation.type == Operation::CX) {
+            size_t c = operation.qubits[0], t = operation.qubits[1];
+            if (half(c) == half(t)) {
+                _segments.back().push_back({ half(c), { local(c), local(t) }, cx });
+            } else {
+                _crossings.push_back({ half(c), local(c), local(t) });
+                _segments.emplace_back();
+            }
+        }
+    }
+    _stats.nr_crossings = _crossings.size();
+    _stats.nr_paths = _crossings.size() < std::numeric_limits<size_t>::digits
+        ? size_t(1) << _crossings.size() : std::numeric_limits<size_t>::max();
+}
+
+void SchrodingerFeynman::run_segment(size_t segment, Halves& halves) const {
+    for (auto& gate : _segments[segment]) {
+        _matrices[gate.matrix].apply(halves.states[gate.half], gate.qubits);
+    }
+}
+
+void SchrodingerFeynman::cross(size_t crossing, bool term, Halves& halves) const {
+    auto& [control_half, control, target] = _crossings[crossing];
+    _matrices[term ? projector_1 : projector_0].apply(halves.states[control_half], { control });
+    if (term) {
+        _matrices[pauli_x].apply(halves.states[1 - control_half], { target });
+    }
+}
+
+static bool is_zero(const math::vector_t& state) {
+    for (size_t i = 0; i < state.size(); i++) {
+        if (state[i] != cx_t(0)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void SchrodingerFeynman::enumerate(size_t crossing, Halves& halves,
+                                   const std::vector<std::pair<size_t, size_t>>& indices,
+                                   std::vector<std::complex<double>>& res) const
+{
+    if (crossing == _crossings.size()) {
+        for (size_t r = 0; r < indices.size(); r++) {
+            auto [lower, upper] = indices[r];
+            res[r] += std::complex<double>(halves.states[0][lower])*
+                      std::complex<double>(halves.states[1][upper]);
+        }
+        return;
+    }
+    // the second term reuses the state of the prefix instead of a copy
+    Halves first(halves);
+    cross(crossing, false, first);
+    if (!is_zero(first.states[_crossings[crossing].control_half])) {
+        run_segment(crossing + 1, first);
+        enumerate(crossing + 1, first, indices, res);
+    }
+    cross(crossing, true, halves);
+    if (!is_zero(halves.states[_crossings[crossing].control_half])) {
+        run_segment(crossing + 1, halves);
+        enumerate(crossing + 1, halves, indices, res);
+    }
+}
+
+std::complex<double> SchrodingerFeynman::amplitude(const std::vector<bool>& bits) const {
+    return amplitudes({ bits })[0];
+}
+
+std::vector<std::complex<double>> SchrodingerFeynman::amplitudes(
+    const std::vector<std::vector<bool>>& bits) const
+{
+    std::vector<std::pair<size_t, size_t>> indices;
+    for (auto& b : bits) {
+        if (b.size() != _nr_qubits) {
+            throw Error("expected " + std::to_string(_nr_qubits) + " bits, but " +
+                        std::to_string(b.size()) + " were passed");
+        }
+        size_t lower = 0, upper = 0;
+        for (size_t q = 0; q < _nr_qubits; q++) {
+            if (q < _cut) {
+                lower |= size_t(b[q]) << q;
+            } else {
+                upper |= size_t(b[q]) << (q - _cut);
+            }
+        }
+        indices.emplace_back(lower, upper);
+    }
+
+    // every task fixes the terms of the first crossings and enumerates the rest
+    size_t nr_fixed = 0;
+    while (nr_fixed < _crossings.size() && (size_t(1) << nr_fixed) < 4*_nr_threads) {
+        nr_fixed++;
+    }
+    size_t nr_tasks = size_t(1) << nr_fixed;
+    size_t nr_threads = std::min(_nr_threads, nr_tasks);
+    std::atomic<size_t> next { 0 };
+    std::mutex mutex;
+    std::vector<std::complex<double>> res(bits.size());
+    auto worker = [&]() {
+        std::vector<std::complex<double>> sum(bits.size());
+        for (size_t task = next++; task < nr_tasks; task = next++) {
+            Halves halves(_cut, _nr_qubits - _cut);
+            run_segment(0, halves);
+            bool pruned = false;
+            for (size_t i = 0; i < nr_fixed && !pruned; i++) {
+                cross(i, (task >> i) & 1, halves);
+                pruned = is_zero(halves.states[_crossings[i].control_half]);
+                run_segment(i + 1, halves);
+            }
+            if (!pruned) {
+                enumerate(nr_fixed, halves, indices, sum);
+            }
+        }
+        std::lock_guard<std::mutex> lock(mutex);
+        for (size_t r = 0; r < res.size(); r++) {
+            res[r] += sum[r];
+        }
+    };
+    std::vector<std::thread> threads;
+    for (size_t t = 1; t < nr_threads; t++) {
+        threads.emplace_back(worker);
+    }
+    worker();
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    return res;
+}
+
+}
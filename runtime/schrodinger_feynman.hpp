@@ -0,0 +1,118 @@
+/**
+ * Copyright (c) 2022 Alcides Andrade <andrade.alcides.junior@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef __RUNTIME__SCHRODINGER_FEYNMAN_H__
+#define __RUNTIME__SCHRODINGER_FEYNMAN_H__
+
+#include <complex>
+#include <vector>
+
+#include "circuit.hpp"
+#include "lang/program.hpp"
+#include "math/unitary.hpp"
+
+namespace runtime {
+
+/**
+ * A Schrödinger-Feynman simulator for unitary circuits that are too wide for
+ * a single state vector, but where few gates cross a cut of the qubits.
+ *
+ * The qubits below the cut and the qubits above it are each kept in a state
+ * vector. Every CX with the control on one side and the target on the other
+ * is split in two product terms,
+ *     CX = |0><0| ⊗ I + |1><1| ⊗ X,
+ * so that the circuit becomes a sum of 2^k products of circuits on each half,
+ * one for each path through the k crossing gates. The amplitudes are the sum
+ * over the paths of the products of the amplitudes of the halves.
+ *
+ * The paths are enumerated depth first, so that the gates before a crossing
+ * are simulated once for both of its terms, and the subtrees of the first
+ * crossings are spread over the threads. Paths whose projector leaves one of
+ * the halves at zero are pruned.
+ * */
+class SchrodingerFeynman {
+public:
+    struct Stats {
+        size_t nr_crossings;
+        // 2^nr_crossings, saturated at the largest size_t
+        size_t nr_paths;
+    };
+
+    /**
+     * Split a circuit, which must not measure, reset or have conditions, at
+     * `cut`, i.e., the qubits [0, cut) and [cut, nr_qubits) are simulated
+     * separately. When `cut` is 0 the qubits are split in half, and when
+     * `nr_threads` is 0 one thread per hardware thread is used.
+     * */
+    SchrodingerFeynman(const Circuit& circuit, size_t cut = 0, size_t nr_threads = 0);
+    SchrodingerFeynman(const lang::Program& program, size_t cut = 0, size_t nr_threads = 0);
+
+    /**
+     * The amplitude of the basis state whose bit k is the value of the qubit k
+     * */
+    std::complex<double> amplitude(const std::vector<bool>& bits) const;
+
+    /**
+     * The amplitudes of several basis states, computed over a single
+     * enumeration of the paths
+     * */
+    std::vector<std::complex<double>> amplitudes(const std::vector<std::vector<bool>>& bits) const;
+
+    inline const Stats& stats() const {
+        return _stats;
+    }
+
+private:
+    // a gate acting on one of the halves, with the qubits numbered within it
+    struct LocalGate {
+        size_t half;
+        std::vector<size_t> qubits;
+        size_t matrix;
+    };
+
+    struct Crossing {
+        size_t control_half;
+        size_t control;
+        size_t target;
+    };
+
+    struct Halves;
+
+    size_t _nr_qubits;
+    size_t _cut;
+    size_t _nr_threads;
+    std::vector<math::unitary_t> _matrices;
+    // the gates before each crossing, and after the last one
+    std::vector<std::vector<LocalGate>> _segments;
+    std::vector<Crossing> _crossings;
+    Stats _stats;
+
+    void run_segment(size_t segment, Halves& halves) const;
+    void cross(size_t crossing, bool term, Halves& halves) const;
+    void enumerate(size_t crossing, Halves& halves,
+                   const std::vector<std::pair<size_t, size_t>>& indices,
+                   std::vector<std::complex<double>>& res) const;
+};
+
+}
+
+#endif // __RUNTIME__SCHRODINGER_FEYNMAN_H__
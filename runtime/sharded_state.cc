@@ -0,0 +1,438 @@
+/**
+ * Copyright (c) 2022 Alcides Andrade <andrade.alcides.junior@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "sharded_state.hpp"
+#include "error.hpp"
+#include "gate.hpp"
+#include "math/vector.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <cmath>
+#include <csignal>
+#include <cstring>
+#include <random>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+namespace runtime {
+
+// largest number of amplitudes sent in one message of a swap
+static const size_t max_message = size_t(1) << 16;
+
+SocketTransport::SocketTransport(size_t nr_ranks):
+    _nr_ranks(nr_ranks), _sockets(nr_ranks, std::vector<int>(nr_ranks, -1))
+{
+    for (size_t a = 0; a < nr_ranks; a++) {
+        for (size_t b = a + 1; b < nr_ranks; b++) {
+            int fds[2];
+            if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) != 0) {
+                throw Error(std::string("cannot create socket pair: ") + std::strerror(errno));
+            }
+            _sockets[a][b] = fds[0];
+            _sockets[b][a] = fds[1];
+        }
+    }
+}
+
+SocketTransport::~SocketTransport() {
+    for (auto& row : _sockets) {
+        for (auto fd : row) {
+            if (fd >= 0) {
+                close(fd);
+            }
+        }
+    }
+}
+
+void SocketTransport::attach(size_t rank) {
+    _rank = rank;
+    for (size_t a = 0; a < _nr_ranks; a++) {
+        if (a == rank) {
+            continue;
+        }
+        for (auto& fd : _sockets[a]) {
+            if (fd >= 0) {
+                close(fd);
+                fd = -1;
+            }
+        }
+    }
+}
+
+void SocketTransport::send(size_t to, const void* data, size_t size) {
+    auto bytes = static_cast<const char*>(data);
+    while (size > 0) {
+        ssize_t n = ::send(_sockets[_rank][to], bytes, size, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            throw Error("lost the connection to rank " + std::to_string(to));
+        }
+        bytes += n;
+        size -= n;
+    }
+}
+
+void SocketTransport::recv(size_t from, void* data, size_t size) {
+    auto bytes = static_cast<char*>(data);
+    while (size > 0) {
+        ssize_t n = ::recv(_sockets[_rank][from], bytes, size, 0);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            throw Error("lost the connection to rank " + std::to_string(from));
+        }
+        bytes += n;
+        size -= n;
+    }
+}
+
+/**
+ * The part of a `ShardedState` held by one process
+ * */
+class Shard {
+private:
+    size_t _rank;
+    size_t _nr_ranks;
+    size_t _nr_local;
+    Transport& _transport;
+    math::Vector _amplitudes;
+    // physical position of each logical qubit and its inverse
+    std::vector<size_t> _layout;
+    std::vector<size_t> _logical;
+    // last gate that used each physical qubit, to pick the qubit to swap out
+    std::vector<size_t> _last_use;
+    size_t _clock { 0 };
+    std::mt19937_64 _generator;
+
+    void exchange(size_t partner, const math::cx_t* out, math::cx_t* in, size_t size);
+    void swap(size_t local, size_t global);
+    std::array<double, 2> sum(std::array<double, 2> values);
+
+public:
+    ShardedState::Stats stats;
+
+    Shard(size_t nr_qubits, size_t nr_global, size_t rank, Transport& transport, uint64_t seed);
+
+    void apply(const math::Unitary& mat, const std::vector<size_t>& qubits);
+    bool measure(size_t qubit);
+    void reset(size_t qubit);
+
+    /**
+     * Send the shard to the rank 0, which writes the whole state into `res`
+     * */
+    void gather(std::vector<math::cx_t>& res);
+};
+
+Shard::Shard(size_t nr_qubits, size_t nr_global, size_t rank, Transport& transport, uint64_t seed):
+    _rank(rank), _nr_ranks(size_t(1) << nr_global), _nr_local(nr_qubits - nr_global),
+    _transport(transport), _amplitudes(size_t(1) << (nr_qubits - nr_global)),
+    _layout(nr_qubits), _logical(nr_qubits), _last_use(nr_qubits), _generator(seed)
+{
+    for (size_t q = 0; q < nr_qubits; q++) {
+        _layout[q] = q;
+        _logical[q] = q;
+    }
+    if (rank == 0) {
+        _amplitudes[0] = 1;
+    }
+}
+
+/**
+ * Send `size` amplitudes to `partner` and receive as many from it. The lower
+ * rank sends first so that two blocking transports do not wait on each other.
+ * */
+void Shard::exchange(size_t partner, const math::cx_t* out, math::cx_t* in, size_t size) {
+    size_t bytes = size*sizeof(math::cx_t);
+    if (_rank < partner) {
+        _transport.send(partner, out, bytes);
+        _transport.recv(partner, in, bytes);
+    } else {
+        _transport.recv(partner, in, bytes);
+        _transport.send(partner, out, bytes);
+    }
+    stats.bytes_exchanged += bytes;
+}
+
+/**
+ * Exchange the physical qubits `local` and `global`. An amplitude whose local
+ * bit differs from the global bit of its rank moves to the rank that differs
+ * in the global bit, so each rank sends the half of its shard where the local
+ * bit is the complement of its own global bit, and receives the same half.
+ * */
+void Shard::swap(size_t local, size_t global) {
+    size_t partner = _rank ^ (size_t(1) << (global - _nr_local));
+    size_t bit = ((_rank >> (global - _nr_local)) & 1) ^ 1;
+    size_t half = _amplitudes.size()/2;
+    size_t low_mask = (size_t(1) << local) - 1;
+    auto index = [&](size_t k) {
+        return ((k & ~low_mask) << 1) | (bit << local) | (k & low_mask);
+    };
+    size_t block = std::min(half, max_message);
+    std::vector<math::cx_t> out(block), in(block);
+    for (size_t start = 0; start < half; start += block) {
+        for (size_t k = 0; k < block; k++) {
+            out[k] = _amplitudes[index(start + k)];
+        }
+        exchange(partner, out.data(), in.data(), block);
+        for (size_t k = 0; k < block; k++) {
+            _amplitudes[index(start + k)] = in[k];
+        }
+    }
+    std::swap(_logical[local], _logical[global]);
+    _layout[_logical[local]] = local;
+    _layout[_logical[global]] = global;
+    std::swap(_last_use[local], _last_use[global]);
+    stats.nr_swaps++;
+}
+
+/**
+ * Add up `values` over all the ranks. Every rank adds the terms in the same
+ * order, so that they all get exactly the same result.
+ * */
+std::array<double, 2> Shard::sum(std::array<double, 2> values) {
+    std::vector<std::array<double, 2>> all(_nr_ranks);
+    all[_rank] = values;
+    for (size_t r = 0; r < _nr_ranks; r++) {
+        if (r != _rank) {
+            _transport.send(r, values.data(), sizeof(values));
+        }
+    }
+    for (size_t r = 0; r < _nr_ranks; r++) {
+        if (r != _rank) {
+            _transport.recv(r, all[r].data(), sizeof(values));
+        }
+    }
+    std::array<double, 2> res = { 0, 0 };
+    for (auto& v : all) {
+        res[0] += v[0];
+        res[1] += v[1];
+    }
+    return res;
+}
+
+void Shard::apply(const math::Unitary& mat, const std::vector<size_t>& qubits) {
+    _clock++;
+    std::vector<size_t> physical;
+    for (auto q : qubits) {
+        physical.push_back(_layout[q]);
+    }
+    for (auto& p : physical) {
+        if (p < _nr_local) {
+            continue;
+        }
+        size_t victim = _nr_local;
+        for (size_t l = 0; l < _nr_local; l++) {
+            bool used = std::find(physical.begin(), physical.end(), l) != physical.end();
+            if (!used && (victim == _nr_local || _last_use[l] < _last_use[victim])) {
+                victim = l;
+            }
+        }
+        swap(victim, p);
+        p = victim;
+    }
+    for (auto p : physical) {
+        _last_use[p] = _clock;
+    }
+    mat.apply(_amplitudes, physical);
+}
+
+bool Shard::measure(size_t qubit) {
+    size_t p = _layout[qubit];
+    std::array<double, 2> prob = { 0, 0 };
+    for (size_t i = 0; i < _amplitudes.size(); i++) {
+        size_t bit = p < _nr_local ? (i >> p) & 1 : (_rank >> (p - _nr_local)) & 1;
+        prob[bit] += std::norm(_amplitudes[i]);
+    }
+    prob = sum(prob);
+    std::uniform_real_distribution<double> distr(0, prob[0] + prob[1]);
+    size_t m = distr(_generator) < prob[0] ? 0 : 1;
+    float scale = 1/std::sqrt(prob[m]);
+    for (size_t i = 0; i < _amplitudes.size(); i++) {
+        size_t bit = p < _nr_local ? (i >> p) & 1 : (_rank >> (p - _nr_local)) & 1;
+        _amplitudes[i] = bit == m ? _amplitudes[i]*scale : 0;
+    }
+    return m == 1;
+}
+
+void Shard::reset(size_t qubit) {
+    if (measure(qubit)) {
+        apply(Gate::u(M_PI, 0, M_PI), { qubit });
+    }
+}
+
+void Shard::gather(std::vector<math::cx_t>& res) {
+    size_t size = _amplitudes.size();
+    if (_rank != 0) {
+        _transport.send(0, _amplitudes.ptr(), size*sizeof(math::cx_t));
+        return;
+    }
+    res.assign(size*_nr_ranks, 0);
+    math::Vector shard(size);
+    for (size_t r = 0; r < _nr_ranks; r++) {
+        if (r != 0) {
+            _transport.recv(r, shard.ptr(), size*sizeof(math::cx_t));
+        }
+        const math::Vector& source = r == 0 ? _amplitudes : shard;
+        for (size_t i = 0; i < size; i++) {
+            size_t physical = i | (r << _nr_local);
+            size_t index = 0;
+            for (size_t p = 0; p < _layout.size(); p++) {
+                index |= ((physical >> p) & 1) << _logical[p];
+            }
+            res[index] = source[i];
+        }
+    }
+}
+
+ShardedState::ShardedState(const Circuit& circuit, size_t nr_processes, TransportFactory transport):
+    _circuit(circuit), _nr_processes(nr_processes), _transport(transport)
+{
+    if (nr_processes == 0 || (nr_processes & (nr_processes - 1)) != 0) {
+        throw Error("the number of processes must be a power of two");
+    }
+    _nr_global = std::log2(nr_processes);
+    if (circuit.nr_qubits < _nr_global + 2) {
+        throw Error("a circuit of " + std::to_string(circuit.nr_qubits) + " qubits cannot be split over "
+                    + std::to_string(nr_processes) + " processes");
+    }
+    if (!_transport) {
+        _transport = [](size_t nr_ranks) {
+            return std::make_unique<SocketTransport>(nr_ranks);
+        };
+    }
+}
+
+/**
+ * Run the circuit on the shard of `rank`
+ * */
+static std::map<std::string, std::vector<bool>>
+simulate(const Circuit& circuit, Shard& shard) {
+    std::map<std::string, std::vector<bool>> registers;
+    for (auto& [name, size] : circuit.classical_registers) {
+        registers[name].resize(size);
+    }
+    for (auto& operation : circuit.operations) {
+        if (operation.condition.has_value()) {
+            auto& [creg, value] = operation.condition.value();
+            unsigned long current = 0;
+            for (size_t i = 0; i < registers[creg].size(); i++) {
+                current |= (unsigned long)(registers[creg][i]) << i;
+            }
+            if (current != value) {
+                continue;
+            }
+        }
+        switch (operation.type) {
+        case Operation::U: {
+            auto& [theta, phi, lambda] = operation.angles;
+            shard.apply(Gate::u(theta.evaluate(circuit.parameters),
+                                phi.evaluate(circuit.parameters),
+                                lambda.evaluate(circuit.parameters)),
+                        operation.qubits);
+            break;
+        }
+        case Operation::CX:
+            shard.apply(Gate::cx(), operation.qubits);
+            break;
+        case Operation::Measure:
+            registers[operation.creg][operation.bit] = shard.measure(operation.qubits[0]);
+            break;
+        case Operation::Reset:
+            shard.reset(operation.qubits[0]);
+            break;
+        case Operation::Barrier:
+            break;
+        }
+    }
+    return registers;
+}
+
+ShardedState::Result ShardedState::run(uint64_t seed, bool gather) const {
+    auto transport = _transport(_nr_processes);
+    std::vector<pid_t> workers;
+    for (size_t rank = 1; rank < _nr_processes; rank++) {
+        pid_t pid = fork();
+        if (pid < 0) {
+            for (auto worker : workers) {
+                kill(worker, SIGKILL);
+                waitpid(worker, nullptr, 0);
+            }
+            throw Error(std::string("cannot fork a worker: ") + std::strerror(errno));
+        }
+        if (pid == 0) {
+            // leave without running the destructors of the parent process
+            int status = EXIT_SUCCESS;
+            try {
+                transport->attach(rank);
+                Shard shard(_circuit.nr_qubits, _nr_global, rank, *transport, seed);
+                simulate(_circuit, shard);
+                std::vector<math::cx_t> unused;
+                if (gather) {
+                    shard.gather(unused);
+                }
+            } catch (...) {
+                status = EXIT_FAILURE;
+            }
+            _exit(status);
+        }
+        workers.push_back(pid);
+    }
+    Result res;
+    bool failed = false;
+    std::string error;
+    try {
+        transport->attach(0);
+        Shard shard(_circuit.nr_qubits, _nr_global, 0, *transport, seed);
+        res.registers = simulate(_circuit, shard);
+        if (gather) {
+            shard.gather(res.amplitudes);
+        }
+        // the exchanges are symmetric, every rank sends as much as the rank 0
+        res.stats.nr_swaps = shard.stats.nr_swaps;
+        res.stats.bytes_exchanged = shard.stats.bytes_exchanged*_nr_processes;
+    } catch (Error& e) {
+        failed = true;
+        error = e.msg;
+        for (auto worker : workers) {
+            kill(worker, SIGKILL);
+        }
+    }
+    for (auto worker : workers) {
+        int status;
+        waitpid(worker, &status, 0);
+        if (!WIFEXITED(status) || WEXITSTATUS(status) != EXIT_SUCCESS) {
+            failed = true;
+        }
+    }
+    if (failed) {
+        throw Error("sharded simulation failed" + (error.empty() ? "" : ": " + error));
+    }
+    return res;
+}
+
+}
@@ -0,0 +1,134 @@
+/**
+ * Copyright (c) 2022 Alcides Andrade <andrade.alcides.junior@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef __RUNTIME__SHARDED_STATE_H__
+#define __RUNTIME__SHARDED_STATE_H__
+
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "circuit.hpp"
+#include "math/types.hpp"
+
+namespace runtime {
+
+/**
+ * Point-to-point byte streams between the ranks of a sharded simulation. A
+ * transport is created for all the ranks before the worker processes are
+ * forked, and each process then calls `attach` with its own rank.
+ * */
+class Transport {
+public:
+    virtual ~Transport() = default;
+
+    virtual void attach(size_t rank) = 0;
+
+    /**
+     * Send `size` bytes to the rank `to`, blocking until they are written
+     * */
+    virtual void send(size_t to, const void* data, size_t size) = 0;
+
+    /**
+     * Receive exactly `size` bytes from the rank `from`. Throws `Error` if
+     * that rank went away.
+     * */
+    virtual void recv(size_t from, void* data, size_t size) = 0;
+};
+
+/**
+ * A transport over a pair of connected Unix domain sockets for every two ranks
+ * */
+class SocketTransport: public Transport {
+private:
+    size_t _nr_ranks;
+    size_t _rank { 0 };
+    // _sockets[a][b] is the end used by the rank a to talk to the rank b
+    std::vector<std::vector<int>> _sockets;
+
+public:
+    SocketTransport(size_t nr_ranks);
+    SocketTransport(const SocketTransport&) = delete;
+    SocketTransport& operator=(const SocketTransport&) = delete;
+    ~SocketTransport();
+
+    void attach(size_t rank) override;
+    void send(size_t to, const void* data, size_t size) override;
+    void recv(size_t from, void* data, size_t size) override;
+};
+
+/**
+ * A state vector distributed over `nr_processes` processes, a power of two, on
+ * one host. The top log2(nr_processes) physical qubits are global: they select
+ * the process that holds an amplitude, and the other qubits are local.
+ *
+ * Every process runs the whole circuit on its shard. Gates on local qubits need
+ * no communication. A gate on a global qubit first swaps it with the least
+ * recently used local qubit, with every process exchanging half of its shard
+ * with the process that differs in that global qubit; only the mapping between
+ * logical and physical qubits changes. Measurements add up the probabilities
+ * of all the processes, which then draw the same outcome from a shared seed.
+ *
+ * The process calling `run` is the rank 0 and forks the others.
+ * */
+class ShardedState {
+public:
+    using TransportFactory = std::function<std::unique_ptr<Transport>(size_t nr_ranks)>;
+
+    struct Stats {
+        size_t nr_swaps { 0 };
+        // bytes sent by all the processes together
+        size_t bytes_exchanged { 0 };
+    };
+
+    struct Result {
+        std::map<std::string, std::vector<bool>> registers;
+        // the final state, if it was requested
+        std::vector<math::cx_t> amplitudes;
+        Stats stats;
+    };
+
+    /**
+     * Throws `Error` if `nr_processes` is not a power of two or leaves fewer
+     * than 2 local qubits. The transport defaults to `SocketTransport`.
+     * */
+    ShardedState(const Circuit& circuit, size_t nr_processes, TransportFactory transport = {});
+
+    /**
+     * Run the circuit once from |0...0>. If `gather` is set the shards are
+     * sent to this process and the final state is returned.
+     * */
+    Result run(uint64_t seed, bool gather = false) const;
+
+private:
+    Circuit _circuit;
+    size_t _nr_processes;
+    size_t _nr_global;
+    TransportFactory _transport;
+};
+
+}
+
+#endif // __RUNTIME__SHARDED_STATE_H__
@@ -0,0 +1,347 @@
+/**
+ * Copyright (c) 2022 Alcides Andrade <andrade.alcides.junior@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "shot_coordinator.hpp"
+#include "compiled_circuit.hpp"
+#include "error.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <csignal>
+#include <cstring>
+#include <deque>
+#include <limits>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <thread>
+#include <unistd.h>
+
+namespace runtime {
+
+static bool write_all(int fd, const char* data, size_t size) {
+    while (size > 0) {
+        ssize_t n = send(fd, data, size, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return false;
+        }
+        data += n;
+        size -= n;
+    }
+    return true;
+}
+
+static bool read_all(int fd, char* data, size_t size) {
+    while (size > 0) {
+        ssize_t n = recv(fd, data, size, 0);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return false;
+        }
+        data += n;
+        size -= n;
+    }
+    return true;
+}
+
+/**
+ * Messages are a byte string prefixed by its size
+ * */
+static bool send_message(int fd, const std::string& message) {
+    size_t size = message.size();
+    return write_all(fd, reinterpret_cast<const char*>(&size), sizeof(size))
+        && write_all(fd, message.data(), size);
+}
+
+/**
+ * A message announced as longer than `max_size` is treated as a failed read,
+ * so that a corrupt size cannot make the receiver allocate without bound
+ * */
+static bool recv_message(int fd, std::string& message,
+                         size_t max_size = std::numeric_limits<size_t>::max())
+{
+    size_t size;
+    if (!read_all(fd, reinterpret_cast<char*>(&size), sizeof(size)) || size > max_size) {
+        return false;
+    }
+    message.resize(size);
+    return read_all(fd, message.data(), size);
+}
+
+template <typename T>
+static void append(std::string& out, const T& value) {
+    out.append(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+template <typename T>
+static T extract(const std::string& in, size_t& position) {
+    if (in.size() - position < sizeof(T)) {
+        throw Error("truncated message from a worker");
+    }
+    T value;
+    std::memcpy(&value, in.data() + position, sizeof(T));
+    position += sizeof(T);
+    return value;
+}
+
+static std::string encode(const ShotCoordinator::Histogram& histogram) {
+    std::string out;
+    append(out, histogram.size());
+    for (auto& [outcome, count] : histogram) {
+        append(out, outcome.size());
+        out += outcome;
+        append(out, count);
+    }
+    return out;
+}
+
+static ShotCoordinator::Histogram decode(const std::string& in) {
+    ShotCoordinator::Histogram histogram;
+    size_t position = 0;
+    for (size_t i = extract<size_t>(in, position); i > 0; i--) {
+        size_t size = extract<size_t>(in, position);
+        if (in.size() - position < size) {
+            throw Error("truncated message from a worker");
+        }
+        std::string outcome = in.substr(position, size);
+        position += size;
+        histogram[outcome] += extract<size_t>(in, position);
+    }
+    return histogram;
+}
+
+/**
+ * The loop of a worker: receive the circuit, then answer every request for a
+ * number of shots with their histogram, until the coordinator hangs up.
+ * */
+static void serve(int fd) {
+    std::string message;
+    if (!recv_message(fd, message)) {
+        return;
+    }
+    CompiledCircuit compiled(Circuit::deserialize(message));
+    while (recv_message(fd, message)) {
+        size_t position = 0;
+        size_t nr_shots = extract<size_t>(message, position);
+        std::vector<std::vector<double>> parameters(nr_shots, compiled.circuit().parameters);
+        ShotCoordinator::Histogram histogram;
+        for (auto& registers : compiled.run_batch(parameters, 1)) {
+            histogram[ShotCoordinator::outcome(registers)]++;
+        }
+        if (!send_message(fd, encode(histogram))) {
+            return;
+        }
+    }
+}
+
+std::string ShotCoordinator::outcome(const std::map<std::string, std::vector<bool>>& registers) {
+    std::string res;
+    for (auto& [name, bits] : registers) {
+        if (!res.empty()) {
+            res += ' ';
+        }
+        for (size_t i = bits.size(); i > 0; i--) {
+            res += bits[i - 1] ? '1' : '0';
+        }
+    }
+    return res;
+}
+
+ShotCoordinator::ShotCoordinator(const Circuit& circuit, size_t nr_workers, size_t batch_size):
+    _circuit(circuit.serialize()), _nr_workers(nr_workers), _batch_size(batch_size)
+{
+    for (auto& [name, size] : circuit.classical_registers) {
+        // the bits and the space that follows
+        _outcome_size += size + 1;
+    }
+    if (_nr_workers == 0) {
+        _nr_workers = std::max(1u, std::thread::hardware_concurrency());
+    }
+    if (_batch_size == 0) {
+        throw Error("the batch size must be positive");
+    }
+}
+
+ShotCoordinator::Histogram ShotCoordinator::run(size_t nr_shots, const std::function<void(pid_t)>& started) {
+    struct Worker {
+        pid_t pid { -1 };
+        int fd { -1 };
+        bool alive { false };
+        // shots of the batch being run, 0 when idle
+        size_t batch { 0 };
+    };
+    std::vector<Worker> workers(_nr_workers);
+    _stats = Stats();
+    _stats.shots_per_worker.resize(_nr_workers);
+    std::deque<size_t> pending;
+    for (size_t shots = 0; shots < nr_shots; shots += _batch_size) {
+        pending.push_back(std::min(_batch_size, nr_shots - shots));
+    }
+
+    auto fail = [&](Worker& worker) {
+        close(worker.fd);
+        kill(worker.pid, SIGKILL);
+        worker.alive = false;
+        _stats.nr_failed_workers++;
+        if (worker.batch > 0) {
+            pending.push_front(worker.batch);
+            worker.batch = 0;
+            _stats.nr_reassigned++;
+        }
+    };
+    auto stop = [&]() {
+        for (auto& worker : workers) {
+            if (worker.alive) {
+                // the worker leaves its loop when the socket is closed
+                close(worker.fd);
+            }
+        }
+        for (auto& worker : workers) {
+            if (worker.pid > 0) {
+                waitpid(worker.pid, nullptr, 0);
+            }
+        }
+    };
+
+    for (size_t i = 0; i < workers.size(); i++) {
+        int fds[2];
+        if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) != 0) {
+            stop();
+            throw Error(std::string("cannot create socket pair: ") + std::strerror(errno));
+        }
+        pid_t pid = fork();
+        if (pid < 0) {
+            close(fds[0]);
+            close(fds[1]);
+            stop();
+            throw Error(std::string("cannot fork a worker: ") + std::strerror(errno));
+        }
+        if (pid == 0) {
+            // the sockets of the other workers must only stay open in the coordinator
+            for (size_t j = 0; j < i; j++) {
+                if (workers[j].alive) {
+                    close(workers[j].fd);
+                }
+            }
+            close(fds[0]);
+            int status = EXIT_SUCCESS;
+            try {
+                serve(fds[1]);
+            } catch (...) {
+                status = EXIT_FAILURE;
+            }
+            _exit(status);
+        }
+        close(fds[1]);
+        workers[i] = { pid, fds[0], true, 0 };
+        if (started) {
+            started(pid);
+        }
+    }
+    for (auto& worker : workers) {
+        if (!send_message(worker.fd, _circuit)) {
+            fail(worker);
+        }
+    }
+
+    Histogram histogram;
+    size_t done = 0;
+    std::vector<pollfd> polled;
+    std::vector<size_t> owners;
+    while (done < nr_shots) {
+        for (auto& worker : workers) {
+            if (!worker.alive || worker.batch > 0 || pending.empty()) {
+                continue;
+            }
+            worker.batch = pending.front();
+            pending.pop_front();
+            std::string request;
+            append(request, worker.batch);
+            if (!send_message(worker.fd, request)) {
+                fail(worker);
+            }
+        }
+        polled.clear();
+        owners.clear();
+        for (size_t i = 0; i < workers.size(); i++) {
+            if (workers[i].alive && workers[i].batch > 0) {
+                polled.push_back({ workers[i].fd, POLLIN, 0 });
+                owners.push_back(i);
+            }
+        }
+        if (polled.empty()) {
+            if (!pending.empty() && std::none_of(workers.begin(), workers.end(),
+                                                 [](const Worker& w) { return w.alive; })) {
+                stop();
+                throw Error("all the workers failed");
+            }
+            continue;
+        }
+        if (poll(polled.data(), polled.size(), -1) < 0 && errno != EINTR) {
+            stop();
+            throw Error(std::string("cannot wait for the workers: ") + std::strerror(errno));
+        }
+        for (size_t k = 0; k < polled.size(); k++) {
+            if (polled[k].revents == 0) {
+                continue;
+            }
+            auto& worker = workers[owners[k]];
+            std::string message;
+            Histogram result;
+            // the histogram of a batch has at most one entry per shot
+            size_t max_size = sizeof(size_t) + worker.batch*(2*sizeof(size_t) + _outcome_size);
+            bool ok = recv_message(worker.fd, message, max_size);
+            if (ok) {
+                try {
+                    result = decode(message);
+                } catch (Error&) {
+                    ok = false;
+                }
+                size_t nr_shots = 0;
+                for (auto& [outcome, count] : result) {
+                    nr_shots += count;
+                }
+                ok = ok && nr_shots == worker.batch;
+            }
+            if (!ok) {
+                fail(worker);
+                continue;
+            }
+            for (auto& [outcome, count] : result) {
+                histogram[outcome] += count;
+            }
+            done += worker.batch;
+            _stats.shots_per_worker[owners[k]] += worker.batch;
+            _stats.nr_batches++;
+            worker.batch = 0;
+        }
+    }
+    stop();
+    return histogram;
+}
+
+}
@@ -0,0 +1,97 @@
+/**
+ * Copyright (c) 2022 Alcides Andrade <andrade.alcides.junior@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef __RUNTIME__SHOT_COORDINATOR_H__
+#define __RUNTIME__SHOT_COORDINATOR_H__
+
+#include <functional>
+#include <map>
+#include <string>
+#include <sys/types.h>
+#include <vector>
+
+#include "circuit.hpp"
+
+namespace runtime {
+
+/**
+ * Runs the shots of a circuit on local worker processes. The circuit is
+ * serialized once and sent to every worker over a Unix domain socket; each
+ * worker compiles it and then runs batches of shots on request.
+ *
+ * Batches are handed out as workers become idle, so faster workers run more
+ * of them. A worker that dies or closes its socket is dropped and its
+ * unfinished batch is given to another worker; `run` only fails if no worker
+ * is left.
+ * */
+class ShotCoordinator {
+public:
+    /**
+     * Number of shots for every outcome. An outcome lists the classical
+     * registers in the order of their names, separated by spaces, each one
+     * written with its bit 0 last.
+     * */
+    using Histogram = std::map<std::string, size_t>;
+
+    struct Stats {
+        size_t nr_batches { 0 };
+        // batches that were run again because their worker died
+        size_t nr_reassigned { 0 };
+        size_t nr_failed_workers { 0 };
+        // shots completed by every worker
+        std::vector<size_t> shots_per_worker;
+    };
+
+    /**
+     * When `nr_workers` is 0 one worker per hardware thread is started
+     * */
+    ShotCoordinator(const Circuit& circuit, size_t nr_workers = 0, size_t batch_size = 64);
+
+    /**
+     * Start the workers, run `nr_shots` shots and stop the workers. If given,
+     * `started` is called with the process id of every worker once it is
+     * running.
+     * */
+    Histogram run(size_t nr_shots, const std::function<void(pid_t)>& started = {});
+
+    inline const Stats& stats() const {
+        return _stats;
+    }
+
+    /**
+     * The outcome of a run with the given classical registers, as a key of
+     * the histogram
+     * */
+    static std::string outcome(const std::map<std::string, std::vector<bool>>& registers);
+
+private:
+    std::string _circuit;
+    // bound on the length of an outcome of the circuit
+    size_t _outcome_size { 0 };
+    size_t _nr_workers;
+    size_t _batch_size;
+    Stats _stats;
+};
+
+}
+
+#endif // __RUNTIME__SHOT_COORDINATOR_H__
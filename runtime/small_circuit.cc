@@ -0,0 +1,275 @@
+/**
+ * Copyright (c) 2022 Alcides Andrade <andrade.alcides.junior@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "small_circuit.hpp"
+
+#include <cmath>
+#include <complex>
+#include <utility>
+
+#include "error.hpp"
+#include "gate.hpp"
+
+namespace runtime {
+
+using math::cx_t;
+
+/**
+ * The gate kernels for a state of `N` qubits, with the qubits acted upon as
+ * template parameters so that the strides are known at compile time.
+ * */
+template <size_t N>
+struct Kernels {
+    static constexpr size_t size = size_t(1) << N;
+    using state_t = std::array<cx_t, size>;
+    using u_kernel_t = void (*)(state_t&, const SmallCircuit::Matrix&);
+    using cx_kernel_t = void (*)(state_t&);
+
+    template <size_t Q>
+    static void apply_u(state_t& state, const SmallCircuit::Matrix& m) {
+        constexpr size_t stride = size_t(1) << Q;
+        // the products are spelled out to avoid the NaN checks of std::complex
+        const float m0r = m[0].real(), m0i = m[0].imag(), m1r = m[1].real(), m1i = m[1].imag();
+        const float m2r = m[2].real(), m2i = m[2].imag(), m3r = m[3].real(), m3i = m[3].imag();
+        for (size_t i = 0; i < size; i += 2*stride) {
+            for (size_t j = i; j < i + stride; j++) {
+                float ar = state[j].real(), ai = state[j].imag();
+                float br = state[j + stride].real(), bi = state[j + stride].imag();
+                state[j] = { m0r*ar - m0i*ai + m1r*br - m1i*bi,
+                             m0r*ai + m0i*ar + m1r*bi + m1i*br };
+                state[j + stride] = { m2r*ar - m2i*ai + m3r*br - m3i*bi,
+                                      m2r*ai + m2i*ar + m3r*bi + m3i*br };
+            }
+        }
+    }
+
+    template <size_t C, size_t T>
+    static void apply_cx(state_t& state) {
+        if constexpr (C != T) {
+            constexpr size_t control = size_t(1) << C;
+            constexpr size_t target = size_t(1) << T;
+            for (size_t i = 0; i < size; i++) {
+                if ((i & control) && !(i & target)) {
+                    std::swap(state[i], state[i | target]);
+                }
+            }
+        }
+    }
+
+    /**
+     * Measure the qubit `qubit`, collapsing the state, and return the outcome
+     * */
+    static bool measure(state_t& state, size_t qubit, float random) {
+        const size_t mask = size_t(1) << qubit;
+        float p0 = 0;
+        float p1 = 0;
+        for (size_t i = 0; i < size; i++) {
+            (i & mask ? p1 : p0) += std::norm(state[i]);
+        }
+        // both probabilities are sums of squares, so neither goes negative on
+        // round-off as `1 - p1` can, and an outcome of probability 0 is never drawn
+        bool outcome = p0 == 0 || (p1 > 0 && random*(p0 + p1) < p1);
+        float norm = 1/std::sqrt(outcome ? p1 : p0);
+        for (size_t i = 0; i < size; i++) {
+            state[i] = (((i & mask) != 0) == outcome) ? state[i]*norm : 0;
+        }
+        return outcome;
+    }
+
+    /**
+     * Swap the |0> and |1> amplitudes of the qubit `qubit`
+     * */
+    static void flip(state_t& state, size_t qubit) {
+        const size_t mask = size_t(1) << qubit;
+        for (size_t i = 0; i < size; i++) {
+            if (!(i & mask)) {
+                std::swap(state[i], state[i | mask]);
+            }
+        }
+    }
+};
+
+/**
+ * `u_table<N>()[q]` applies a 2x2 matrix to the qubit `q` of a state of `N` qubits
+ * */
+template <size_t N, size_t... Q>
+static constexpr auto u_table(std::index_sequence<Q...>) {
+    return std::array<typename Kernels<N>::u_kernel_t, N> { &Kernels<N>::template apply_u<Q>... };
+}
+
+/**
+ * `cx_table<N>()[c*N + t]` applies a controlled not with control `c` and target `t`
+ * */
+template <size_t N, size_t... K>
+static constexpr auto cx_table(std::index_sequence<K...>) {
+    return std::array<typename Kernels<N>::cx_kernel_t, N*N> {
+        &Kernels<N>::template apply_cx<K/N, K%N>...
+    };
+}
+
+bool SmallCircuit::supports(const Circuit& circuit) {
+    size_t nr_bits = 0;
+    for (auto& [_, size] : circuit.classical_registers) {
+        nr_bits += size;
+    }
+    return circuit.nr_qubits > 0 && circuit.nr_qubits <= max_qubits &&
+           nr_bits <= max_classical_bits;
+}
+
+SmallCircuit::SmallCircuit(const Circuit& circuit):
+    _nr_qubits(circuit.nr_qubits), _generator(std::random_device()())
+{
+    if (!supports(circuit)) {
+        throw Error("circuit is too large for the small circuit engine");
+    }
+    size_t offset = 0;
+    for (auto& [name, size] : circuit.classical_registers) {
+        _classical_registers[name] = { offset, size };
+        offset += size;
+    }
+
+    for (auto& operation : circuit.operations) {
+        if (operation.type == Operation::Barrier) {
+            continue;
+        }
+        Instruction instruction {};
+        instruction.type = operation.type;
+        for (size_t i = 0; i < operation.qubits.size() && i < 2; i++) {
+            instruction.qubits[i] = operation.qubits[i];
+        }
+        if (operation.type == Operation::U) {
+            auto& [theta, phi, lambda] = operation.angles;
+            instruction.matrix = _matrices.size();
+            _matrices.emplace_back();
+            if (!theta.is_constant() || !phi.is_constant() || !lambda.is_constant()) {
+                _bound.emplace_back(operation.angles, instruction.matrix);
+            }
+        } else if (operation.type == Operation::Measure) {
+            instruction.bit = _classical_registers.at(operation.creg).first + operation.bit;
+        }
+        if (operation.condition.has_value()) {
+            auto& [creg, value] = operation.condition.value();
+            auto [first, size] = _classical_registers.at(creg);
+            instruction.conditional = true;
+            if (size < 64 && (value >> size) != 0) {
+                // the register can never hold the value
+                instruction.condition_mask = 0;
+                instruction.condition_value = 1;
+            } else {
+                uint64_t mask = size == 64 ? ~uint64_t(0) : (uint64_t(1) << size) - 1;
+                instruction.condition_mask = mask << first;
+                instruction.condition_value = uint64_t(value) << first;
+            }
+        }
+        _instructions.push_back(instruction);
+    }
+
+    // evaluate the constant matrices once, and the others for the default parameters
+    size_t k = 0;
+    for (auto& operation : circuit.operations) {
+        if (operation.type != Operation::U) {
+            continue;
+        }
+        auto& [theta, phi, lambda] = operation.angles;
+        auto mat = Gate::u(theta.evaluate(circuit.parameters),
+                           phi.evaluate(circuit.parameters),
+                           lambda.evaluate(circuit.parameters));
+        _matrices[k++] = { mat(0, 0), mat(0, 1), mat(1, 0), mat(1, 1) };
+    }
+}
+
+void SmallCircuit::bind(const std::vector<double>& parameters) {
+    for (auto& [angles, k] : _bound) {
+        auto& [theta, phi, lambda] = angles;
+        auto mat = Gate::u(theta.evaluate(parameters),
+                           phi.evaluate(parameters),
+                           lambda.evaluate(parameters));
+        _matrices[k] = { mat(0, 0), mat(0, 1), mat(1, 0), mat(1, 1) };
+    }
+}
+
+template <size_t N>
+uint64_t SmallCircuit::run(cx_t* amplitudes) {
+    using K = Kernels<N>;
+    static constexpr auto u_kernels = u_table<N>(std::make_index_sequence<N>());
+    static constexpr auto cx_kernels = cx_table<N>(std::make_index_sequence<N*N>());
+    std::uniform_real_distribution<float> uniform(0, 1);
+    alignas(64) typename K::state_t state {};
+    state[0] = 1;
+    uint64_t bits = 0;
+    for (auto& instruction : _instructions) {
+        if (instruction.conditional &&
+            (bits & instruction.condition_mask) != instruction.condition_value) {
+            continue;
+        }
+        switch (instruction.type) {
+        case Operation::U:
+            u_kernels[instruction.qubits[0]](state, _matrices[instruction.matrix]);
+            break;
+        case Operation::CX:
+            cx_kernels[instruction.qubits[0]*N + instruction.qubits[1]](state);
+            break;
+        case Operation::Measure: {
+            uint64_t outcome = K::measure(state, instruction.qubits[0], uniform(_generator));
+            bits = (bits & ~(uint64_t(1) << instruction.bit)) | (outcome << instruction.bit);
+            break;
+        }
+        case Operation::Reset:
+            if (K::measure(state, instruction.qubits[0], uniform(_generator))) {
+                K::flip(state, instruction.qubits[0]);
+            }
+            break;
+        case Operation::Barrier:
+            break;
+        }
+    }
+    if (amplitudes != nullptr) {
+        std::copy(state.begin(), state.end(), amplitudes);
+    }
+    return bits;
+}
+
+template <size_t... N>
+constexpr std::array<SmallCircuit::run_t, sizeof...(N)>
+SmallCircuit::run_table(std::index_sequence<N...>) {
+    return { &SmallCircuit::run<N + 1>... };
+}
+
+uint64_t SmallCircuit::run(cx_t* amplitudes) {
+    static constexpr auto table = run_table(std::make_index_sequence<max_qubits>());
+    return (this->*table[_nr_qubits - 1])(amplitudes);
+}
+
+std::map<std::string, std::vector<bool>> SmallCircuit::unpack(uint64_t bits) const {
+    std::map<std::string, std::vector<bool>> res;
+    for (auto& [name, position] : _classical_registers) {
+        auto [first, size] = position;
+        auto& creg = res[name];
+        creg.resize(size);
+        for (size_t i = 0; i < size; i++) {
+            creg[i] = (bits >> (first + i)) & 1;
+        }
+    }
+    return res;
+}
+
+}
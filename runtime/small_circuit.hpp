@@ -0,0 +1,128 @@
+/**
+ * Copyright (c) 2022 Alcides Andrade <andrade.alcides.junior@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef __RUNTIME__SMALL_CIRCUIT_H__
+#define __RUNTIME__SMALL_CIRCUIT_H__
+
+#include <array>
+#include <cstdint>
+#include <map>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "circuit.hpp"
+#include "math/types.hpp"
+
+namespace runtime {
+
+/**
+ * An engine for circuits of at most `max_qubits` qubits, where the bookkeeping
+ * of the general runtime costs more than the simulation itself.
+ *
+ * The operations are flattened into fixed-size instructions, the classical
+ * registers are packed into the bits of a single word and the state is a
+ * `std::array` on the stack. The gate kernels are instantiated for every
+ * qubit count and every target qubit, so that all the strides are compile-time
+ * constants, and the instantiation for the width of the circuit is picked
+ * once per run.
+ *
+ * The engine is meant to be reused: `bind` changes the parameters and `run`
+ * executes the circuit once. An instance must not be shared between threads.
+ * */
+class SmallCircuit {
+public:
+    static constexpr size_t max_qubits = 10;
+    static constexpr size_t max_classical_bits = 64;
+
+    using Matrix = std::array<math::cx_t, 4>;
+
+    /**
+     * Whether the circuit is narrow enough to be run by this engine
+     * */
+    static bool supports(const Circuit& circuit);
+
+    /**
+     * Flatten the circuit, binding it to its own parameter values.
+     * Throws `Error` if the circuit is not supported.
+     * */
+    SmallCircuit(const Circuit& circuit);
+
+    inline size_t nr_qubits() const {
+        return _nr_qubits;
+    }
+
+    /**
+     * Re-evaluate the U gates that depend on the circuit parameters
+     * */
+    void bind(const std::vector<double>& parameters);
+
+    /**
+     * Run the circuit once from |0...0> and return the classical bits, where the
+     * bit `i` of the register `c` is the bit `offset(c) + i` of the result.
+     * If `amplitudes` is not null the 2^nr_qubits amplitudes of the final state
+     * are copied into it.
+     * */
+    uint64_t run(math::cx_t* amplitudes = nullptr);
+
+    /**
+     * The classical registers encoded in the result of `run`
+     * */
+    std::map<std::string, std::vector<bool>> unpack(uint64_t bits) const;
+
+private:
+    struct Instruction {
+        Operation::Type type;
+        uint8_t qubits[2];
+        // position of the matrix of a U gate in `_matrices`
+        uint32_t matrix;
+        // bit written by a measure
+        uint8_t bit;
+        bool conditional;
+        // the instruction runs if `(bits & condition_mask) == condition_value`
+        uint64_t condition_mask;
+        uint64_t condition_value;
+    };
+
+    size_t _nr_qubits;
+    std::vector<Instruction> _instructions;
+    std::vector<Matrix> _matrices;
+    // angles and matrix position of the U gates that depend on the parameters
+    std::vector<std::pair<std::array<Angle, 3>, size_t>> _bound;
+    // (first bit, size) of every classical register in the result of `run`
+    std::map<std::string, std::pair<size_t, size_t>> _classical_registers;
+    std::mt19937_64 _generator;
+
+    template <size_t N>
+    uint64_t run(math::cx_t* amplitudes);
+
+    using run_t = uint64_t (SmallCircuit::*)(math::cx_t*);
+
+    // `run<N>` for every N in [1, max_qubits]
+    template <size_t... N>
+    static constexpr std::array<run_t, sizeof...(N)> run_table(std::index_sequence<N...>);
+};
+
+}
+
+#endif // __RUNTIME__SMALL_CIRCUIT_H__
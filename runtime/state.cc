@@ -22,6 +22,7 @@
 
 #include "state.hpp"
 
+#include <algorithm>
 #include <cassert>
 #include <cmath>
 
@@ -29,38 +30,298 @@
 
 namespace runtime {
 
-void State::add_quantum_register(std::string name, size_t size) {
-    assert(size > 0);
-    size_t dim = std::exp2l(size);
-    size_t offset = 0;
-    math::vector_t new_state_registers(dim);
-    new_state_registers[0] = 1.f;
-    if (__builtin_expect(_empty, 0)) {
-        _quantum_state = std::move(new_state_registers);
-        _empty = false;
+State::Factor::Factor(std::vector<size_t> qubits): qubits(qubits), sparse(1) {
+    // a single nonzero entry is already too dense for small factors
+    if (1 > max_sparse_density*size()) {
+        dense = math::vector_t::basis(size(), 0);
+        is_sparse = false;
     } else {
-        _quantum_state = _quantum_state.tensor(new_state_registers);
-        auto last_off_and_size = _quantum_registers.end()->second;
-        offset = std::get<0>(last_off_and_size) + std::get<1>(last_off_and_size);
+        sparse = math::SparseVector(size());
+        sparse.set(0, 1.f);
+    }
+}
+
+void State::Factor::to_dense() {
+    dense = math::vector_t(sparse.size());
+    sparse.for_each([&](size_t index, math::cx_t value) {
+        dense[index] = value;
+    });
+    sparse = math::SparseVector(1);
+    is_sparse = false;
+}
+
+void State::Factor::to_sparse() {
+    sparse = math::SparseVector::from_dense(dense);
+    dense = math::vector_t(1);
+    is_sparse = true;
+}
+
+size_t State::Factor::nr_nonzeros() const {
+    if (is_sparse) {
+        return sparse.nr_nonzeros();
+    }
+    size_t res = 0;
+    for (size_t i = 0; i < dense.size(); i++) {
+        res += std::abs(dense[i]) >= math::SparseVector::tolerance;
+    }
+    return res;
+}
+
+void State::Factor::update_representation() {
+    if (is_sparse) {
+        if (sparse.nr_nonzeros() > max_sparse_density*sparse.size()) {
+            to_dense();
+        }
+        return;
+    }
+    size_t max_nonzeros = max_sparse_density/4*dense.size();
+    size_t nonzeros = 0;
+    for (size_t i = 0; i < dense.size() && nonzeros <= max_nonzeros; i++) {
+        nonzeros += std::abs(dense[i]) >= math::SparseVector::tolerance;
+    }
+    if (nonzeros <= max_nonzeros) {
+        to_sparse();
+    }
+}
+
+void State::Factor::clear() {
+    if (is_sparse) {
+        sparse.clear();
+        sparse.set(0, 1.f);
+    } else {
+        dense.fill(0);
+        dense[0] = 1;
+    }
+}
+
+/**
+ * The bits of the state index `mask` that belong to the factor, moved to
+ * their positions in the index of the factor
+ * */
+static size_t factor_mask(const std::vector<size_t>& qubits, size_t mask) {
+    size_t res = 0;
+    for (size_t k = 0; k < qubits.size(); k++) {
+        res |= ((mask >> qubits[k]) & 1) << k;
+    }
+    return res;
+}
+
+size_t State::merge(size_t a, size_t b) {
+    _declared_layout = false;
+    auto& low = _factors[a];
+    auto& high = _factors[b];
+    size_t shift = low.qubits.size();
+    size_t size = low.size()*high.size();
+    if (low.nr_nonzeros()*high.nr_nonzeros() <= max_sparse_density*size) {
+        // e.g., a wide sparse register and a small register, which starts dense
+        if (!low.is_sparse) {
+            low.to_sparse();
+        }
+        if (!high.is_sparse) {
+            high.to_sparse();
+        }
+        math::SparseVector product(size);
+        high.sparse.for_each([&](size_t i, math::cx_t x) {
+            low.sparse.for_each([&](size_t j, math::cx_t y) {
+                product.set((i << shift) | j, x*y);
+            });
+        });
+        low.sparse = std::move(product);
+    } else {
+        if (low.is_sparse) {
+            low.to_dense();
+        }
+        if (high.is_sparse) {
+            high.to_dense();
+        }
+        // the qubits of `high` take the most significant bits
+        auto product = high.dense.tensor(low.dense);
+        retire(std::move(low.dense));
+        retire(std::move(high.dense));
+        low.dense = std::move(product);
+    }
+    for (auto qubit : high.qubits) {
+        _factor_of[qubit] = a;
+        _position[qubit] = low.qubits.size();
+        low.qubits.push_back(qubit);
+    }
+    low.update_representation();
+    // move the last factor into the place of `b`
+    size_t last = _factors.size() - 1;
+    if (b != last) {
+        std::swap(_factors[b], _factors[last]);
+        for (auto qubit : _factors[b].qubits) {
+            _factor_of[qubit] = b;
+        }
+    }
+    _factors.pop_back();
+    return a == last ? b : a;
+}
+
+void State::add_quantum_register(std::string name, size_t size) {
+    add_quantum_registers({ { name, size } });
+}
+
+void State::add_quantum_registers(const std::vector<std::pair<std::string, size_t>>& registers,
+                                  const std::vector<size_t>& components) {
+    size_t first = _nr_qubits;
+    for (auto& [name, size] : registers) {
+        assert(size > 0);
+        size_t offset = _nr_qubits;
+        for (size_t qubit = offset; qubit < offset + size; qubit++) {
+            _labels.push_back(components.empty() ? offset : components[qubit]);
+        }
+        _nr_qubits += size;
+        _quantum_registers[name] = { offset, size };
+    }
+    std::map<size_t, size_t> group_sizes;
+    for (auto label : _labels) {
+        group_sizes[label]++;
+    }
+    _declared_sizes.clear();
+    for (auto& [label, size] : group_sizes) {
+        _declared_sizes[size_t(1) << size]++;
+    }
+    build_factors(first);
+}
+
+void State::build_factors(size_t first) {
+    // the qubits of every factor by label
+    std::map<size_t, std::vector<size_t>> groups;
+    _factor_of.resize(_nr_qubits);
+    _position.resize(_nr_qubits);
+    for (size_t qubit = first; qubit < _nr_qubits; qubit++) {
+        auto& group = groups[_labels[qubit]];
+        _position[qubit] = group.size();
+        group.push_back(qubit);
+    }
+    _factors.reserve(_factors.size() + groups.size());
+    for (auto& [label, qubits] : groups) {
+        for (auto qubit : qubits) {
+            _factor_of[qubit] = _factors.size();
+        }
+        _factors.emplace_back(qubits);
+        auto& factor = _factors.back();
+        auto spare = std::find_if(_spare.begin(), _spare.end(), [&](const math::vector_t& v) {
+            return v.size() == factor.size();
+        });
+        if (spare != _spare.end()) {
+            factor.dense = std::move(*spare);
+            _spare.erase(spare);
+            factor.dense.fill(0);
+            factor.dense[0] = 1;
+            factor.sparse = math::SparseVector(1);
+            factor.is_sparse = false;
+        }
+    }
+}
+
+void State::retire(math::vector_t&& buffer) {
+    auto declared = _declared_sizes.find(buffer.size());
+    if (declared == _declared_sizes.end()) {
+        return;
+    }
+    size_t nr_spares = std::count_if(_spare.begin(), _spare.end(), [&](const math::vector_t& v) {
+        return v.size() == buffer.size();
+    });
+    if (nr_spares < declared->second) {
+        _spare.push_back(std::move(buffer));
     }
-    _quantum_registers[name] = { offset, size };
 }
 
 void State::add_classical_register(std::string name, size_t size) {
     _classical_registers[name] = std::vector<bool>(size, false);
 }
 
+void State::clear() {
+    if (_declared_layout) {
+        for (auto& factor : _factors) {
+            factor.clear();
+        }
+    } else {
+        for (auto& factor : _factors) {
+            if (!factor.is_sparse) {
+                retire(std::move(factor.dense));
+            }
+        }
+        _factors.clear();
+        build_factors(0);
+        _declared_layout = true;
+    }
+    for (auto& [_, creg] : _classical_registers) {
+        std::fill(creg.begin(), creg.end(), false);
+    }
+}
+
+void State::set_amplitudes(const math::cx_t* amplitudes) {
+    std::vector<size_t> qubits;
+    for (size_t q = 0; q < _nr_qubits; q++) {
+        qubits.push_back(q);
+        _factor_of[q] = 0;
+        _position[q] = q;
+    }
+    _factors.clear();
+    _factors.emplace_back(qubits);
+    _declared_layout = false;
+    auto& factor = _factors[0];
+    if (factor.is_sparse) {
+        factor.to_dense();
+    }
+    std::copy(amplitudes, amplitudes + factor.size(), factor.dense.ptr());
+}
+
 void State::set_classical_register(std::string name, std::vector<bool> value) {
     _classical_registers[name] = value;
 }
 
+void State::project_qubit(size_t qubit) {
+    auto& factor = _factors[_factor_of[qubit]];
+    if (factor.is_sparse) {
+        factor.sparse.reset(_position[qubit], 1);
+    } else {
+        factor.dense.reset(_position[qubit], 1);
+    }
+    split(qubit, false);
+}
+
+void State::split(size_t qubit, bool value) {
+    size_t f = _factor_of[qubit];
+    auto& factor = _factors[f];
+    if (factor.qubits.size() == 1) {
+        return;
+    }
+    size_t position = _position[qubit];
+    if (factor.is_sparse) {
+        factor.sparse = factor.sparse.project(position, value);
+    } else {
+        auto projected = factor.dense.project(position, value);
+        retire(std::move(factor.dense));
+        factor.dense = std::move(projected);
+    }
+    factor.qubits.erase(factor.qubits.begin() + position);
+    for (size_t k = position; k < factor.qubits.size(); k++) {
+        _position[factor.qubits[k]] = k;
+    }
+    factor.update_representation();
+    _factor_of[qubit] = _factors.size();
+    _position[qubit] = 0;
+    _factors.emplace_back(std::vector<size_t>({ qubit }));
+    if (value) {
+        _factors.back().dense[0] = 0;
+        _factors.back().dense[1] = 1;
+    }
+    _declared_layout = false;
+}
+
 void State::reset_quantum_register(std::string name) {
     auto qreg = _quantum_registers.find(name);
     if (qreg == _quantum_registers.end()) {
         throw Error("undefined quantum register `" + name + "`");
     }
     auto [offset, size] = qreg->second;
-    _quantum_state.reset(offset, size);
+    for (size_t i = 0; i < size; i++) {
+        project_qubit(offset + i);
+    }
 }
 
 void State::reset_quantum_register_partial(std::string name, size_t index) {
@@ -69,7 +330,7 @@ void State::reset_quantum_register_partial(std::string name, size_t index) {
         throw Error("undefined quantum register `" + name + "`");
     }
     auto [offset, _] = qreg->second;
-    _quantum_state.reset(offset+index, 1);
+    project_qubit(offset + index);
 }
 
 void State::measure(std::string qreg_name, std::string creg_name) {
@@ -81,7 +342,118 @@ void State::measure(std::string qreg_name, std::string creg_name) {
     if (creg == _classical_registers.end()) {
         throw Error("undefined classical register `" + creg_name + "`");
     }
+    // measuring the qubits one after the other gives the same distribution
+    // as measuring them together, and keeps every measurement in one factor
     auto [offset, size] = qreg->second;
-    _quantum_state.measure(offset, size, creg->second);
+    for (size_t i = 0; i < size; i++) {
+        creg->second[i] = measure_qubit(offset + i);
+    }
+}
+
+void State::apply(const math::unitary_t& gate, const std::vector<size_t>& qubits) {
+    assert(std::all_of(qubits.begin(), qubits.end(), [&](size_t q) { return q < _nr_qubits; }));
+    size_t f = _factor_of[qubits[0]];
+    for (size_t i = 1; i < qubits.size(); i++) {
+        if (_factor_of[qubits[i]] != f) {
+            f = merge(f, _factor_of[qubits[i]]);
+        }
+    }
+    auto& factor = _factors[f];
+    // the qubits keep their positions while there is a single factor
+    bool in_place = true;
+    for (auto qubit : qubits) {
+        in_place = in_place && _position[qubit] == qubit;
+    }
+    std::vector<size_t> positions;
+    if (!in_place) {
+        for (auto qubit : qubits) {
+            positions.push_back(_position[qubit]);
+        }
+    }
+    auto& targets = in_place ? qubits : positions;
+    if (factor.is_sparse) {
+        factor.sparse.apply(gate, targets);
+        factor.update_representation();
+    } else {
+        gate.apply(factor.dense, targets);
+    }
+}
+
+bool State::measure_qubit(size_t qubit) {
+    assert(qubit < _nr_qubits);
+    auto& factor = _factors[_factor_of[qubit]];
+    std::vector<bool> res(1);
+    if (factor.is_sparse) {
+        factor.sparse.measure(_position[qubit], 1, res);
+    } else {
+        factor.dense.measure(_position[qubit], 1, res);
+    }
+    split(qubit, res[0]);
+    return res[0];
+}
+
+void State::reset_qubit(size_t qubit) {
+    if (measure_qubit(qubit)) {
+        // flip the qubit back to |0>
+        apply(Gate::u(M_PI, 0, M_PI), { qubit });
+    }
+}
+
+void State::set_classical_bit(std::string creg_name, size_t index, bool value) {
+    auto creg = _classical_registers.find(creg_name);
+    if (creg == _classical_registers.end()) {
+        throw Error("undefined classical register `" + creg_name + "`");
+    }
+    assert(index < creg->second.size());
+    creg->second[index] = value;
+}
+
+unsigned long State::classical_register_value(std::string creg_name) const {
+    auto creg = _classical_registers.find(creg_name);
+    if (creg == _classical_registers.end()) {
+        throw Error("undefined classical register `" + creg_name + "`");
+    }
+    unsigned long value = 0;
+    for (size_t i = 0; i < creg->second.size(); i++) {
+        value |= (unsigned long)(creg->second[i]) << i;
+    }
+    return value;
+}
+
+double State::expectation(const Observable& observable) const {
+    if (_factors.empty()) {
+        throw Error("cannot compute an expectation value without quantum registers");
+    }
+    // the expectation value of a Pauli string on a product state is the
+    // product of the ones of its restrictions to the factors
+    std::complex<double> value = 0;
+    for (auto& group : observable.group(_quantum_registers)) {
+        std::vector<std::complex<double>> res(group.z_masks.size(), 1);
+        for (auto& factor : _factors) {
+            size_t x_mask = factor_mask(factor.qubits, group.x_mask);
+            std::vector<size_t> z_masks;
+            bool identity = x_mask == 0;
+            for (auto z_mask : group.z_masks) {
+                z_masks.push_back(factor_mask(factor.qubits, z_mask));
+                identity = identity && z_masks.back() == 0;
+            }
+            if (identity) {
+                continue;
+            }
+            std::vector<std::complex<double>> values(z_masks.size());
+            if (factor.is_sparse) {
+                factor.sparse.expectation(x_mask, z_masks, values);
+            } else {
+                factor.dense.expectation(x_mask, z_masks, values);
+            }
+            for (size_t k = 0; k < res.size(); k++) {
+                res[k] *= values[k];
+            }
+        }
+        for (size_t k = 0; k < res.size(); k++) {
+            value += group.weights[k]*res[k];
+        }
+    }
+    return value.real();
 }
-};
+};
\ No newline at end of file
@@ -26,18 +26,79 @@
 
 #include <iostream>
 #include <map>
+#include <string>
+#include <utility>
 #include <vector>
 
 #include "gate.hpp"
+#include "math/sparse_vector.hpp"
 #include "math/unitary.hpp"
+#include "observable.hpp"
 
 namespace runtime {
 
 class State {
 private:
-    bool _empty { true };
-    // holds the tensor product of the 2d vectors for each quantum register
-    math::vector_t _quantum_state { 2 };
+    /**
+     * A group of qubits whose state is kept as one vector, where the bit `k`
+     * of the index is the qubit `qubits[k]` of the whole state.
+     *
+     * While few entries of the factor are nonzero (for example after only
+     * basis permutations), it lives in `sparse` instead and `dense` is left
+     * unallocated. The factor becomes dense once more than
+     * `max_sparse_density` of its entries are nonzero, and sparse again when
+     * a measurement or reset brings that below a quarter of
+     * `max_sparse_density`.
+     * */
+    struct Factor {
+        std::vector<size_t> qubits;
+        bool is_sparse { true };
+        math::vector_t dense { 1 };
+        math::SparseVector sparse { 1 };
+
+        Factor(std::vector<size_t> qubits);
+
+        inline size_t size() const {
+            return size_t(1) << qubits.size();
+        }
+
+        void to_dense();
+        void to_sparse();
+        // entries above the tolerance of the sparse representation
+        size_t nr_nonzeros() const;
+        // switch the representation according to the number of nonzero entries
+        void update_representation();
+        // set the factor to |0...0>
+        void clear();
+    };
+
+    // total number of qubits held by the factors
+    size_t _nr_qubits { 0 };
+    /**
+     * The quantum state is the tensor product of the factors. Every quantum
+     * register starts as a factor of its own, and two factors are merged
+     * when a gate first acts on qubits of both.
+     *
+     * A qubit that is measured or reset is in a basis state, so it is split
+     * off into a factor of its own, halving the factor it leaves. A later
+     * gate coupling it to other qubits merges it back.
+     * */
+    std::vector<Factor> _factors;
+    // index in `_factors` of the factor of every qubit, and its bit there
+    std::vector<size_t> _factor_of;
+    std::vector<size_t> _position;
+    // qubits with the same label form a factor when the state is declared
+    std::vector<size_t> _labels;
+    // whether the factors still are the ones given by `_labels`
+    bool _declared_layout { true };
+    // number of declared factors of every size
+    std::map<size_t, size_t> _declared_sizes;
+    /**
+     * Dense buffers of the sizes of declared factors, given up by merges and
+     * splits, from which `clear` rebuilds the declared factors instead of
+     * allocating them again. At most one is kept per declared factor.
+     * */
+    std::vector<math::vector_t> _spare;
     /**
      * Track the postion and offset of all the named quantum registers.
      * For example, for register definitions
@@ -47,20 +108,65 @@ private:
      * we obtain a register map
      *     {
      *         a: (0, 2),
-     *         c: (2, 4),
-     *         a: (6, 1),
+     *         b: (2, 4),
+     *         c: (6, 1),
      *     }
+     * where the offset of a qubit is its position in the whole state.
      * */
     std::map<std::string, std::tuple<size_t, size_t>> _quantum_registers;
     // keep the values of the classical registers
     std::map<std::string, std::vector<bool>> _classical_registers;
 
+    /**
+     * Merge the factor `b` into the factor `a`, whose index is returned as
+     * removing `b` may move it. The product is kept sparse whenever it has
+     * few enough nonzero entries, whatever the representation of either side.
+     * */
+    size_t merge(size_t a, size_t b);
+
+    // project the qubit onto |0> and renormalize
+    void project_qubit(size_t qubit);
+
+    // move a qubit known to be |value> out of its factor
+    void split(size_t qubit, bool value);
+
+    // create the factors given by `_labels` for the qubits from `first` on
+    void build_factors(size_t first);
+
+    // keep a dense buffer that is no longer used in `_spare` if it fits a declared factor
+    void retire(math::vector_t&& buffer);
+
 public:
+    static constexpr double max_sparse_density = 1./64;
+
     void add_quantum_register(std::string name, size_t size);
+
+    /**
+     * Declare the quantum registers in one pass, creating every factor at
+     * once instead of merging registers as the gates couple them.
+     * `components` gives for every qubit the label of the group of qubits
+     * that will end up in the same factor (see `Circuit::components`);
+     * when empty every register is a factor of its own.
+     * */
+    void add_quantum_registers(const std::vector<std::pair<std::string, size_t>>& registers,
+                               const std::vector<size_t>& components = {});
     void add_classical_register(std::string name, size_t size);
 
+    /**
+     * Bring the quantum state back to |0...0> and set every classical bit to zero,
+     * keeping the registers. The factors are reset in place, unless gates or
+     * measurements changed them since the registers were declared; they are
+     * then rebuilt, reusing the dense buffers of the previous factors.
+     * */
+    void clear();
+
     void set_classical_register(std::string name, std::vector<bool> value);
 
+    /**
+     * Overwrite the quantum state with the 2^nr_qubits entries of `amplitudes`
+     * */
+    void set_amplitudes(const math::cx_t* amplitudes);
+
     /**
      * Set to zero the qubits in a given quantum register
      * */
@@ -76,12 +182,79 @@ public:
      * */
     void measure(std::string qreg, std::string creg);
 
+    /**
+     * Apply the matrix `gate` to the qubits at the positions `qubits`
+     * of the state vector (see `math::Unitary::apply`).
+     * */
+    void apply(const math::unitary_t& gate, const std::vector<size_t>& qubits);
+
+    /**
+     * Measure the qubit at position `qubit`, collapsing the state, and
+     * return the outcome.
+     * */
+    bool measure_qubit(size_t qubit);
+
+    /**
+     * Set the qubit at position `qubit` to |0>
+     * */
+    void reset_qubit(size_t qubit);
+
+    void set_classical_bit(std::string creg, size_t index, bool value);
+
+    /**
+     * The value of a classical register read as an unsigned integer whose
+     * least significant bit is the bit 0 of the register.
+     * */
+    unsigned long classical_register_value(std::string creg) const;
+
+    inline const std::map<std::string, std::vector<bool>>& classical_registers() const {
+        return _classical_registers;
+    }
+
+    /**
+     * Compute the expectation value <psi|O|psi> of the observable `O` on the
+     * current quantum state without collapsing it.
+     * Pauli strings that flip the same qubits are evaluated together in a
+     * single pass over the state vector.
+     * */
+    double expectation(const Observable& observable) const;
+
+    /**
+     * Whether every factor that is large enough to be stored sparsely is
+     * */
+    inline bool is_sparse() const {
+        for (auto& factor : _factors) {
+            if (!factor.is_sparse && max_sparse_density*factor.size() >= 1) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    /**
+     * The number of independent factors of the quantum state
+     * */
+    inline size_t nr_factors() const {
+        return _factors.size();
+    }
+
     friend std::ostream& operator<<(std::ostream& os, const State& state) {
         os << "    | " << state._quantum_registers.size() << " quantum register(s)\n";
         for (auto& qreg : state._quantum_registers) {
             os << "    | " << qreg.first <<  "[" << std::get<1>(qreg.second) << "]\n";
         }
-        os << "    | " << state._quantum_state << "\n";
+        for (auto& factor : state._factors) {
+            os << "    | qubits { ";
+            for (auto qubit : factor.qubits) {
+                os << qubit << ", ";
+            }
+            os << "}: ";
+            if (factor.is_sparse) {
+                os << factor.sparse << "\n";
+            } else {
+                os << factor.dense << "\n";
+            }
+        }
         os << "    + \n"; 
         os << "    | " << state._classical_registers.size() << " classical register(s)\n"; 
         for (auto& creg : state._classical_registers) {
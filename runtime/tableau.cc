@@ -0,0 +1,260 @@
+/**
+ * Copyright (c) 2022 Alcides Andrade <andrade.alcides.junior@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "tableau.hpp"
+
+#include <cmath>
+
+#include "error.hpp"
+
+namespace runtime {
+
+/**
+ * Multiply the Pauli string (hx, hz, h_sign) on the left by (ix, iz, i_sign)
+ * and return the sign of the product. The phase is the sum of the function g
+ * of Aaronson and Gottesman over all qubits, which is counted 64 qubits at a
+ * time: `plus` and `minus` mark the qubits where g is +1 and -1.
+ * */
+static uint8_t multiply(uint64_t* hx, uint64_t* hz, uint8_t h_sign,
+                        const uint64_t* ix, const uint64_t* iz, uint8_t i_sign,
+                        size_t words)
+{
+    long phase = 2*h_sign + 2*i_sign;
+    for (size_t w = 0; w < words; w++) {
+        uint64_t x1 = ix[w], z1 = iz[w], x2 = hx[w], z2 = hz[w];
+        uint64_t y = x1 & z1, x = x1 & ~z1, z = ~x1 & z1;
+        uint64_t plus = (y & z2 & ~x2) | (x & z2 & x2) | (z & x2 & ~z2);
+        uint64_t minus = (y & x2 & ~z2) | (x & z2 & ~x2) | (z & x2 & z2);
+        phase += __builtin_popcountll(plus) - __builtin_popcountll(minus);
+        hx[w] = x1 ^ x2;
+        hz[w] = z1 ^ z2;
+    }
+    // the product of commuting strings has a phase of +1 or -1
+    return ((phase % 4) + 4) % 4 == 2;
+}
+
+Tableau::Tableau(size_t nr_qubits):
+    _nr_qubits(nr_qubits),
+    _words((nr_qubits + 63)/64),
+    _rows(2*(2*nr_qubits + 1)*_words),
+    _signs(2*nr_qubits + 1),
+    _generator(std::random_device()())
+{
+    // |0...0> is stabilized by Z_i, with X_i as the destabilizers
+    for (size_t i = 0; i < nr_qubits; i++) {
+        xs(i)[i/64] |= uint64_t(1) << (i%64);
+        zs(nr_qubits + i)[i/64] |= uint64_t(1) << (i%64);
+    }
+}
+
+std::optional<std::array<unsigned, 3>> Tableau::quarter_turns(
+    const Operation& operation, const std::vector<double>& parameters)
+{
+    std::array<unsigned, 3> res;
+    for (size_t k = 0; k < 3; k++) {
+        double turns = operation.angles[k].evaluate(parameters)/(M_PI/2);
+        double rounded = std::round(turns);
+        if (std::abs(turns - rounded) > 1e-6) {
+            return std::nullopt;
+        }
+        res[k] = ((long(rounded) % 4) + 4) % 4;
+    }
+    return res;
+}
+
+bool Tableau::supports(const Circuit& circuit) {
+    for (auto& operation : circuit.operations) {
+        if (operation.type == Operation::U &&
+            !quarter_turns(operation, circuit.parameters).has_value()) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool Tableau::supports(const lang::Program& program) {
+    return supports(Circuit::compile(program));
+}
+
+void Tableau::h(size_t qubit) {
+    size_t w = qubit/64;
+    uint64_t mask = uint64_t(1) << (qubit%64);
+    for (size_t row = 0; row < 2*_nr_qubits; row++) {
+        uint64_t& x = xs(row)[w];
+        uint64_t& z = zs(row)[w];
+        _signs[row] ^= (x & z & mask) != 0;
+        uint64_t flip = (x ^ z) & mask;
+        x ^= flip;
+        z ^= flip;
+    }
+}
+
+void Tableau::s(size_t qubit) {
+    size_t w = qubit/64;
+    uint64_t mask = uint64_t(1) << (qubit%64);
+    for (size_t row = 0; row < 2*_nr_qubits; row++) {
+        uint64_t x = xs(row)[w];
+        uint64_t& z = zs(row)[w];
+        _signs[row] ^= (x & z & mask) != 0;
+        z ^= x & mask;
+    }
+}
+
+void Tableau::x(size_t qubit) {
+    size_t w = qubit/64;
+    uint64_t mask = uint64_t(1) << (qubit%64);
+    for (size_t row = 0; row < 2*_nr_qubits; row++) {
+        _signs[row] ^= (zs(row)[w] & mask) != 0;
+    }
+}
+
+void Tableau::cx(size_t control, size_t target) {
+    for (size_t row = 0; row < 2*_nr_qubits; row++) {
+        uint64_t* x = xs(row);
+        uint64_t* z = zs(row);
+        bool xc = bit(x, control), zc = bit(z, control);
+        bool xt = bit(x, target), zt = bit(z, target);
+        _signs[row] ^= xc && zt && (xt == zc);
+        x[target/64] ^= uint64_t(xc) << (target%64);
+        z[control/64] ^= uint64_t(zt) << (control%64);
+    }
+}
+
+void Tableau::apply(const Operation& operation, const std::vector<double>& parameters) {
+    if (operation.type == Operation::CX) {
+        cx(operation.qubits[0], operation.qubits[1]);
+        return;
+    }
+    auto turns = quarter_turns(operation, parameters);
+    if (!turns.has_value()) {
+        throw Error("U gate at line " + std::to_string(operation.line) +
+                    " is not a Clifford gate");
+    }
+    // U(theta, phi, lambda) = Rz(phi) Ry(theta) Rz(lambda) up to a global phase,
+    // where Rz(pi/2) is S and Ry(pi/2) is H followed by X
+    auto [theta, phi, lambda] = turns.value();
+    size_t qubit = operation.qubits[0];
+    for (unsigned k = 0; k < lambda; k++) {
+        s(qubit);
+    }
+    for (unsigned k = 0; k < theta; k++) {
+        h(qubit);
+        x(qubit);
+    }
+    for (unsigned k = 0; k < phi; k++) {
+        s(qubit);
+    }
+}
+
+void Tableau::rowsum(size_t h, size_t i) {
+    _signs[h] = multiply(xs(h), zs(h), _signs[h], xs(i), zs(i), _signs[i], _words);
+}
+
+bool Tableau::measure(size_t qubit) {
+    size_t n = _nr_qubits;
+    size_t p = n;
+    while (p < 2*n && !bit(xs(p), qubit)) {
+        p++;
+    }
+    if (p < 2*n) {
+        // some stabilizer anticommutes with Z: the outcome is random
+        for (size_t row = 0; row < 2*n; row++) {
+            if (row != p && bit(xs(row), qubit)) {
+                rowsum(row, p);
+            }
+        }
+        std::copy(xs(p), xs(p) + 2*_words, xs(p - n));
+        _signs[p - n] = _signs[p];
+        std::fill(xs(p), xs(p) + 2*_words, 0);
+        zs(p)[qubit/64] |= uint64_t(1) << (qubit%64);
+        _signs[p] = std::uniform_int_distribution<int>(0, 1)(_generator);
+        return _signs[p];
+    }
+    // Z is in the stabilizer group: build it in the scratch row
+    size_t scratch = 2*n;
+    std::fill(xs(scratch), xs(scratch) + 2*_words, 0);
+    _signs[scratch] = 0;
+    for (size_t i = 0; i < n; i++) {
+        if (bit(xs(i), qubit)) {
+            rowsum(scratch, i + n);
+        }
+    }
+    return _signs[scratch];
+}
+
+void Tableau::reset(size_t qubit) {
+    if (measure(qubit)) {
+        x(qubit);
+    }
+}
+
+double Tableau::expectation(const Observable& observable,
+                            const std::map<std::string, std::tuple<size_t, size_t>>& qregs) const
+{
+    size_t n = _nr_qubits;
+    double res = 0;
+    std::vector<uint64_t> pauli(2*_words), product(2*_words);
+    for (auto& term : observable.terms()) {
+        std::fill(pauli.begin(), pauli.end(), 0);
+        for (auto& p : term.paulis) {
+            size_t qubit = Observable::qubit(p, qregs);
+            uint64_t mask = uint64_t(1) << (qubit%64);
+            if (p.op == 'X' || p.op == 'Y') {
+                pauli[qubit/64] |= mask;
+            }
+            if (p.op == 'Z' || p.op == 'Y') {
+                pauli[_words + qubit/64] |= mask;
+            }
+        }
+
+        // two strings anticommute when their symplectic product is odd
+        auto anticommutes = [&](size_t row) {
+            size_t count = 0;
+            for (size_t w = 0; w < _words; w++) {
+                count += __builtin_popcountll(pauli[w] & zs(row)[w]);
+                count += __builtin_popcountll(pauli[_words + w] & xs(row)[w]);
+            }
+            return count % 2 == 1;
+        };
+        bool in_group = true;
+        for (size_t i = n; i < 2*n && in_group; i++) {
+            in_group = !anticommutes(i);
+        }
+        if (!in_group) {
+            continue;
+        }
+        // the string is the product of the stabilizers paired with the
+        // destabilizers it anticommutes with
+        std::fill(product.begin(), product.end(), 0);
+        uint8_t sign = 0;
+        for (size_t i = 0; i < n; i++) {
+            if (anticommutes(i)) {
+                sign = multiply(product.data(), product.data() + _words, sign,
+                                xs(i + n), zs(i + n), _signs[i + n], _words);
+            }
+        }
+        res += sign ? -term.coefficient : term.coefficient;
+    }
+    return res;
+}
+
+}
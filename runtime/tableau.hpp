@@ -0,0 +1,140 @@
+/**
+ * Copyright (c) 2022 Alcides Andrade <andrade.alcides.junior@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef __RUNTIME__TABLEAU_H__
+#define __RUNTIME__TABLEAU_H__
+
+#include <array>
+#include <cstdint>
+#include <map>
+#include <optional>
+#include <random>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include "circuit.hpp"
+#include "lang/program.hpp"
+#include "observable.hpp"
+
+namespace runtime {
+
+/**
+ * A stabilizer state kept as the tableau of Aaronson and Gottesman
+ * ("Improved simulation of stabilizer circuits", 2004), which simulates
+ * circuits made only of Clifford gates in polynomial time and memory.
+ *
+ * The tableau has 2n + 1 rows: the destabilizers, the stabilizers and a scratch
+ * row. Each row is a Pauli string stored as its x bits followed by its z bits,
+ * packed 64 qubits per word, plus a sign bit. A gate updates one bit of every
+ * row, and multiplying two rows touches whole words, so a measurement costs
+ * O(n^2/64) word operations.
+ * */
+class Tableau {
+public:
+    Tableau(size_t nr_qubits);
+
+    /**
+     * Whether every U gate of the circuit is a Clifford gate, i.e., all of
+     * its angles are multiples of pi/2 for the parameters of the circuit.
+     * */
+    static bool supports(const Circuit& circuit);
+    static bool supports(const lang::Program& program);
+
+    /**
+     * The angles of the U gate `operation` as a number of quarter turns
+     * modulo 4, or nothing if some angle is not a multiple of pi/2.
+     * */
+    static std::optional<std::array<unsigned, 3>> quarter_turns(
+        const Operation& operation, const std::vector<double>& parameters);
+
+    inline size_t nr_qubits() const {
+        return _nr_qubits;
+    }
+
+    void h(size_t qubit);
+    void s(size_t qubit);
+    void x(size_t qubit);
+    void cx(size_t control, size_t target);
+
+    /**
+     * Apply a U or CX operation, whose angles must be multiples of pi/2
+     * */
+    void apply(const Operation& operation, const std::vector<double>& parameters);
+
+    /**
+     * Measure the qubit `qubit` in the computational basis, collapsing the
+     * state, and return the outcome.
+     * */
+    bool measure(size_t qubit);
+
+    /**
+     * Set the qubit `qubit` to |0>
+     * */
+    void reset(size_t qubit);
+
+    /**
+     * The expectation value of the observable, where each Pauli string
+     * contributes +1, -1 or 0 times its coefficient. `qregs` has the same
+     * layout as the one kept by `State`.
+     * */
+    double expectation(const Observable& observable,
+                       const std::map<std::string, std::tuple<size_t, size_t>>& qregs) const;
+
+private:
+    size_t _nr_qubits;
+    // words per half row
+    size_t _words;
+    // the x words of row i start at 2*i*_words, followed by its z words
+    std::vector<uint64_t> _rows;
+    std::vector<uint8_t> _signs;
+    std::mt19937_64 _generator;
+
+    inline uint64_t* xs(size_t row) {
+        return &_rows[2*row*_words];
+    }
+
+    inline uint64_t* zs(size_t row) {
+        return &_rows[(2*row + 1)*_words];
+    }
+
+    inline const uint64_t* xs(size_t row) const {
+        return &_rows[2*row*_words];
+    }
+
+    inline const uint64_t* zs(size_t row) const {
+        return &_rows[(2*row + 1)*_words];
+    }
+
+    static inline bool bit(const uint64_t* words, size_t qubit) {
+        return (words[qubit/64] >> (qubit%64)) & 1;
+    }
+
+    /**
+     * Left-multiply the row `h` by the row `i`
+     * */
+    void rowsum(size_t h, size_t i);
+};
+
+}
+
+#endif // __RUNTIME__TABLEAU_H__
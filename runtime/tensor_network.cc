@@ -0,0 +1,370 @@
+/**
+ * Copyright (c) 2022 Alcides Andrade <andrade.alcides.junior@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "tensor_network.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <map>
+#include <mutex>
+#include <thread>
+
+#include "error.hpp"
+#include "gate.hpp"
+
+namespace runtime {
+
+using math::cx_t;
+
+TensorNetwork::TensorNetwork(const lang::Program& program, size_t max_tensor_size,
+                             size_t nr_threads):
+    TensorNetwork(Circuit::compile(program), max_tensor_size, nr_threads)
+{}
+
+TensorNetwork::TensorNetwork(const Circuit& circuit, size_t max_tensor_size, size_t nr_threads):
+    _nr_qubits(circuit.nr_qubits),
+    _nr_threads(nr_threads == 0 ? std::max(1u, std::thread::hardware_concurrency()) : nr_threads)
+{
+    size_t next_index = 0;
+    std::vector<size_t> wire(_nr_qubits);
+    for (size_t q = 0; q < _nr_qubits; q++) {
+        wire[q] = next_index++;
+        _tensors.push_back({ { wire[q] }, { 1, 0 } });
+    }
+    for (auto& operation : circuit.operations) {
+        if (operation.condition.has_value() ||
+            operation.type == Operation::Measure || operation.type == Operation::Reset) {
+            throw Error("tensor networks only support unitary circuits (line " +
+                        std::to_string(operation.line) + ")");
+        }
+        if (operation.type == Operation::U) {
+            auto& [theta, phi, lambda] = operation.angles;
+            auto m = Gate::u(theta.evaluate(circuit.parameters),
+                             phi.evaluate(circuit.parameters),
+                             lambda.evaluate(circuit.parameters));
+            size_t q = operation.qubits[0];
+            size_t out = next_index++;
+            _tensors.push_back({ { out, wire[q] }, { m(0, 0), m(0, 1), m(1, 0), m(1, 1) } });
+            wire[q] = out;
+        } else if (operation.type == Operation::CX) {
+            size_t c = operation.qubits[0], t = operation.qubits[1];
+            Tensor tensor { { next_index, next_index + 1, wire[c], wire[t] }, {} };
+            for (size_t r = 0; r < 4; r++) {
+                for (size_t k = 0; k < 4; k++) {
+                    tensor.data.push_back(Gate::cx()(r, k));
+                }
+            }
+            wire[c] = next_index++;
+            wire[t] = next_index++;
+            _tensors.push_back(std::move(tensor));
+        }
+    }
+    _first_output = _tensors.size();
+    for (size_t q = 0; q < _nr_qubits; q++) {
+        _tensors.push_back({ { wire[q] }, { 1, 0 } });
+    }
+    plan(max_tensor_size);
+}
+
+void TensorNetwork::plan(size_t max_tensor_size) {
+    size_t nr_tensors = _tensors.size();
+    std::vector<std::vector<size_t>> sets;
+    std::map<size_t, std::vector<size_t>> holders;
+    std::vector<bool> alive(nr_tensors, true);
+    for (size_t i = 0; i < nr_tensors; i++) {
+        sets.push_back(_tensors[i].indices);
+        for (auto index : _tensors[i].indices) {
+            holders[index].push_back(i);
+        }
+    }
+    auto merged = [&](size_t a, size_t b) {
+        std::vector<size_t> res;
+        for (auto index : sets[a]) {
+            if (std::find(sets[b].begin(), sets[b].end(), index) == sets[b].end()) {
+                res.push_back(index);
+            }
+        }
+        for (auto index : sets[b]) {
+            if (std::find(sets[a].begin(), sets[a].end(), index) == sets[a].end()) {
+                res.push_back(index);
+            }
+        }
+        return res;
+    };
+
+    for (size_t step = 0; step + 1 < nr_tensors; step++) {
+        // greedy: the connected pair that grows the network the least
+        std::pair<size_t, size_t> best;
+        bool found = false;
+        double best_score = 0;
+        size_t best_size = 0;
+        for (auto& [_, ids] : holders) {
+            if (ids.size() != 2) {
+                continue;
+            }
+            size_t a = ids[0], b = ids[1];
+            size_t size = merged(a, b).size();
+            double score = std::exp2(size) - std::exp2(sets[a].size()) - std::exp2(sets[b].size());
+            if (!found || score < best_score || (score == best_score && size < best_size)) {
+                best = { a, b };
+                best_score = score;
+                best_size = size;
+                found = true;
+            }
+        }
+        if (!found) {
+            // disconnected parts: join the two smallest tensors
+            std::vector<size_t> ids;
+            for (size_t i = 0; i < alive.size(); i++) {
+                if (alive[i]) {
+                    ids.push_back(i);
+                }
+            }
+            std::partial_sort(ids.begin(), ids.begin() + 2, ids.end(), [&](size_t i, size_t j) {
+                return sets[i].size() < sets[j].size();
+            });
+            best = { ids[0], ids[1] };
+        }
+
+        auto [a, b] = best;
+        size_t id = sets.size();
+        sets.push_back(merged(a, b));
+        alive.push_back(true);
+        alive[a] = alive[b] = false;
+        for (auto old : { a, b }) {
+            for (auto index : sets[old]) {
+                auto& ids = holders[index];
+                ids.erase(std::remove(ids.begin(), ids.end(), old), ids.end());
+                if (ids.empty()) {
+                    holders.erase(index);
+                }
+            }
+        }
+        for (auto index : sets[id]) {
+            holders[index].push_back(id);
+        }
+        _steps.push_back(best);
+    }
+
+    // slice the indices found in most of the largest tensors until they fit
+    auto unsliced = [&](const std::vector<size_t>& set) {
+        size_t res = 0;
+        for (auto index : set) {
+            res += std::find(_sliced.begin(), _sliced.end(), index) == _sliced.end();
+        }
+        return res;
+    };
+    size_t max_rank = std::floor(std::log2(std::max(size_t(1), max_tensor_size)));
+    while (true) {
+        size_t peak = 0;
+        for (auto& set : sets) {
+            peak = std::max(peak, unsliced(set));
+        }
+        if (peak <= max_rank) {
+            _stats.peak_size = size_t(1) << peak;
+            break;
+        }
+        std::map<size_t, size_t> count;
+        for (auto& set : sets) {
+            if (unsliced(set) == peak) {
+                for (auto index : set) {
+                    if (std::find(_sliced.begin(), _sliced.end(), index) == _sliced.end()) {
+                        count[index]++;
+                    }
+                }
+            }
+        }
+        auto index = std::max_element(count.begin(), count.end(), [](auto& x, auto& y) {
+            return x.second < y.second;
+        });
+        _sliced.push_back(index->first);
+    }
+
+    _stats.nr_tensors = nr_tensors;
+    _stats.nr_slices = size_t(1) << _sliced.size();
+    _stats.flops = 0;
+    for (auto [a, b] : _steps) {
+        std::vector<size_t> all = sets[a];
+        all.insert(all.end(), sets[b].begin(), sets[b].end());
+        std::sort(all.begin(), all.end());
+        all.erase(std::unique(all.begin(), all.end()), all.end());
+        _stats.flops += std::exp2(unsliced(all))*_stats.nr_slices;
+    }
+}
+
+/**
+ * Reorder the indices of a tensor so that its index `k` is the index
+ * `order[k]` of `data`
+ * */
+static std::vector<cx_t> permute(const std::vector<cx_t>& data, size_t rank,
+                                 const std::vector<size_t>& order)
+{
+    bool identity = true;
+    for (size_t k = 0; k < rank; k++) {
+        identity = identity && order[k] == k;
+    }
+    if (identity) {
+        return data;
+    }
+    std::vector<cx_t> res(data.size());
+    for (size_t i = 0; i < data.size(); i++) {
+        size_t old = 0;
+        for (size_t k = 0; k < rank; k++) {
+            size_t bit = (i >> (rank - 1 - k)) & 1;
+            old |= bit << (rank - 1 - order[k]);
+        }
+        res[i] = data[old];
+    }
+    return res;
+}
+
+TensorNetwork::Tensor TensorNetwork::contract(const Tensor& a, const Tensor& b) {
+    std::vector<size_t> a_order, b_order, shared_a, shared_b;
+    Tensor res;
+    for (size_t k = 0; k < a.indices.size(); k++) {
+        auto it = std::find(b.indices.begin(), b.indices.end(), a.indices[k]);
+        if (it == b.indices.end()) {
+            a_order.push_back(k);
+            res.indices.push_back(a.indices[k]);
+        } else {
+            shared_a.push_back(k);
+            shared_b.push_back(it - b.indices.begin());
+        }
+    }
+    b_order = shared_b;
+    for (size_t k = 0; k < b.indices.size(); k++) {
+        if (std::find(shared_b.begin(), shared_b.end(), k) == shared_b.end()) {
+            b_order.push_back(k);
+            res.indices.push_back(b.indices[k]);
+        }
+    }
+    a_order.insert(a_order.end(), shared_a.begin(), shared_a.end());
+
+    // C[m x n] = A[m x k] B[k x n] over the shared indices
+    auto lhs = permute(a.data, a.indices.size(), a_order);
+    auto rhs = permute(b.data, b.indices.size(), b_order);
+    size_t k = size_t(1) << shared_a.size();
+    size_t m = lhs.size()/k;
+    size_t n = rhs.size()/k;
+    res.data.assign(m*n, 0);
+    for (size_t i = 0; i < m; i++) {
+        cx_t* out = &res.data[i*n];
+        for (size_t l = 0; l < k; l++) {
+            cx_t x = lhs[i*k + l];
+            if (x == 0.f) {
+                continue;
+            }
+            const cx_t* row = &rhs[l*n];
+            for (size_t j = 0; j < n; j++) {
+                out[j] += x*row[j];
+            }
+        }
+    }
+    return res;
+}
+
+/**
+ * Fix the index at position `position` of a tensor to `value`
+ * */
+static std::vector<cx_t> select(const std::vector<cx_t>& data, size_t rank,
+                                size_t position, bool value)
+{
+    size_t low = size_t(1) << (rank - 1 - position);
+    std::vector<cx_t> res;
+    res.reserve(data.size()/2);
+    for (size_t i = 0; i < data.size(); i++) {
+        if (bool(i & low) == value) {
+            res.push_back(data[i]);
+        }
+    }
+    return res;
+}
+
+cx_t TensorNetwork::contract(const std::vector<Tensor>& tensors, size_t slice) const {
+    if (tensors.empty()) {
+        // the empty product, e.g., the amplitude of a circuit without qubits
+        return 1;
+    }
+    std::vector<Tensor> pool = tensors;
+    for (size_t s = 0; s < _sliced.size(); s++) {
+        bool value = (slice >> s) & 1;
+        for (auto& tensor : pool) {
+            auto it = std::find(tensor.indices.begin(), tensor.indices.end(), _sliced[s]);
+            if (it != tensor.indices.end()) {
+                tensor.data = select(tensor.data, tensor.indices.size(),
+                                     it - tensor.indices.begin(), value);
+                tensor.indices.erase(it);
+            }
+        }
+    }
+    for (auto [a, b] : _steps) {
+        pool.push_back(contract(pool[a], pool[b]));
+        pool[a] = Tensor();
+        pool[b] = Tensor();
+    }
+    return pool.back().data[0];
+}
+
+cx_t TensorNetwork::amplitude(const std::vector<bool>& bits) const {
+    if (bits.size() != _nr_qubits) {
+        throw Error("expected " + std::to_string(_nr_qubits) + " bits, but " +
+                    std::to_string(bits.size()) + " were passed");
+    }
+    auto tensors = _tensors;
+    for (size_t q = 0; q < _nr_qubits; q++) {
+        tensors[_first_output + q].data = { cx_t(!bits[q]), cx_t(bits[q]) };
+    }
+
+    size_t nr_slices = _stats.nr_slices;
+    size_t nr_threads = std::min(_nr_threads, nr_slices);
+    std::atomic<size_t> next { 0 };
+    std::mutex mutex;
+    cx_t res = 0;
+    auto worker = [&]() {
+        cx_t sum = 0;
+        for (size_t slice = next++; slice < nr_slices; slice = next++) {
+            sum += contract(tensors, slice);
+        }
+        std::lock_guard<std::mutex> lock(mutex);
+        res += sum;
+    };
+    std::vector<std::thread> threads;
+    for (size_t t = 1; t < nr_threads; t++) {
+        threads.emplace_back(worker);
+    }
+    worker();
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    return res;
+}
+
+std::vector<cx_t> TensorNetwork::amplitudes(const std::vector<std::vector<bool>>& bits) const {
+    std::vector<cx_t> res;
+    for (auto& b : bits) {
+        res.push_back(amplitude(b));
+    }
+    return res;
+}
+
+}
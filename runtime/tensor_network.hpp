@@ -0,0 +1,109 @@
+/**
+ * Copyright (c) 2022 Alcides Andrade <andrade.alcides.junior@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef __RUNTIME__TENSOR_NETWORK_H__
+#define __RUNTIME__TENSOR_NETWORK_H__
+
+#include <complex>
+#include <utility>
+#include <vector>
+
+#include "circuit.hpp"
+#include "lang/program.hpp"
+#include "math/types.hpp"
+
+namespace runtime {
+
+/**
+ * A unitary circuit as a network of tensors, used to compute single amplitudes
+ * <x|C|0...0> of circuits that are too wide for the state vector but shallow
+ * enough for the network to be contracted.
+ *
+ * Every qubit starts with a |0> tensor, every gate is a tensor joining the wires
+ * of its qubits and every wire ends with a <x_k| tensor. The contraction order
+ * is found once, greedily, by always contracting the pair of connected tensors
+ * that grows the network the least. When an intermediate tensor would exceed
+ * `max_tensor_size` entries, some indices are sliced: the network is contracted
+ * once for each value of the sliced indices, in parallel, and the results added.
+ * */
+class TensorNetwork {
+public:
+    struct Stats {
+        size_t nr_tensors;
+        // entries of the largest intermediate tensor of a slice
+        size_t peak_size;
+        size_t nr_slices;
+        // complex multiply-adds over all the slices
+        double flops;
+    };
+
+    /**
+     * Build the network of a circuit, which must not measure, reset or have
+     * conditions. When `nr_threads` is 0 one thread per hardware thread is used.
+     * */
+    TensorNetwork(const Circuit& circuit, size_t max_tensor_size = size_t(1) << 24,
+                  size_t nr_threads = 0);
+    TensorNetwork(const lang::Program& program, size_t max_tensor_size = size_t(1) << 24,
+                  size_t nr_threads = 0);
+
+    /**
+     * The amplitude of the basis state whose bit k is the value of the qubit k
+     * */
+    math::cx_t amplitude(const std::vector<bool>& bits) const;
+
+    std::vector<math::cx_t> amplitudes(const std::vector<std::vector<bool>>& bits) const;
+
+    inline const Stats& stats() const {
+        return _stats;
+    }
+
+private:
+    /**
+     * A tensor whose indices all have dimension 2, stored row-major with the
+     * first index as the most significant one.
+     * */
+    struct Tensor {
+        std::vector<size_t> indices;
+        std::vector<math::cx_t> data;
+    };
+
+    size_t _nr_qubits;
+    size_t _nr_threads;
+    // the input and gate tensors, followed by one output tensor per qubit
+    std::vector<Tensor> _tensors;
+    size_t _first_output;
+    // pairs of tensors contracted at each step; the result of step i is tensor
+    // number `_tensors.size() + i`
+    std::vector<std::pair<size_t, size_t>> _steps;
+    std::vector<size_t> _sliced;
+    Stats _stats;
+
+    void plan(size_t max_tensor_size);
+
+    math::cx_t contract(const std::vector<Tensor>& tensors, size_t slice) const;
+
+    static Tensor contract(const Tensor& a, const Tensor& b);
+};
+
+}
+
+#endif // __RUNTIME__TENSOR_NETWORK_H__
@@ -0,0 +1,267 @@
+/**
+ * Copyright (c) 2022 Alcides Andrade <andrade.alcides.junior@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "trajectories.hpp"
+
+#include <atomic>
+#include <cmath>
+#include <thread>
+
+#include "error.hpp"
+#include "gate.hpp"
+
+namespace runtime {
+
+using math::cx_t;
+
+static math::unitary_t matrix(cx_t m00, cx_t m01, cx_t m10, cx_t m11) {
+    return math::unitary_t({ m00, m01, m10, m11 });
+}
+
+static const math::unitary_t identity = matrix(1, 0, 0, 1);
+static const math::unitary_t pauli_x = matrix(0, 1, 1, 0);
+static const math::unitary_t pauli_y = matrix(0, cx_t(0, -1), cx_t(0, 1), 0);
+static const math::unitary_t pauli_z = matrix(1, 0, 0, -1);
+
+Trajectories::Trajectories(const Circuit& circuit, const NoiseModel& noise,
+                           size_t lanes, size_t nr_threads):
+    _circuit(circuit), _noise(noise), _lanes(lanes),
+    _nr_threads(nr_threads == 0 ? std::max(1u, std::thread::hardware_concurrency()) : nr_threads),
+    _noise_after(circuit.operations.size())
+{
+    if (_lanes == 0) {
+        throw Error("a batch of trajectories needs at least one lane");
+    }
+    for (auto& application : circuit.applications) {
+        auto channel = noise.gates.find(application.name);
+        if (channel != noise.gates.end()) {
+            _noise_after[application.last].emplace_back(channel->second, application.qubits);
+        }
+    }
+    for (auto& [name, size] : circuit.classical_registers) {
+        _classical_registers[name] = { _nr_classical_bits, size };
+        _nr_classical_bits += size;
+    }
+
+    // simulate the operations that are the same for every trajectory
+    _prefix.emplace(size_t(1) << circuit.nr_qubits);
+    (*_prefix)[0] = 1;
+    for (auto& operation : circuit.operations) {
+        if (operation.condition.has_value() || operation.type == Operation::Measure ||
+            operation.type == Operation::Reset || !_noise_after[_prefix_size].empty()) {
+            break;
+        }
+        if (operation.type == Operation::U) {
+            auto& [theta, phi, lambda] = operation.angles;
+            Gate::u(theta.evaluate(circuit.parameters),
+                    phi.evaluate(circuit.parameters),
+                    lambda.evaluate(circuit.parameters)).apply(*_prefix, operation.qubits);
+        } else if (operation.type == Operation::CX) {
+            Gate::cx().apply(*_prefix, operation.qubits);
+        }
+        _prefix_size++;
+    }
+}
+
+void Trajectories::apply_channel(const NoiseModel::Channel& channel, size_t qubit,
+                                 const std::vector<bool>& active, math::BatchVector& state,
+                                 std::mt19937_64& generator) const
+{
+    std::uniform_real_distribution<double> uniform;
+    math::LaneMatrix lane(_lanes);
+    if (channel.depolarizing > 0) {
+        static const math::unitary_t* paulis[] = { &identity, &pauli_x, &pauli_y, &pauli_z };
+        bool any = false;
+        for (size_t b = 0; b < _lanes; b++) {
+            size_t k = 0;
+            if (active[b] && uniform(generator) < channel.depolarizing) {
+                k = 1 + std::uniform_int_distribution<size_t>(0, 2)(generator);
+                any = true;
+            }
+            lane.set(b, *paulis[k]);
+        }
+        if (any) {
+            state.apply(lane, qubit);
+        }
+    }
+    if (channel.amplitude_damping > 0) {
+        double gamma = channel.amplitude_damping;
+        std::vector<double> p;
+        state.probabilities(qubit, p);
+        for (size_t b = 0; b < _lanes; b++) {
+            if (!active[b] || p[b] == 0) {
+                lane.set(b, identity);
+            } else if (uniform(generator) < gamma*p[b]) {
+                // the Kraus operators, normalized by the probability of their branch
+                lane.set(b, matrix(0, float(1/std::sqrt(p[b])), 0, 0));
+            } else {
+                float norm = 1/std::sqrt(1 - gamma*p[b]);
+                lane.set(b, matrix(norm, 0, 0, float(std::sqrt(1 - gamma))*norm));
+            }
+        }
+        state.apply(lane, qubit);
+    }
+}
+
+void Trajectories::run_batch(std::mt19937_64& generator, std::vector<std::vector<bool>>& bits) const {
+    std::uniform_real_distribution<double> uniform;
+    math::BatchVector state(_prefix->size(), _lanes);
+    state.set(*_prefix);
+    math::LaneMatrix lane(_lanes);
+    std::vector<bool> active(_lanes);
+    std::vector<double> p;
+    auto& operations = _circuit.operations;
+    for (size_t i = _prefix_size; i < operations.size(); i++) {
+        auto& operation = operations[i];
+        size_t nr_active = _lanes;
+        std::fill(active.begin(), active.end(), true);
+        if (operation.condition.has_value()) {
+            auto& [creg, value] = operation.condition.value();
+            auto [first, size] = _classical_registers.at(creg);
+            for (size_t b = 0; b < _lanes; b++) {
+                unsigned long v = 0;
+                for (size_t k = 0; k < size; k++) {
+                    v |= (unsigned long)(bits[b][first + k]) << k;
+                }
+                active[b] = v == value;
+                nr_active -= !active[b];
+            }
+        }
+        if (nr_active == 0) {
+            continue;
+        }
+        switch (operation.type) {
+        case Operation::U: {
+            auto& [theta, phi, lambda] = operation.angles;
+            auto u = Gate::u(theta.evaluate(_circuit.parameters),
+                             phi.evaluate(_circuit.parameters),
+                             lambda.evaluate(_circuit.parameters));
+            if (nr_active == _lanes) {
+                state.apply(u, operation.qubits);
+                break;
+            }
+            for (size_t b = 0; b < _lanes; b++) {
+                if (active[b]) {
+                    lane.set(b, u);
+                } else {
+                    lane.set(b, identity);
+                }
+            }
+            state.apply(lane, operation.qubits[0]);
+            break;
+        }
+        case Operation::CX:
+            if (nr_active == _lanes) {
+                state.apply(Gate::cx(), operation.qubits);
+                break;
+            }
+            // an X on the target of the active lanes, controlled by the control
+            for (size_t b = 0; b < _lanes; b++) {
+                if (active[b]) {
+                    lane.set(b, pauli_x);
+                } else {
+                    lane.set(b, identity);
+                }
+            }
+            state.apply(lane, operation.qubits[1], size_t(1) << operation.qubits[0]);
+            break;
+        case Operation::Measure:
+        case Operation::Reset: {
+            size_t qubit = operation.qubits[0];
+            bool measure = operation.type == Operation::Measure;
+            if (measure) {
+                apply_channel(_noise.measure, qubit, active, state, generator);
+            }
+            state.probabilities(qubit, p);
+            for (size_t b = 0; b < _lanes; b++) {
+                if (!active[b]) {
+                    lane.set(b, identity);
+                    continue;
+                }
+                bool outcome = uniform(generator) < p[b];
+                float norm = 1/std::sqrt(outcome ? p[b] : 1 - p[b]);
+                if (!outcome) {
+                    lane.set(b, matrix(norm, 0, 0, 0));
+                } else if (measure) {
+                    lane.set(b, matrix(0, 0, 0, norm));
+                } else {
+                    // a reset flips the outcome 1 back to |0>
+                    lane.set(b, matrix(0, norm, 0, 0));
+                }
+                if (measure) {
+                    bool flipped = _noise.readout_error > 0 &&
+                                   uniform(generator) < _noise.readout_error;
+                    size_t bit = _classical_registers.at(operation.creg).first + operation.bit;
+                    bits[b][bit] = outcome != flipped;
+                }
+            }
+            state.apply(lane, qubit);
+            break;
+        }
+        case Operation::Barrier:
+            break;
+        }
+        for (auto& [channel, qubits] : _noise_after[i]) {
+            for (auto qubit : qubits) {
+                apply_channel(channel, qubit, active, state, generator);
+            }
+        }
+    }
+}
+
+std::vector<std::map<std::string, std::vector<bool>>> Trajectories::run(size_t nr_trajectories,
+                                                                        uint64_t seed) const
+{
+    std::vector<std::map<std::string, std::vector<bool>>> res(nr_trajectories);
+    size_t nr_batches = (nr_trajectories + _lanes - 1)/_lanes;
+    size_t nr_threads = std::min(_nr_threads, nr_batches);
+    std::atomic<size_t> next { 0 };
+    auto worker = [&]() {
+        for (size_t batch = next++; batch < nr_batches; batch = next++) {
+            // every batch has its own generator, so that the results do not
+            // depend on the thread that ran it
+            std::seed_seq seq { uint32_t(seed), uint32_t(seed >> 32), uint32_t(batch) };
+            std::mt19937_64 generator(seq);
+            std::vector<std::vector<bool>> bits(_lanes, std::vector<bool>(_nr_classical_bits));
+            run_batch(generator, bits);
+            for (size_t b = 0; b < _lanes && batch*_lanes + b < nr_trajectories; b++) {
+                auto& registers = res[batch*_lanes + b];
+                for (auto& [name, layout] : _classical_registers) {
+                    auto [first, size] = layout;
+                    registers[name] = std::vector<bool>(bits[b].begin() + first,
+                                                        bits[b].begin() + first + size);
+                }
+            }
+        }
+    };
+    std::vector<std::thread> threads;
+    for (size_t t = 1; t < nr_threads; t++) {
+        threads.emplace_back(worker);
+    }
+    worker();
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    return res;
+}
+
+}
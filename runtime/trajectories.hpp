@@ -0,0 +1,117 @@
+/**
+ * Copyright (c) 2022 Alcides Andrade <andrade.alcides.junior@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef __RUNTIME__TRAJECTORIES_H__
+#define __RUNTIME__TRAJECTORIES_H__
+
+#include <cstdint>
+#include <map>
+#include <optional>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "circuit.hpp"
+#include "math/batch_vector.hpp"
+#include "math/vector.hpp"
+
+namespace runtime {
+
+/**
+ * The noise of a circuit, as single-qubit channels attached to the gates by
+ * the name of their declaration and to the measurements.
+ * */
+struct NoiseModel {
+    struct Channel {
+        // probability of an X, Y or Z, picked uniformly, on each qubit
+        double depolarizing { 0 };
+        // probability of a decay from |1> to |0> of each qubit
+        double amplitude_damping { 0 };
+    };
+
+    // channel on the qubits of every top-level application of a gate, after it.
+    // The primitive gates are named "U" and "CX".
+    std::map<std::string, Channel> gates;
+    // channel on the qubit of every measurement, before it
+    Channel measure;
+    // probability of recording the opposite of the outcome of a measurement
+    double readout_error { 0 };
+};
+
+/**
+ * A Monte-Carlo simulation of a noisy circuit, i.e., each run of the circuit
+ * is a trajectory where every noisy location applies one Kraus operator of its
+ * channel, picked with its probability on the current state. The average over
+ * the trajectories converges to the density matrix while only keeping state
+ * vectors.
+ *
+ * The operations before the first noisy location or measurement are the same
+ * for every trajectory, so they are simulated once and their state is the
+ * start of every trajectory. The trajectories are run in batches, one per
+ * lane of a `math::BatchVector`, so that the gates shared by the batch are
+ * vectorized across the lanes, and the batches are spread over the threads.
+ * */
+class Trajectories {
+public:
+    /**
+     * Prepare the simulation of a circuit with `lanes` trajectories per batch.
+     * When `nr_threads` is 0 one thread per hardware thread is used.
+     * */
+    Trajectories(const Circuit& circuit, const NoiseModel& noise,
+                 size_t lanes = 8, size_t nr_threads = 0);
+
+    /**
+     * Run `nr_trajectories` trajectories and return the classical registers at
+     * the end of each of them. Runs with the same seed have the same results.
+     * */
+    std::vector<std::map<std::string, std::vector<bool>>> run(size_t nr_trajectories,
+                                                             uint64_t seed = std::random_device()()) const;
+
+    /**
+     * The number of operations simulated once for all the trajectories
+     * */
+    inline size_t prefix_size() const {
+        return _prefix_size;
+    }
+
+private:
+    Circuit _circuit;
+    NoiseModel _noise;
+    size_t _lanes;
+    size_t _nr_threads;
+    // the channels after each operation, with their qubits
+    std::vector<std::vector<std::pair<NoiseModel::Channel, std::vector<size_t>>>> _noise_after;
+    size_t _prefix_size { 0 };
+    std::optional<math::vector_t> _prefix;
+    // (first bit, size) of every classical register
+    std::map<std::string, std::pair<size_t, size_t>> _classical_registers;
+    size_t _nr_classical_bits { 0 };
+
+    void run_batch(std::mt19937_64& generator, std::vector<std::vector<bool>>& bits) const;
+    void apply_channel(const NoiseModel::Channel& channel, size_t qubit,
+                       const std::vector<bool>& active, math::BatchVector& state,
+                       std::mt19937_64& generator) const;
+};
+
+}
+
+#endif // __RUNTIME__TRAJECTORIES_H__
@@ -0,0 +1,104 @@
+/**
+ * Copyright (c) 2022 Alcides Andrade <andrade.alcides.junior@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "unitary_simulator.hpp"
+
+#include <algorithm>
+#include <thread>
+
+#include "error.hpp"
+#include "gate.hpp"
+
+namespace runtime {
+
+using math::cx_t;
+
+UnitarySimulator::UnitarySimulator(const Circuit& circuit, size_t nr_threads):
+    _nr_qubits(circuit.nr_qubits),
+    _nr_threads(nr_threads == 0 ? std::max(1u, std::thread::hardware_concurrency()) : nr_threads)
+{
+    if (_nr_qubits > max_qubits) {
+        throw Error("the unitary of a circuit of more than " + std::to_string(max_qubits) +
+                    " qubits is too large");
+    }
+    for (auto& operation : circuit.operations) {
+        if (operation.condition.has_value() ||
+            operation.type == Operation::Measure || operation.type == Operation::Reset) {
+            throw Error("only unitary circuits have a matrix (line " +
+                        std::to_string(operation.line) + ")");
+        }
+        if (operation.type == Operation::CX) {
+            auto& cx = Gate::cx();
+            math::unitary_t matrix(cx.dim());
+            std::copy(cx.ptr(), cx.ptr() + cx.size(), matrix.ptr());
+            _steps.push_back({ operation.qubits, std::move(matrix) });
+        } else if (operation.type == Operation::U) {
+            auto& [theta, phi, lambda] = operation.angles;
+            auto u = Gate::u(theta.evaluate(circuit.parameters),
+                             phi.evaluate(circuit.parameters),
+                             lambda.evaluate(circuit.parameters));
+            if (!_steps.empty() && _steps.back().qubits == operation.qubits) {
+                // fuse with the previous gate on the same qubit
+                _steps.back().matrix = u*_steps.back().matrix;
+                continue;
+            }
+            _steps.push_back({ operation.qubits, std::move(u) });
+        }
+    }
+}
+
+void UnitarySimulator::run(cx_t* entries, size_t first_column, size_t last_column) const {
+    size_t dim = size_t(1) << _nr_qubits;
+    std::vector<cx_t> column(dim);
+    for (size_t c = first_column; c < last_column; c++) {
+        std::fill(column.begin(), column.end(), 0);
+        column[c] = 1;
+        for (auto& step : _steps) {
+            step.matrix.apply(column.data(), dim, step.qubits);
+        }
+        for (size_t r = 0; r < dim; r++) {
+            entries[r*dim + c] = column[r];
+        }
+    }
+}
+
+math::unitary_t UnitarySimulator::run() const {
+    size_t dim = size_t(1) << _nr_qubits;
+    // every column is written by one of the threads
+    math::unitary_t res(dim);
+    // ranges of columns that are whole cache lines
+    size_t nr_threads = std::min(_nr_threads, std::max<size_t>(1, dim/8));
+    size_t chunk = ((dim + nr_threads - 1)/nr_threads + 7)/8*8;
+    std::vector<std::thread> threads;
+    for (size_t t = 1; t < nr_threads; t++) {
+        threads.emplace_back([&, t]() {
+            run(res.ptr(), std::min(dim, t*chunk), std::min(dim, (t + 1)*chunk));
+        });
+    }
+    run(res.ptr(), 0, std::min(dim, chunk));
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    return res;
+}
+
+}
@@ -0,0 +1,78 @@
+/**
+ * Copyright (c) 2022 Alcides Andrade <andrade.alcides.junior@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef __RUNTIME__UNITARY_SIMULATOR_H__
+#define __RUNTIME__UNITARY_SIMULATOR_H__
+
+#include <vector>
+
+#include "circuit.hpp"
+#include "math/unitary.hpp"
+
+namespace runtime {
+
+/**
+ * Computes the matrix of a unitary circuit by evolving all the 2^n basis
+ * states at once, i.e., every gate is applied to the matrix from the left.
+ *
+ * Every column is the state of the circuit started from a basis state, so it
+ * is evolved by the state vector kernels of `math::Unitary` in a contiguous
+ * buffer and then written into the row-major matrix. The columns are
+ * independent of each other: every thread owns a range of columns and runs
+ * the whole circuit on each of them, without any synchronization between the
+ * gates.
+ * */
+class UnitarySimulator {
+public:
+    // the matrix of a wider circuit takes more than 2GB
+    static constexpr size_t max_qubits = 14;
+
+    /**
+     * Prepare a circuit, which must not measure, reset or have conditions.
+     * Consecutive U gates on the same qubit are fused. When `nr_threads` is 0
+     * one thread per hardware thread is used.
+     * */
+    UnitarySimulator(const Circuit& circuit, size_t nr_threads = 0);
+
+    /**
+     * The matrix of the circuit, whose column j is the final state of the
+     * circuit started from the basis state |j>
+     * */
+    math::unitary_t run() const;
+
+private:
+    struct Step {
+        // a U gate on a single qubit or a CX from qubits[0] to qubits[1]
+        std::vector<size_t> qubits;
+        math::unitary_t matrix;
+    };
+
+    size_t _nr_qubits;
+    size_t _nr_threads;
+    std::vector<Step> _steps;
+
+    void run(math::cx_t* entries, size_t first_column, size_t last_column) const;
+};
+
+}
+
+#endif // __RUNTIME__UNITARY_SIMULATOR_H__
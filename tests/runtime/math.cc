@@ -23,10 +23,17 @@
 #include <gtest/gtest.h>
 #include <initializer_list>
 #include <iostream>
+#include <memory>
 #include <tuple>
+#include <unistd.h>
 #include <vector>
+#include "runtime/math/batch_vector.hpp"
+#include "runtime/math/chunked_vector.hpp"
+#include "runtime/math/sparse_vector.hpp"
+#include "runtime/math/svd.hpp"
 #include "runtime/math/unitary.hpp"
 #include "runtime/math/vector.hpp"
+#include "runtime/error.hpp"
 
 using namespace runtime::math;
 using namespace std::complex_literals;
@@ -106,6 +113,20 @@ TEST(Math, VecTensor) {
     }
 }
 
+TEST(Math, VecBasis) {
+    // large enough to be filled by several threads
+    size_t size = size_t(1) << 21;
+    auto v = vector_t::basis(size, 12345);
+    size_t nonzeros = 0;
+    for (size_t i = 0; i < size; i++) {
+        nonzeros += v[i] != cx_t(0);
+    }
+    EXPECT_EQ(nonzeros, 1ul);
+    EXPECT_EQ(v[12345], cx_t(1));
+    v.fill(0.5f);
+    EXPECT_EQ(v[size - 1], cx_t(0.5f));
+}
+
 TEST(Math, MatRedimension) {
     std::vector<std::tuple<cxv_t, std::vector<size_t>, cxv_t>> test_data = {
         {
@@ -167,3 +188,227 @@ TEST(Math, VecMeasure) {
         EXPECT_EQ(v[m], (cx_t)1);
     }
 }
+
+TEST(Math, VecExpectation) {
+    // Bell state (|00> + |11>)/sqrt(2)
+    auto v = vector_t({ 1.f/std::sqrt(2.f), 0, 0, 1.f/std::sqrt(2.f) });
+    std::vector<std::complex<double>> diagonal(3);
+    // II, ZI and ZZ
+    v.expectation(0, { 0, 1, 3 }, diagonal);
+    EXPECT_NEAR(diagonal[0].real(), 1., 1e-6);
+    EXPECT_NEAR(diagonal[1].real(), 0., 1e-6);
+    EXPECT_NEAR(diagonal[2].real(), 1., 1e-6);
+    std::vector<std::complex<double>> flipped(2);
+    // XX and, up to the phase i^2 of the two Ys, YY
+    v.expectation(3, { 0, 3 }, flipped);
+    EXPECT_NEAR(flipped[0].real(), 1., 1e-6);
+    EXPECT_NEAR(flipped[1].real(), 1., 1e-6);
+    EXPECT_EQ(v, vector_t({ 1.f/std::sqrt(2.f), 0, 0, 1.f/std::sqrt(2.f) }));
+}
+
+TEST(Math, BatchVecApply) {
+    const size_t lanes = 4;
+    unitary_t h({ 0.70710678f, 0.70710678f, 0.70710678f, -0.70710678f });
+    unitary_t cx({
+        1.f, 0, 0, 0,
+        0, 1.f, 0, 0,
+        0, 0, 0, 1.f,
+        0, 0, 1.f, 0,
+    });
+    LaneMatrix phases(lanes);
+    std::vector<unitary_t> lane_matrices;
+    for (size_t b = 0; b < lanes; b++) {
+        cx_t phase = std::polar(1.f, 0.5f*b);
+        lane_matrices.push_back(unitary_t({ 1.f, 0, 0, phase }));
+        phases.set(b, lane_matrices[b]);
+    }
+
+    BatchVector batch(8, lanes);
+    batch.set_basis_state(0);
+    batch.apply(h, { 0 });
+    batch.apply(phases, 0);
+    batch.apply(cx, { 0, 2 });
+    batch.apply(h, { 2 });
+    for (size_t b = 0; b < lanes; b++) {
+        vector_t expected(8);
+        expected[0] = 1;
+        h.apply(expected, { 0 });
+        lane_matrices[b].apply(expected, { 0 });
+        cx.apply(expected, { 0, 2 });
+        h.apply(expected, { 2 });
+        vector_t lane(8);
+        batch.extract(b, lane);
+        EXPECT_EQ(lane, expected);
+    }
+}
+
+TEST(Math, SparseVecApply) {
+    unitary_t h({ 0.70710678f, 0.70710678f, 0.70710678f, -0.70710678f });
+    unitary_t cx({
+        1.f, 0, 0, 0,
+        0, 1.f, 0, 0,
+        0, 0, 0, 1.f,
+        0, 0, 1.f, 0,
+    });
+    unitary_t u({ 0.6f, 0.8if, 0.8if, 0.6f });
+    SparseVector sparse(16);
+    sparse.set(0, 1);
+    vector_t dense(16);
+    dense[0] = 1;
+    auto check = [&](const unitary_t& mat, const std::vector<size_t>& qubits) {
+        sparse.apply(mat, qubits);
+        mat.apply(dense, qubits);
+        vector_t res(16);
+        sparse.to_dense(res);
+        EXPECT_EQ(res, dense);
+    };
+    check(h, { 0 });
+    check(cx, { 0, 3 });
+    check(u, { 2 });
+    check(cx, { 2, 1 });
+    EXPECT_EQ(sparse.nr_nonzeros(), 4ul);
+    // the amplitudes cancel out and are dropped
+    check(h, { 0 });
+    check(h, { 0 });
+    EXPECT_EQ(sparse.nr_nonzeros(), 4ul);
+
+    std::vector<bool> bits(2);
+    sparse.measure(0, 2, bits);
+    EXPECT_EQ(sparse.nr_nonzeros(), 1ul);
+    size_t index = 0;
+    sparse.for_each([&](size_t i, cx_t value) {
+        index = i;
+        EXPECT_NEAR(std::abs(value), 1, 1e-6);
+    });
+    EXPECT_EQ(index & 1, size_t(bits[0]));
+    EXPECT_EQ((index >> 1) & 1, size_t(bits[1]));
+}
+
+TEST(Math, ChunkedVecApply) {
+    unitary_t h({ 0.70710678f, 0.70710678f, 0.70710678f, -0.70710678f });
+    unitary_t cx({
+        1.f, 0, 0, 0,
+        0, 1.f, 0, 0,
+        0, 0, 0, 1.f,
+        0, 0, 1.f, 0,
+    });
+    unitary_t u({ 0.6f, 0.8if, 0.8if, 0.6f });
+    size_t n = 10;
+    auto path = "/tmp/chunked_vector_test." + std::to_string(getpid());
+    ChunkedVector chunked(n, 4, std::make_unique<FileChunkStore>(path, 64, 16));
+    vector_t dense(1 << n);
+    dense[0] = 1;
+    auto check = [&](const unitary_t& mat, const std::vector<size_t>& qubits) {
+        chunked.apply(mat, qubits);
+        mat.apply(dense, qubits);
+    };
+    for (size_t q = 0; q < n; q++) {
+        check(h, { q });
+    }
+    check(cx, { 9, 0 });
+    check(u, { 7 });
+    check(cx, { 1, 8 });
+    check(cx, { 5, 6 });
+    check(u, { 2 });
+    check(cx, { 3, 9 });
+    for (size_t i = 0; i < dense.size(); i++) {
+        EXPECT_NEAR(std::abs(chunked.get(i) - dense[i]), 0, 1e-5);
+    }
+    auto& stats = chunked.stats();
+    EXPECT_GT(stats.nr_swaps, 0ul);
+    EXPECT_GT(stats.nr_passes, stats.nr_swaps);
+    EXPECT_GT(stats.bandwidth(), 0);
+
+    bool bit = chunked.measure(8);
+    double norm = 0;
+    for (size_t i = 0; i < dense.size(); i++) {
+        auto value = chunked.get(i);
+        if (((i >> 8) & 1) != bit) {
+            EXPECT_EQ(value, cx_t(0));
+        }
+        norm += std::norm(value);
+    }
+    EXPECT_NEAR(norm, 1, 1e-5);
+    EXPECT_THROW(ChunkedVector(4, 5, nullptr), runtime::Error);
+}
+
+TEST(Math, CompressedChunkedVec) {
+    unitary_t h({ 0.70710678f, 0.70710678f, 0.70710678f, -0.70710678f });
+    unitary_t u({ 0.6f, 0.8if, 0.8if, 0.6f });
+    size_t n = 12;
+    for (double error_bound : { 0.0, 1e-4 }) {
+        auto store = std::make_unique<CompressedChunkStore>(64, 64, 4, error_bound);
+        auto& stats = store->stats();
+        ChunkedVector chunked(n, 6, std::move(store));
+        vector_t dense(1 << n);
+        dense[0] = 1;
+        for (size_t q : { 0, 3, 7, 10 }) {
+            chunked.apply(h, { q });
+            h.apply(dense, { q });
+        }
+        chunked.apply(u, { 11 });
+        u.apply(dense, { 11 });
+        for (size_t i = 0; i < dense.size(); i++) {
+            EXPECT_NEAR(std::abs(chunked.get(i) - dense[i]), 0, 2*error_bound + 1e-6);
+        }
+        // only 32 of the 4096 entries are nonzero
+        EXPECT_GT(stats.nr_compressions, 0ul);
+        EXPECT_GT(stats.ratio(), 50);
+    }
+    EXPECT_THROW(CompressedChunkStore(4, 4, 1), runtime::Error);
+}
+
+TEST(Math, LazyChunkedVec) {
+    unitary_t h({ 0.70710678f, 0.70710678f, 0.70710678f, -0.70710678f });
+    size_t n = 10;
+    auto store = std::make_unique<MemoryChunkStore>(64, 16);
+    auto& memory = *store;
+    ChunkedVector chunked(n, 4, std::move(store));
+    vector_t dense(1 << n);
+    dense[0] = 1;
+    EXPECT_EQ(memory.nr_allocated(), 1ul);
+    for (size_t q : { 0, 1, 2, 3, 9 }) {
+        chunked.apply(h, { q });
+        h.apply(dense, { q });
+    }
+    for (size_t i = 0; i < dense.size(); i++) {
+        EXPECT_NEAR(std::abs(chunked.get(i) - dense[i]), 0, 1e-6);
+    }
+    // qubit 9 was swapped into the chunk, spreading the state over two chunks
+    EXPECT_EQ(memory.nr_allocated(), 2ul);
+    EXPECT_GT(chunked.stats().nr_skipped, 0ul);
+    // qubit 0 is now stored in the chunk index, measuring it drops a chunk
+    bool bit = chunked.measure(0);
+    EXPECT_EQ(memory.nr_allocated(), 1ul);
+    EXPECT_EQ(memory.peak_allocated(), 2ul);
+    EXPECT_NEAR(std::norm(chunked.get(bit)), 1.0/16, 1e-6);
+    EXPECT_EQ(chunked.get(!bit), cx_t(0));
+}
+
+TEST(Math, Svd) {
+    for (auto [rows, cols] : { std::pair<size_t, size_t>(3, 5), { 5, 3 }, { 4, 4 } }) {
+        std::vector<std::complex<double>> a(rows*cols);
+        for (size_t i = 0; i < a.size(); i++) {
+            a[i] = { std::sin(1.3*i + 0.2), std::cos(0.7*i*i) };
+        }
+        // make the last row a combination of the others to get a zero singular value
+        for (size_t c = 0; c < cols; c++) {
+            a[(rows - 1)*cols + c] = a[c] - 2.*a[cols + c];
+        }
+        auto svd = runtime::math::svd(a, rows, cols);
+        size_t k = std::min(rows, cols);
+        ASSERT_EQ(svd.s.size(), k);
+        for (size_t j = 1; j < k; j++) {
+            EXPECT_GE(svd.s[j - 1], svd.s[j]);
+        }
+        for (size_t r = 0; r < rows; r++) {
+            for (size_t c = 0; c < cols; c++) {
+                std::complex<double> x = 0;
+                for (size_t j = 0; j < k; j++) {
+                    x += svd.u[r*k + j]*svd.s[j]*svd.vh[j*cols + c];
+                }
+                EXPECT_NEAR(std::abs(x - a[r*cols + c]), 0, 1e-10);
+            }
+        }
+    }
+}
@@ -0,0 +1,1123 @@
+/**
+ * Copyright (c) 2022 Alcides Andrade <andrade.alcides.junior@gmail.com>
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <cmath>
+#include <csignal>
+#include <limits>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "lang/parser.hpp"
+#include "runtime/adjoint.hpp"
+#include "runtime/bit_sliced.hpp"
+#include "runtime/circuit.hpp"
+#include "runtime/compiled_circuit.hpp"
+#include "runtime/decision_diagram.hpp"
+#include "runtime/error.hpp"
+#include "runtime/matrix_product_state.hpp"
+#include "runtime/passes.hpp"
+#include "runtime/planner.hpp"
+#include "runtime/runtime.hpp"
+#include "runtime/schrodinger_feynman.hpp"
+#include "runtime/sharded_state.hpp"
+#include "runtime/shot_coordinator.hpp"
+#include "runtime/small_circuit.hpp"
+#include "runtime/state.hpp"
+#include "runtime/tableau.hpp"
+#include "runtime/tensor_network.hpp"
+#include "runtime/trajectories.hpp"
+#include "runtime/unitary_simulator.hpp"
+
+using namespace runtime;
+
+static Circuit compile(const std::string& source) {
+    std::istringstream ss(source);
+    lang::Input input(ss);
+    auto program = lang::parser::parse(input);
+    return Circuit::compile(program);
+}
+
+static void apply_gate(const math::unitary_t& gate, State& state, const std::vector<size_t>& qubits) {
+    state.apply(gate, qubits);
+}
+
+static void apply_gate(const math::unitary_t& gate, math::vector_t& state,
+                       const std::vector<size_t>& qubits)
+{
+    gate.apply(state, qubits);
+}
+
+/**
+ * Reference run of the U and CX gates of a unitary circuit on a `State` or a
+ * state vector
+ * */
+template <class S>
+static void simulate(const Circuit& circuit, S& state, const std::vector<double>& parameters) {
+    for (auto& operation : circuit.operations) {
+        auto& [theta, phi, lambda] = operation.angles;
+        if (operation.type == Operation::CX) {
+            apply_gate(Gate::cx(), state, operation.qubits);
+        } else {
+            apply_gate(Gate::u(theta.evaluate(parameters),
+                               phi.evaluate(parameters),
+                               lambda.evaluate(parameters)),
+                       state, operation.qubits);
+        }
+    }
+}
+
+template <class S>
+static void simulate(const Circuit& circuit, S& state) {
+    simulate(circuit, state, circuit.parameters);
+}
+
+TEST(Runtime, Execute) {
+    auto circuit = compile(
+        "OPENQASM 2.0;"
+        "qreg q[2];"
+        "creg c[2];"
+        "gate x a { U(pi,0,pi) a; }"
+        "x q[0];"
+        "CX q[0],q[1];"
+        "measure q -> c;"
+        "if (c == 3) x q;"
+    );
+    execute(circuit);
+    EXPECT_EQ(get_state().classical_register_value("c"), 3ul);
+    Observable z;
+    z.add_term(1, { { 'Z', "q", 0 } });
+    z.add_term(1, { { 'Z', "q", 1 } });
+    EXPECT_NEAR(get_state().expectation(z), 2., 1e-5);
+}
+
+TEST(Runtime, AdjointGradient) {
+    auto circuit = compile(
+        "OPENQASM 2.0;"
+        "qreg q[2];"
+        "gate rx(t) a { U(t,-pi/2,pi/2) a; }"
+        "gate layer(a, b) p, q { rx(2*a) p; U(b,0.3,sin(b)) q; CX p,q; }"
+        "layer(0.4, 1.1) q[0],q[1];"
+        "rx(0.7) q[1];"
+        "U(0.2,0.5,0.9) q[0];"
+    );
+    ASSERT_EQ(circuit.parameters.size(), 6ul);
+    Observable observable;
+    observable.add_term(0.5, { { 'Z', "q", 0 }, { 'X', "q", 1 } });
+    observable.add_term(-1.5, { { 'Y', "q", 1 } });
+    observable.add_term(2, { { 'Z', "q", 1 } });
+
+    auto res = gradient(circuit, observable);
+    ASSERT_EQ(res.derivatives.size(), circuit.parameters.size());
+    for (size_t p = 0; p < circuit.parameters.size(); p++) {
+        // central finite differences
+        double h = 1e-2;
+        auto plus = circuit.parameters;
+        auto minus = circuit.parameters;
+        plus[p] += h;
+        minus[p] -= h;
+        double fd = (gradient(circuit, observable, plus).value -
+                     gradient(circuit, observable, minus).value)/(2*h);
+        EXPECT_NEAR(res.derivatives[p], fd, 1e-3) << "parameter " << p;
+    }
+
+    // <Z> of U(t,0,0)|0> is cos(t)
+    auto ry = compile("OPENQASM 2.0; qreg q[1]; U(0.3,0,0) q[0];");
+    Observable z;
+    z.add_term(1, { { 'Z', "q", 0 } });
+    auto ry_res = gradient(ry, z);
+    EXPECT_NEAR(ry_res.value, std::cos(0.3), 1e-5);
+    EXPECT_NEAR(ry_res.derivatives[0], -std::sin(0.3), 1e-5);
+}
+
+TEST(Runtime, CompiledCircuitBatch) {
+    auto compiled = CompiledCircuit(compile(
+        "OPENQASM 2.0;"
+        "qreg q[2];"
+        "creg c[2];"
+        "gate ry(t) a { U(t,0,0) a; }"
+        "ry(0) q[0];"
+        "CX q[0],q[1];"
+        "U(0,0,0) q[1];"
+    ));
+    ASSERT_EQ(compiled.nr_parameters(), 4ul);
+    std::vector<std::vector<double>> sets;
+    for (size_t i = 0; i < 64; i++) {
+        sets.push_back({ 0.1*i, 0, 0, 0 });
+    }
+    Observable zz;
+    zz.add_term(1, { { 'Z', "q", 0 } });
+    zz.add_term(1, { { 'Z', "q", 1 } });
+    auto values = compiled.run_batch(sets, zz, 4);
+    ASSERT_EQ(values.size(), sets.size());
+    for (size_t i = 0; i < sets.size(); i++) {
+        EXPECT_NEAR(values[i], 2*std::cos(0.1*i), 1e-4);
+    }
+
+    auto measured = CompiledCircuit(compile(
+        "OPENQASM 2.0;"
+        "qreg q[2];"
+        "creg c[2];"
+        "U(0,0,0) q[0];"
+        "CX q[0],q[1];"
+        "measure q -> c;"
+    ));
+    auto results = measured.run_batch({ { M_PI, 0, 0 }, { 0, 0, 0 }, { M_PI, 0, 0 } });
+    ASSERT_EQ(results.size(), 3ul);
+    EXPECT_EQ(results[0].at("c"), std::vector<bool>({ true, true }));
+    EXPECT_EQ(results[1].at("c"), std::vector<bool>({ false, false }));
+    EXPECT_EQ(results[2].at("c"), std::vector<bool>({ true, true }));
+}
+
+TEST(Runtime, SmallCircuit) {
+    auto circuit = compile(
+        "OPENQASM 2.0;"
+        "qreg a[2];"
+        "qreg b[3];"
+        "gate layer(t) p, q { U(t,0.2,-0.4) p; CX p,q; U(0.3,t,0) q; }"
+        "layer(0.7) a[0],b[2];"
+        "layer(1.9) b[1],a[1];"
+        "CX b[2],b[0];"
+        "U(2.1,0,0.6) b[0];"
+    );
+    ASSERT_TRUE(SmallCircuit::supports(circuit));
+    SmallCircuit small(circuit);
+    std::vector<math::cx_t> amplitudes(size_t(1) << circuit.nr_qubits);
+
+    // the same circuit on the general state vector
+    for (auto& parameters : { circuit.parameters, std::vector<double>({ 0.1, -1.3 }) }) {
+        State state;
+        for (auto& [name, size] : circuit.quantum_registers_in_order()) {
+            state.add_quantum_register(name, size);
+        }
+        simulate(circuit, state, parameters);
+        small.bind(parameters);
+        small.run(amplitudes.data());
+        Observable observable;
+        observable.add_term(1, { { 'X', "a", 0 }, { 'Y', "b", 2 } });
+        observable.add_term(1, { { 'Z', "b", 1 } });
+        double expected = state.expectation(observable);
+        state.set_amplitudes(amplitudes.data());
+        EXPECT_NEAR(state.expectation(observable), expected, 1e-5);
+    }
+
+    // classical bits and conditions
+    auto measured = compile(
+        "OPENQASM 2.0;"
+        "qreg q[3];"
+        "creg c[2];"
+        "creg d[1];"
+        "U(pi,0,pi) q[1];"
+        "measure q[0] -> c[0];"
+        "measure q[1] -> c[1];"
+        "if (c == 2) U(pi,0,pi) q[2];"
+        "if (c == 1) U(pi,0,pi) q[0];"
+        "measure q[2] -> d[0];"
+        "reset q[1];"
+    );
+    SmallCircuit engine(measured);
+    for (size_t i = 0; i < 100; i++) {
+        auto registers = engine.unpack(engine.run(amplitudes.data()));
+        EXPECT_EQ(registers.at("c"), std::vector<bool>({ false, true }));
+        EXPECT_EQ(registers.at("d"), std::vector<bool>({ true }));
+        EXPECT_NEAR(std::abs(amplitudes[4]), 1, 1e-5);
+    }
+}
+
+TEST(Runtime, SmallCircuitManyGates) {
+    // more U gates than a 16-bit matrix index can address
+    std::string source = "OPENQASM 2.0; qreg q[1]; creg c[1];";
+    for (size_t i = 0; i < 65536; i++) {
+        source += "U(0,0,0) q[0];";
+    }
+    source += "U(pi,0,pi) q[0]; measure q[0] -> c[0];";
+    auto circuit = compile(source);
+    ASSERT_TRUE(SmallCircuit::supports(circuit));
+    execute(circuit);
+    EXPECT_EQ(get_state().classical_register_value("c"), 1ul);
+}
+
+TEST(Runtime, Tableau) {
+    auto circuit = compile(
+        "OPENQASM 2.0;"
+        "qreg a[2];"
+        "qreg b[2];"
+        "gate h p { U(pi/2,0,pi) p; }"
+        "gate s p { U(0,0,pi/2) p; }"
+        "h a[0];"
+        "CX a[0],b[1];"
+        "s b[1];"
+        "U(pi/2,pi,-pi/2) a[1];"
+        "CX a[1],b[0];"
+        "U(-pi,pi/2,3*pi/2) b[0];"
+        "h b[1];"
+        "CX b[1],a[0];"
+        "U(3*pi/2,0,pi) a[0];"
+    );
+    ASSERT_TRUE(Tableau::supports(circuit));
+    ASSERT_FALSE(Tableau::supports(compile("OPENQASM 2.0; qreg q[1]; U(pi/4,0,0) q[0];")));
+
+    State state;
+    for (auto& [name, size] : circuit.quantum_registers_in_order()) {
+        state.add_quantum_register(name, size);
+    }
+    simulate(circuit, state);
+    Tableau tableau(circuit.nr_qubits);
+    for (auto& operation : circuit.operations) {
+        tableau.apply(operation, circuit.parameters);
+    }
+    // compare every Pauli string on the four qubits
+    const char ops[] = { 'I', 'X', 'Y', 'Z' };
+    const std::pair<const char*, size_t> qubits[] = { { "a", 0 }, { "a", 1 }, { "b", 0 }, { "b", 1 } };
+    for (size_t k = 1; k < 256; k++) {
+        Observable observable;
+        std::vector<Observable::Pauli> paulis;
+        for (size_t q = 0; q < 4; q++) {
+            char op = ops[(k >> (2*q)) & 3];
+            if (op != 'I') {
+                paulis.push_back({ op, qubits[q].first, qubits[q].second });
+            }
+        }
+        observable.add_term(1, paulis);
+        EXPECT_NEAR(tableau.expectation(observable, circuit.quantum_registers),
+                    state.expectation(observable), 1e-4) << "string " << k;
+    }
+
+    // a GHZ state far beyond the reach of the state vector
+    std::string ghz = "OPENQASM 2.0; qreg q[1200]; creg c[1200]; U(pi/2,0,pi) q[0];";
+    for (size_t i = 1; i < 1200; i++) {
+        ghz += "CX q[" + std::to_string(i - 1) + "],q[" + std::to_string(i) + "];";
+    }
+    ghz += "measure q -> c;";
+    Options options;
+    options.backend = Backend::Stabilizer;
+    execute(compile(ghz), options);
+    ASSERT_NE(get_tableau(), nullptr);
+    auto& bits = get_state().classical_registers().at("c");
+    EXPECT_EQ(std::count(bits.begin(), bits.end(), bits[0]), 1200);
+}
+
+TEST(Runtime, MatrixProductState) {
+    auto circuit = compile(
+        "OPENQASM 2.0;"
+        "qreg q[6];"
+        "U(0.3,0.2,0.1) q;"
+        "CX q[0],q[4];"
+        "CX q[5],q[1];"
+        "U(1.1,-0.4,0.8) q[4];"
+        "CX q[2],q[3];"
+        "CX q[4],q[0];"
+        "U(2.1,0.6,0) q[0];"
+        "CX q[3],q[5];"
+    );
+    State state;
+    for (auto& [name, size] : circuit.quantum_registers_in_order()) {
+        state.add_quantum_register(name, size);
+    }
+    simulate(circuit, state);
+    MatrixProductState mps(circuit.nr_qubits, 64);
+    for (auto& operation : circuit.operations) {
+        mps.apply(operation, circuit.parameters);
+    }
+    EXPECT_LT(mps.truncation_error(), 1e-10);
+    Observable observable;
+    observable.add_term(0.5, { { 'X', "q", 0 }, { 'Y', "q", 4 } });
+    observable.add_term(1.5, { { 'Z', "q", 1 }, { 'Z', "q", 5 } });
+    observable.add_term(-1, { { 'Y', "q", 3 } });
+    EXPECT_NEAR(mps.expectation(observable, circuit.quantum_registers),
+                state.expectation(observable), 1e-5);
+
+    // the amplitudes agree with the ones of the small circuit engine
+    std::vector<math::cx_t> amplitudes(64);
+    SmallCircuit(circuit).run(amplitudes.data());
+    for (size_t i = 0; i < amplitudes.size(); i++) {
+        std::vector<bool> bits(6);
+        for (size_t k = 0; k < bits.size(); k++) {
+            bits[k] = (i >> k) & 1;
+        }
+        EXPECT_NEAR(std::abs(mps.amplitude(bits) - std::complex<double>(amplitudes[i])), 0, 1e-5);
+    }
+
+    // a bond dimension of 1 cannot hold the entanglement
+    MatrixProductState product(circuit.nr_qubits, 1);
+    for (auto& operation : circuit.operations) {
+        product.apply(operation, circuit.parameters);
+    }
+    EXPECT_GT(product.truncation_error(), 1e-3);
+    EXPECT_EQ(product.bond_dimension(), 1ul);
+
+    // a wide chain with little entanglement runs through execute
+    std::string chain = "OPENQASM 2.0; qreg q[80]; creg c[80]; U(0.2,0,0) q;";
+    for (size_t i = 1; i < 80; i++) {
+        chain += "CX q[" + std::to_string(i - 1) + "],q[" + std::to_string(i) + "];";
+    }
+    chain += "measure q -> c;";
+    Options options;
+    options.max_state_vector_qubits = 20;
+    options.max_bond_dimension = 16;
+    execute(compile(chain), options);
+    ASSERT_NE(get_mps(), nullptr);
+    EXPECT_LE(get_mps()->bond_dimension(), 16ul);
+    EXPECT_LT(get_mps()->size(), 80ul*2*16*16);
+    EXPECT_EQ(get_state().classical_registers().at("c").size(), 80ul);
+}
+
+TEST(Runtime, TensorNetwork) {
+    auto circuit = compile(
+        "OPENQASM 2.0;"
+        "qreg q[6];"
+        "U(0.3,0.2,0.1) q;"
+        "CX q[0],q[4];"
+        "CX q[5],q[1];"
+        "U(1.1,-0.4,0.8) q[4];"
+        "CX q[2],q[3];"
+        "CX q[4],q[0];"
+        "U(2.1,0.6,0) q[0];"
+        "CX q[3],q[5];"
+        "CX q[1],q[2];"
+    );
+    std::vector<math::cx_t> expected(64);
+    SmallCircuit(circuit).run(expected.data());
+    // without slicing, and sliced into many pieces contracted on several threads
+    for (size_t max_size : { size_t(1) << 20, size_t(8) }) {
+        TensorNetwork network(circuit, max_size, 4);
+        EXPECT_LE(network.stats().peak_size, max_size);
+        if (max_size == 8) {
+            EXPECT_GT(network.stats().nr_slices, 1ul);
+        }
+        for (size_t i = 0; i < expected.size(); i++) {
+            std::vector<bool> bits(6);
+            for (size_t k = 0; k < bits.size(); k++) {
+                bits[k] = (i >> k) & 1;
+            }
+            EXPECT_NEAR(std::abs(network.amplitude(bits) - expected[i]), 0, 1e-5) << i;
+        }
+    }
+
+    // a wide shallow circuit: 30 Bell pairs
+    std::string wide = "OPENQASM 2.0; qreg q[60];";
+    for (size_t i = 0; i < 60; i += 2) {
+        wide += "U(pi/2,0,pi) q[" + std::to_string(i) + "];";
+        wide += "CX q[" + std::to_string(i) + "],q[" + std::to_string(i + 1) + "];";
+    }
+    TensorNetwork network(compile(wide));
+    std::vector<bool> zeros(60, false), ones(60, true);
+    EXPECT_NEAR(std::abs(network.amplitude(zeros)), std::exp2(-15.), 1e-9);
+    EXPECT_NEAR(std::abs(network.amplitude(ones)), std::exp2(-15.), 1e-9);
+    ones[1] = false;
+    EXPECT_NEAR(std::abs(network.amplitude(ones)), 0, 1e-12);
+
+    // the network of a circuit without qubits is the empty product
+    TensorNetwork empty((Circuit()));
+    EXPECT_NEAR(std::abs(empty.amplitude({}) - math::cx_t(1)), 0, 1e-12);
+}
+
+TEST(Runtime, DecisionDiagram) {
+    auto circuit = compile(
+        "OPENQASM 2.0;"
+        "qreg q[6];"
+        "U(0.3,0.2,0.1) q;"
+        "CX q[0],q[4];"
+        "CX q[5],q[1];"
+        "U(1.1,-0.4,0.8) q[4];"
+        "CX q[2],q[3];"
+        "CX q[4],q[0];"
+        "U(2.1,0.6,0) q[0];"
+        "CX q[3],q[5];"
+    );
+    std::vector<math::cx_t> expected(64);
+    SmallCircuit(circuit).run(expected.data());
+    DecisionDiagram dd(circuit.nr_qubits);
+    for (auto& operation : circuit.operations) {
+        dd.apply(operation, circuit.parameters);
+    }
+    for (size_t i = 0; i < expected.size(); i++) {
+        std::vector<bool> bits(6);
+        for (size_t k = 0; k < bits.size(); k++) {
+            bits[k] = (i >> k) & 1;
+        }
+        EXPECT_NEAR(std::abs(dd.amplitude(bits) - std::complex<double>(expected[i])), 0, 1e-5);
+    }
+    dd.collect();
+    EXPECT_EQ(dd.stats().nr_allocated, dd.stats().nr_nodes);
+
+    // a 64-qubit GHZ-like state takes a couple of nodes per qubit
+    std::string ghz = "OPENQASM 2.0; qreg q[64]; creg c[64]; U(0.3,0,0) q[0];";
+    for (size_t i = 1; i < 64; i++) {
+        ghz += "CX q[" + std::to_string(i - 1) + "],q[" + std::to_string(i) + "];";
+    }
+    Options options;
+    options.backend = Backend::DecisionDiagram;
+    execute(compile(ghz), options);
+    auto diagram = get_decision_diagram();
+    ASSERT_NE(diagram, nullptr);
+    EXPECT_LE(diagram->stats().nr_nodes, 2ul*64);
+    EXPECT_NEAR(std::abs(diagram->amplitude(std::vector<bool>(64, false))), std::cos(0.15), 1e-5);
+    EXPECT_NEAR(std::abs(diagram->amplitude(std::vector<bool>(64, true))), std::sin(0.15), 1e-5);
+
+    execute(compile(ghz + "measure q -> c;"), options);
+    auto& bits = get_state().classical_registers().at("c");
+    EXPECT_EQ(std::count(bits.begin(), bits.end(), bits[0]), 64);
+}
+
+TEST(Runtime, SparseState) {
+    auto x = Gate::u(M_PI, 0, M_PI);
+    auto h = Gate::u(M_PI/2, 0, M_PI);
+    auto& cx = Gate::cx();
+
+    // basis permutations and a few superpositions keep a wide state sparse
+    State state;
+    state.add_quantum_register("q", 24);
+    state.apply(x, { 3 });
+    state.apply(h, { 20 });
+    state.apply(cx, { 3, 10 });
+    state.apply(cx, { 20, 23 });
+    EXPECT_TRUE(state.is_sparse());
+    Observable observable;
+    observable.add_term(1, { { 'Z', "q", 10 } });
+    observable.add_term(1, { { 'Z', "q", 20 }, { 'Z', "q", 23 } });
+    observable.add_term(1, { { 'X', "q", 20 }, { 'X', "q", 23 } });
+    EXPECT_NEAR(state.expectation(observable), 1, 1e-5);
+
+    // a uniform superposition is dense until it is measured
+    State uniform;
+    uniform.add_quantum_register("q", 12);
+    uniform.add_classical_register("c", 12);
+    for (size_t q = 0; q < 12; q++) {
+        uniform.apply(h, { q });
+    }
+    EXPECT_FALSE(uniform.is_sparse());
+    uniform.measure("q", "c");
+    EXPECT_TRUE(uniform.is_sparse());
+    Observable z;
+    for (size_t q = 0; q < 12; q++) {
+        z.add_term(1, { { 'Z', "q", q } });
+    }
+    auto value = uniform.classical_register_value("c");
+    EXPECT_NEAR(uniform.expectation(z), 12 - 2*__builtin_popcountl(value), 1e-5);
+}
+
+TEST(Runtime, BitSliced) {
+    std::string gates =
+        "OPENQASM 2.0;"
+        "gate x a { U(pi,0,pi) a; }"
+        "gate h a { U(pi/2,0,pi) a; }"
+        "gate t a { U(0,0,pi/4) a; }"
+        "gate tdg a { U(0,0,-pi/4) a; }"
+        "gate ccx a,b,c {"
+        "    h c; CX b,c; tdg c; CX a,c; t c; CX b,c; tdg c; CX a,c;"
+        "    t b; t c; h c; CX a,b; t a; tdg b; CX a,b;"
+        "}";
+    auto circuit = compile(gates +
+        "qreg q[4];"
+        "ccx q[0],q[1],q[2];"
+        "CX q[2],q[3];"
+        "x q[0];"
+        "ccx q[0],q[3],q[1];"
+    );
+    ASSERT_TRUE(BitSliced::supports(circuit));
+    ASSERT_FALSE(BitSliced::supports(compile(gates + "qreg q[2]; h q[0]; CX q[0],q[1];")));
+
+    // more inputs than fit in a word
+    std::vector<std::vector<bool>> inputs;
+    for (size_t i = 0; i < 100; i++) {
+        std::vector<bool> bits(4);
+        for (size_t q = 0; q < 4; q++) {
+            bits[q] = ((i % 16) >> q) & 1;
+        }
+        inputs.push_back(bits);
+    }
+    auto outputs = BitSliced(circuit).evaluate(inputs);
+    for (size_t i = 0; i < inputs.size(); i++) {
+        auto b = inputs[i];
+        b[2] = b[2] ^ (b[0] && b[1]);
+        b[3] = b[3] ^ b[2];
+        b[0] = !b[0];
+        b[1] = b[1] ^ (b[0] && b[3]);
+        EXPECT_EQ(outputs[i], b);
+    }
+
+    // a wide oracle runs without any amplitudes
+    std::string oracle = gates + "qreg q[100]; creg d[1]; creg c[100]; x q[0];";
+    for (size_t i = 1; i < 99; i++) {
+        oracle += "CX q[" + std::to_string(i - 1) + "],q[" + std::to_string(i) + "];";
+    }
+    oracle += "ccx q[0],q[98],q[99]; measure q[99] -> d[0]; if (d == 1) x q[0]; measure q -> c;";
+    execute(compile(oracle));
+    auto& bits = get_state().classical_registers().at("c");
+    EXPECT_EQ(std::count(bits.begin(), bits.end(), true), 99);
+    EXPECT_FALSE(bits[0]);
+}
+
+TEST(Runtime, SchrodingerFeynman) {
+    auto circuit = compile(
+        "OPENQASM 2.0;"
+        "qreg q[8];"
+        "U(0.3,0.2,0.1) q;"
+        "CX q[0],q[1];"
+        "CX q[2],q[5];"
+        "U(1.1,-0.4,0.8) q[5];"
+        "CX q[6],q[7];"
+        "CX q[7],q[3];"
+        "U(2.1,0.6,0) q[3];"
+        "CX q[1],q[6];"
+        "U(0.7,0,1.3) q[6];"
+    );
+    std::vector<math::cx_t> expected(256);
+    SmallCircuit(circuit).run(expected.data());
+    std::vector<std::vector<bool>> bits;
+    for (size_t i = 0; i < expected.size(); i++) {
+        std::vector<bool> b(8);
+        for (size_t k = 0; k < b.size(); k++) {
+            b[k] = (i >> k) & 1;
+        }
+        bits.push_back(b);
+    }
+    for (size_t cut : { 4, 2, 7 }) {
+        SchrodingerFeynman simulator(circuit, cut, 3);
+        auto amplitudes = simulator.amplitudes(bits);
+        for (size_t i = 0; i < expected.size(); i++) {
+            EXPECT_NEAR(std::abs(amplitudes[i] - std::complex<double>(expected[i])), 0, 1e-5);
+        }
+    }
+    EXPECT_EQ(SchrodingerFeynman(circuit).stats().nr_crossings, 3ul);
+
+    // a 32-qubit GHZ state from two halves of 16 qubits joined by a single CX
+    std::string wide = "OPENQASM 2.0; qreg q[32]; U(pi/2,0,pi) q[15];";
+    for (size_t i = 15; i > 0; i--) {
+        wide += "CX q[" + std::to_string(i) + "],q[" + std::to_string(i - 1) + "];";
+    }
+    for (size_t i = 15; i < 31; i++) {
+        wide += "CX q[" + std::to_string(i) + "],q[" + std::to_string(i + 1) + "];";
+    }
+    SchrodingerFeynman ghz(compile(wide), 16);
+    EXPECT_EQ(ghz.stats().nr_paths, 2ul);
+
+    // the number of paths saturates instead of overflowing
+    std::string crossed = "OPENQASM 2.0; qreg q[2];";
+    for (size_t i = 0; i < 64; i++) {
+        crossed += "CX q[0],q[1];";
+    }
+    SchrodingerFeynman many(compile(crossed), 1);
+    EXPECT_EQ(many.stats().nr_crossings, 64ul);
+    EXPECT_EQ(many.stats().nr_paths, std::numeric_limits<size_t>::max());
+    auto ends = ghz.amplitudes({ std::vector<bool>(32, false), std::vector<bool>(32, true) });
+    EXPECT_NEAR(std::abs(ends[0]), M_SQRT1_2, 1e-5);
+    EXPECT_NEAR(std::abs(ends[1]), M_SQRT1_2, 1e-5);
+}
+
+TEST(Runtime, Trajectories) {
+    auto circuit = compile(
+        "OPENQASM 2.0;"
+        "qreg q[3];"
+        "creg a[1];"
+        "creg b[1];"
+        "creg c[1];"
+        "gate x p { U(pi,0,pi) p; }"
+        "gate h p { U(pi/2,0,pi) p; }"
+        "h q[1];"
+        "x q[0];"
+        "measure q[0] -> a[0];"
+        "measure q[1] -> b[0];"
+        "if (b == 1) CX q[0],q[2];"
+        "measure q[2] -> c[0];"
+    );
+    auto fraction = [](const std::vector<std::map<std::string, std::vector<bool>>>& runs,
+                       const std::string& creg) {
+        double ones = 0;
+        for (auto& registers : runs) {
+            ones += registers.at(creg)[0];
+        }
+        return ones/runs.size();
+    };
+
+    // without noise the conditional CX copies the random outcome of b into c
+    Trajectories ideal(circuit, {}, 8, 3);
+    EXPECT_EQ(ideal.prefix_size(), 2ul);
+    auto runs = ideal.run(1000, 7);
+    EXPECT_EQ(fraction(runs, "a"), 1);
+    EXPECT_NEAR(fraction(runs, "b"), 0.5, 0.08);
+    for (auto& registers : runs) {
+        EXPECT_EQ(registers.at("b"), registers.at("c"));
+    }
+    EXPECT_EQ(ideal.run(100, 3), ideal.run(100, 3));
+
+    NoiseModel noise;
+    noise.gates["x"].amplitude_damping = 0.3;
+    EXPECT_NEAR(fraction(Trajectories(circuit, noise).run(4000), "a"), 0.7, 0.05);
+    noise.gates["x"] = { 0.3, 0 };
+    // X and Y flip the qubit back to |0>
+    EXPECT_NEAR(fraction(Trajectories(circuit, noise).run(4000), "a"), 0.8, 0.05);
+    noise.gates.clear();
+    noise.readout_error = 0.1;
+    EXPECT_NEAR(fraction(Trajectories(circuit, noise).run(4000), "a"), 0.9, 0.05);
+}
+
+TEST(Runtime, UnitarySimulator) {
+    auto circuit = compile(
+        "OPENQASM 2.0;"
+        "qreg q[5];"
+        "U(0.3,0.2,0.1) q;"
+        "U(1.2,0,0.4) q[2];"
+        "CX q[0],q[4];"
+        "CX q[3],q[1];"
+        "U(1.1,-0.4,0.8) q[4];"
+        "CX q[2],q[3];"
+        "U(2.1,0.6,0) q[0];"
+    );
+    std::vector<math::vector_t> columns;
+    for (size_t j = 0; j < 32; j++) {
+        math::vector_t column(32);
+        column[j] = 1;
+        simulate(circuit, column);
+        columns.push_back(std::move(column));
+    }
+    for (size_t nr_threads : { 1, 3 }) {
+        auto unitary = UnitarySimulator(circuit, nr_threads).run();
+        for (size_t r = 0; r < 32; r++) {
+            for (size_t c = 0; c < 32; c++) {
+                EXPECT_NEAR(std::abs(unitary(r, c) - columns[c][r]), 0, 1e-5);
+            }
+        }
+    }
+
+    Options options;
+    options.backend = Backend::Unitary;
+    execute(circuit, options);
+    ASSERT_NE(get_unitary(), nullptr);
+    EXPECT_EQ(get_unitary()->dim(), 32ul);
+    EXPECT_THROW(execute(compile("OPENQASM 2.0; qreg q[1]; creg c[1]; measure q -> c;"), options),
+                 Error);
+}
+
+TEST(Runtime, Planner) {
+    auto stats = analyze(compile(
+        "OPENQASM 2.0;"
+        "qreg q[4];"
+        "creg c[1];"
+        "U(pi/2,0,pi) q[0];"
+        "CX q[0],q[3];"
+        "CX q[1],q[2];"
+        "measure q[3] -> c[0];"
+        "if (c == 1) U(pi,0,pi) q[3];"
+    ));
+    EXPECT_EQ(stats.width, 4ul);
+    EXPECT_EQ(stats.depth, 4ul);
+    EXPECT_EQ(stats.nr_gates, 4ul);
+    EXPECT_EQ(stats.nr_two_qubit_gates, 2ul);
+    EXPECT_TRUE(stats.clifford);
+    EXPECT_FALSE(stats.permutation);
+    EXPECT_EQ(stats.max_distance, 3ul);
+    EXPECT_EQ(stats.max_crossings, 2ul);
+    EXPECT_EQ(stats.nr_conditions, 1ul);
+    EXPECT_TRUE(stats.mid_circuit_measurements);
+
+    auto wide = [](const std::string& gate, size_t n, size_t distance) {
+        std::string source = "OPENQASM 2.0; qreg q[" + std::to_string(n) + "];"
+                             "creg c[" + std::to_string(n) + "];";
+        source += gate + " q;";
+        for (size_t i = 0; i + distance < n; i++) {
+            source += "CX q[" + std::to_string(i) + "],q[" + std::to_string(i + distance) + "];";
+        }
+        return compile(source + "measure q -> c;");
+    };
+    // a chain barely entangles neighbouring qubits, so measuring is cheaper
+    // than on a tableau
+    EXPECT_EQ(plan(wide("U(pi/2,0,pi)", 200, 1)).backend, Backend::MatrixProductState);
+    // long-range gates entangle too much for an exact matrix product state
+    auto clifford = plan(wide("U(pi/2,0,pi)", 200, 100));
+    EXPECT_EQ(clifford.backend, Backend::Stabilizer);
+    EXPECT_FALSE(clifford.estimates[2].exact);
+    EXPECT_EQ(plan(wide("U(pi,0,pi)", 200, 100)).backend, Backend::BitSliced);
+    auto truncated = plan(wide("U(0.3,0,0)", 200, 100));
+    EXPECT_EQ(truncated.backend, Backend::MatrixProductState);
+    Options options;
+    options.max_state_vector_qubits = 20;
+    EXPECT_EQ(plan(wide("U(0.3,0,0)", 18, 9), options).backend, Backend::StateVector);
+    EXPECT_EQ(plan(wide("U(0.3,0,0)", 4, 1)).backend, Backend::StateVector);
+
+    std::ostringstream os;
+    os << clifford;
+    EXPECT_EQ(os.str().rfind("plan: stabilizer", 0), 0ul);
+}
+
+TEST(Runtime, ShardedState) {
+    auto circuit = compile(
+        "OPENQASM 2.0;"
+        "qreg q[8];"
+        "U(0.3,0.2,0.1) q;"
+        "CX q[0],q[1];"
+        "CX q[2],q[5];"
+        "U(1.1,-0.4,0.8) q[5];"
+        "CX q[6],q[7];"
+        "CX q[7],q[3];"
+        "U(2.1,0.6,0) q[3];"
+        "CX q[1],q[6];"
+        "U(0.7,0,1.3) q[6];"
+    );
+    std::vector<math::cx_t> expected(256);
+    SmallCircuit(circuit).run(expected.data());
+    for (size_t nr_processes : { 1, 2, 4 }) {
+        auto res = ShardedState(circuit, nr_processes).run(0, true);
+        ASSERT_EQ(res.amplitudes.size(), expected.size());
+        for (size_t i = 0; i < expected.size(); i++) {
+            EXPECT_NEAR(std::abs(res.amplitudes[i] - expected[i]), 0, 1e-5);
+        }
+        EXPECT_EQ(res.stats.nr_swaps > 0, nr_processes > 1);
+    }
+
+    // the processes agree on the outcomes of the measurements
+    auto ghz = compile(
+        "OPENQASM 2.0;"
+        "qreg q[6];"
+        "creg c[6];"
+        "creg d[1];"
+        "U(pi/2,0,pi) q[5];"
+        "CX q[5],q[4]; CX q[4],q[3]; CX q[3],q[2]; CX q[2],q[1]; CX q[1],q[0];"
+        "measure q -> c;"
+        "if(c==63) U(pi,0,pi) q[5];"
+        "measure q[5] -> d[0];"
+    );
+    for (uint64_t seed = 0; seed < 4; seed++) {
+        auto res = ShardedState(ghz, 8).run(seed);
+        auto& c = res.registers["c"];
+        EXPECT_EQ(std::count(c.begin(), c.end(), c[0]), 6);
+        EXPECT_FALSE(res.registers["d"][0]);
+    }
+    EXPECT_THROW(ShardedState(ghz, 3), Error);
+    EXPECT_THROW(ShardedState(ghz, 32), Error);
+}
+
+TEST(Runtime, ShotCoordinator) {
+    auto circuit = compile(
+        "OPENQASM 2.0;"
+        "qreg q[3];"
+        "creg c[2];"
+        "creg flag[1];"
+        "U(pi/2,0,pi) q[0];"
+        "CX q[0],q[1];"
+        "measure q[0] -> c[0];"
+        "measure q[1] -> c[1];"
+        "if(c==3) U(pi,0,pi) q[2];"
+        "measure q[2] -> flag[0];"
+    );
+    auto bytes = circuit.serialize();
+    EXPECT_EQ(Circuit::deserialize(bytes).serialize(), bytes);
+    EXPECT_THROW(Circuit::deserialize(bytes.substr(0, bytes.size() - 1)), Error);
+
+    ShotCoordinator coordinator(circuit, 3, 50);
+    auto histogram = coordinator.run(1000);
+    EXPECT_EQ(histogram.size(), 2ul);
+    EXPECT_EQ(histogram["00 0"] + histogram["11 1"], 1000ul);
+    EXPECT_GT(histogram["00 0"], 0ul);
+    EXPECT_GT(histogram["11 1"], 0ul);
+    EXPECT_EQ(coordinator.stats().nr_batches, 20ul);
+
+    // the shots of a worker that dies are run by the others
+    bool killed = false;
+    histogram = coordinator.run(1000, [&](pid_t pid) {
+        if (!killed) {
+            kill(pid, SIGKILL);
+            killed = true;
+        }
+    });
+    EXPECT_EQ(histogram["00 0"] + histogram["11 1"], 1000ul);
+    EXPECT_EQ(coordinator.stats().nr_failed_workers, 1ul);
+    EXPECT_EQ(coordinator.stats().shots_per_worker[0], 0ul);
+}
+
+TEST(Runtime, FactorizedState) {
+    auto h = Gate::u(M_PI/2, 0, M_PI);
+    auto u = Gate::u(0.7, 0.3, -0.2);
+    auto& cx = Gate::cx();
+
+    // the same state, kept as three factors and as a single one
+    State factorized, merged;
+    for (auto state : { &factorized, &merged }) {
+        state->add_quantum_register("a", 6);
+        state->add_quantum_register("b", 6);
+        state->add_quantum_register("c", 2);
+        for (size_t q = 0; q < 14; q++) {
+            state->apply(q % 3 ? h : u, { q });
+        }
+        state->apply(cx, { 1, 4 });
+        state->apply(cx, { 7, 11 });
+    }
+    for (size_t q : { 6, 12 }) {
+        merged.apply(cx, { 0, q });
+        merged.apply(cx, { 0, q });
+    }
+    EXPECT_EQ(factorized.nr_factors(), 3ul);
+    EXPECT_EQ(merged.nr_factors(), 1ul);
+
+    Observable observable;
+    observable.add_term(0.5, { { 'Z', "a", 0 }, { 'Z', "b", 3 } });
+    observable.add_term(1, { { 'X', "a", 1 }, { 'Y', "b", 5 }, { 'Z', "c", 0 } });
+    observable.add_term(-2, { { 'X', "b", 1 }, { 'X', "b", 5 } });
+    observable.add_term(1, { { 'Y', "c", 1 } });
+    EXPECT_NEAR(factorized.expectation(observable), merged.expectation(observable), 1e-5);
+
+    // measurements stay within the factor of the qubit, and split it off
+    factorized.add_classical_register("m", 6);
+    factorized.measure("b", "m");
+    EXPECT_EQ(factorized.nr_factors(), 8ul);
+    Observable z;
+    z.add_term(1, { { 'Z', "b", 4 } });
+    bool bit = factorized.classical_registers().at("m")[4];
+    EXPECT_NEAR(factorized.expectation(z), bit ? -1 : 1, 1e-5);
+
+    // coupling a small dense register to a wide sparse one stays sparse
+    State wide;
+    wide.add_quantum_register("q", 24);
+    wide.add_quantum_register("ancilla", 2);
+    wide.apply(h, { 0 });
+    wide.apply(cx, { 0, 24 });
+    EXPECT_EQ(wide.nr_factors(), 1ul);
+    EXPECT_TRUE(wide.is_sparse());
+    Observable zz;
+    zz.add_term(1, { { 'Z', "q", 0 }, { 'Z', "ancilla", 0 } });
+    EXPECT_NEAR(wide.expectation(zz), 1, 1e-5);
+}
+
+TEST(Runtime, PresizedState) {
+    auto circuit = compile(
+        "OPENQASM 2.0;"
+        "qreg a[3];"
+        "qreg b[2];"
+        "qreg c[3];"
+        "U(pi/2,0,pi) a[0];"
+        "U(0.4,0.1,0) b;"
+        "CX a[0],c[2];"
+        "CX c[2],a[2];"
+        "U(1.2,0,0.3) c[1];"
+    );
+    auto components = circuit.components();
+    EXPECT_EQ(components, std::vector<size_t>({ 0, 1, 0, 3, 4, 5, 6, 0 }));
+
+    State presized, grown;
+    presized.add_quantum_registers(circuit.quantum_registers_in_order(), components);
+    for (auto& [name, size] : circuit.quantum_registers_in_order()) {
+        grown.add_quantum_register(name, size);
+    }
+    EXPECT_EQ(presized.nr_factors(), 6ul);
+    for (auto state : { &presized, &grown }) {
+        simulate(circuit, *state);
+    }
+    // the gates did not have to merge any factor
+    EXPECT_EQ(presized.nr_factors(), 6ul);
+    Observable observable;
+    observable.add_term(1, { { 'X', "a", 0 }, { 'X', "c", 2 }, { 'Z', "b", 1 } });
+    observable.add_term(0.5, { { 'Z', "a", 2 }, { 'Y', "c", 1 } });
+    observable.add_term(1, { { 'X', "b", 0 } });
+    EXPECT_NEAR(presized.expectation(observable), grown.expectation(observable), 1e-5);
+}
+
+TEST(Runtime, ShrinkingState) {
+    auto h = Gate::u(M_PI/2, 0, M_PI);
+    State state;
+    state.add_quantum_register("q", 12);
+    state.add_classical_register("c", 12);
+    for (size_t q = 0; q < 12; q++) {
+        state.apply(h, { q });
+    }
+    state.apply(Gate::cx(), { 0, 11 });
+    EXPECT_EQ(state.nr_factors(), 1ul);
+
+    // every measured qubit leaves the factor of the others
+    for (size_t q = 0; q < 6; q++) {
+        state.set_classical_bit("c", q, state.measure_qubit(q));
+    }
+    state.reset_qubit(6);
+    EXPECT_EQ(state.nr_factors(), 8ul);
+    Observable z;
+    z.add_term(1, { { 'Z', "q", 0 } });
+    z.add_term(1, { { 'Z', "q", 6 } });
+    bool bit = state.classical_registers().at("c")[0];
+    EXPECT_NEAR(state.expectation(z), bit ? 0 : 2, 1e-5);
+
+    // a gate coupling a measured qubit brings it back into a factor
+    state.apply(Gate::cx(), { 0, 11 });
+    EXPECT_EQ(state.nr_factors(), 7ul);
+    Observable x;
+    x.add_term(1, { { 'X', "q", 11 } });
+    x.add_term(1, { { 'Z', "q", 0 } });
+    EXPECT_NEAR(state.expectation(x), bit ? 0 : 2, 1e-5);
+
+    // clearing restores the layout of the declaration
+    state.clear();
+    EXPECT_EQ(state.nr_factors(), 1ul);
+
+    // a measured qubit coupled back to a wide sparse factor keeps it sparse
+    State wide;
+    wide.add_quantum_register("q", 26);
+    for (size_t i = 0; i < 10; i++) {
+        wide.measure_qubit(3);
+        wide.apply(Gate::cx(), { 3, 4 });
+        EXPECT_TRUE(wide.is_sparse());
+    }
+    EXPECT_EQ(wide.nr_factors(), 1ul);
+
+    // after measurements the declared factor is rebuilt in the buffer it gave up
+    State reused;
+    reused.add_quantum_register("q", 12);
+    Observable z0;
+    z0.add_term(1, { { 'Z', "q", 0 } });
+    for (size_t shot = 0; shot < 3; shot++) {
+        for (size_t q = 0; q < 12; q++) {
+            reused.apply(h, { q });
+        }
+        reused.measure_qubit(0);
+        reused.measure_qubit(5);
+        EXPECT_EQ(reused.nr_factors(), 3ul);
+        reused.clear();
+        EXPECT_EQ(reused.nr_factors(), 1ul);
+        EXPECT_FALSE(reused.is_sparse());
+        EXPECT_NEAR(reused.expectation(z0), 1, 1e-5);
+    }
+}
+
+TEST(Runtime, QubitRecycling) {
+    auto circuit = compile(
+        "OPENQASM 2.0;"
+        "qreg q[5];"
+        "creg c[5];"
+        "U(pi,0,pi) q[0];"
+        "measure q[0] -> c[0];"
+        "measure q[1] -> c[1];"
+        "barrier q;"
+        "U(pi,0,pi) q[2];"
+        "CX q[2],q[3];"
+        "barrier q;"
+        "measure q[3] -> c[3];"
+        "measure q[2] -> c[2];"
+        "reset q[0];"
+        "U(pi,0,pi) q[0];"
+        "measure q[0] -> c[4];"
+    );
+    RecyclingStats stats;
+    auto recycled = recycle_qubits(circuit, &stats);
+    EXPECT_EQ(stats.nr_qubits_before, 5ul);
+    EXPECT_EQ(stats.nr_qubits_after, 2ul);
+    EXPECT_EQ(stats.nr_resets_inserted, 3ul);
+    EXPECT_EQ(recycled.nr_qubits, 2ul);
+    // the barriers only keep the qubits that are live across them
+    auto barriers = std::count_if(recycled.operations.begin(), recycled.operations.end(),
+                                  [](auto& operation) { return operation.type == Operation::Barrier; });
+    EXPECT_EQ(barriers, 1);
+
+    execute(circuit);
+    auto expected = get_state().classical_register_value("c");
+    EXPECT_EQ(expected, 29ul);
+    Options options;
+    options.recycle_qubits = true;
+    options.backend = Backend::StateVector;
+    execute(circuit, options);
+    EXPECT_EQ(get_state().classical_register_value("c"), expected);
+}
+
+TEST(Runtime, LightConePruning) {
+    auto circuit = compile(
+        "OPENQASM 2.0;"
+        "qreg q[6];"
+        "qreg anc[2];"
+        "creg c[2];"
+        "creg f[1];"
+        "U(pi/2,0,pi) q[0];"
+        "reset q[0];"
+        "U(pi,0,pi) q[0];"
+        "U(pi/2,0,pi) q[2];"
+        "CX q[2],q[3];"
+        "U(pi,0,pi) anc[0];"
+        "measure anc[0] -> f[0];"
+        "if(f==1) U(pi,0,pi) q[1];"
+        "barrier q;"
+        "measure q[0] -> c[0];"
+        "measure q[1] -> c[1];"
+        "U(pi/2,0,pi) q[4];"
+        "CX q[4],q[5];"
+        "U(pi/2,0,pi) anc[1];"
+    );
+    PruningStats stats;
+    auto pruned = prune_light_cone(circuit, { "c" }, &stats);
+    EXPECT_EQ(stats.nr_qubits_before, 8ul);
+    EXPECT_EQ(stats.nr_qubits_after, 3ul);
+    EXPECT_EQ(stats.nr_gates_before, 9ul);
+    EXPECT_EQ(stats.nr_gates_after, 3ul);
+    EXPECT_EQ(pruned.quantum_registers.at("q"), std::make_tuple(0ul, 2ul));
+    EXPECT_EQ(pruned.quantum_registers.count("anc"), 1ul);
+
+    // the condition only depends on the register it tests
+    prune_light_cone(circuit, { "f" }, &stats);
+    EXPECT_EQ(stats.nr_qubits_after, 1ul);
+    EXPECT_EQ(stats.nr_gates_after, 1ul);
+    EXPECT_THROW(prune_light_cone(circuit, { "d" }), Error);
+
+    Options options;
+    options.prune_light_cone = true;
+    options.recycle_qubits = true;
+    options.backend = Backend::StateVector;
+    execute(circuit, options);
+    EXPECT_EQ(get_state().classical_register_value("c"), 3ul);
+    EXPECT_EQ(get_state().classical_register_value("f"), 1ul);
+}
+
+TEST(Runtime, OutOfCore) {
+    // a GHZ state on 10 qubits in chunks of 4, so that most CX need a swap
+    std::string ghz = "OPENQASM 2.0; qreg q[10]; creg c[10]; U(pi/2,0,pi) q[0];";
+    for (size_t i = 0; i < 9; i++) {
+        ghz += "CX q[" + std::to_string(i) + "],q[" + std::to_string(i + 1) + "];";
+    }
+    Options options;
+    options.backend = Backend::OutOfCore;
+    options.chunk_qubits = 4;
+    execute(compile(ghz), options);
+    auto state = get_chunked_state();
+    ASSERT_NE(state, nullptr);
+    EXPECT_NEAR(std::abs(state->amplitude(0)), M_SQRT1_2, 1e-5);
+    EXPECT_NEAR(std::abs(state->amplitude(1023)), M_SQRT1_2, 1e-5);
+    EXPECT_NEAR(std::abs(state->amplitude(1)), 0, 1e-5);
+    EXPECT_GT(state->stats().nr_swaps, 0ul);
+
+    // measurements and conditions run as on the state vector
+    execute(compile(ghz + "measure q -> c; if(c==1023) U(pi,0,pi) q[0]; measure q[0] -> c[0];"),
+            options);
+    auto value = get_state().classical_register_value("c");
+    EXPECT_TRUE(value == 0 || value == 1022);
+
+    // in memory, a wide state only allocates the chunks that become nonzero
+    options.chunk_directory = "";
+    options.chunk_qubits = 16;
+    execute(compile(
+        "OPENQASM 2.0;"
+        "qreg q[30];"
+        "creg c[2];"
+        "U(pi,0,pi) q[29];"
+        "CX q[29],q[0];"
+        "U(pi/2,0,pi) q[5];"
+        "measure q[0] -> c[0];"
+        "measure q[29] -> c[1];"
+    ), options);
+    EXPECT_EQ(get_state().classical_register_value("c"), 3ul);
+    auto& store = dynamic_cast<const math::MemoryChunkStore&>(get_chunked_state()->store());
+    EXPECT_LE(store.peak_allocated(), 2ul);
+}